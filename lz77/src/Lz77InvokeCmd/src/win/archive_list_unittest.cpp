@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "compressor/lib7zip_compressor.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::ArchiveCompressor;
+using compressor::ArchiveIndexEntry;
+
+namespace {
+
+  const wchar_t* const kTarPath = L"archive_list_unittest.tar";
+
+  //a ustar header and the data padded to 512 bytes,name holds raw bytes
+  void AppendTarFile(std::vector<uint8_t>& tar, const std::string& name, const std::string& data) {
+    uint8_t header[512];
+    memset(header, 0, sizeof(header));
+    memcpy(header, name.data(), name.size());
+    sprintf((char*)header + 100, "%07o", 0644);
+    sprintf((char*)header + 108, "%07o", 0);
+    sprintf((char*)header + 116, "%07o", 0);
+    sprintf((char*)header + 124, "%011o", (unsigned int)data.size());
+    sprintf((char*)header + 136, "%011o", 1500000000u);
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    //the checksum is taken with its own field as spaces
+    memset(header + 148, ' ', 8);
+    unsigned int sum = 0;
+    for (size_t i = 0; i < sizeof(header); i++) {
+      sum += header[i];
+    }
+    sprintf((char*)header + 148, "%06o", sum);
+    tar.insert(tar.end(), header, header + sizeof(header));
+    tar.insert(tar.end(), data.begin(), data.end());
+    tar.resize((tar.size() + 511) / 512 * 512, 0);
+  }
+  std::wstring OemToWide(const std::string& name) {
+    wchar_t wide[MAX_PATH];
+    const int length = ::MultiByteToWideChar(CP_OEMCP, 0, name.data(), (int)name.size(), wide, MAX_PATH);
+    return std::wstring(wide, length > 0 ? length : 0);
+  }
+
+}
+
+TEST(ArchiveListTest, TarOemNames) {
+  //not valid UTF-8,the tar handler falls back to the OEM code page
+  const std::string names[] = { "caf\x82.txt", "\x8e\x99\x9a.txt" };
+  std::vector<uint8_t> tar;
+  for (size_t i = 0; i < 2; i++) {
+    AppendTarFile(tar, names[i], "data " + names[i]);
+  }
+  tar.resize(tar.size() + 1024, 0);
+  FILE* file = _wfopen(kTarPath, L"wb");
+  ASSERT_TRUE(file != nullptr);
+  fwrite(&tar[0], 1, tar.size(), file);
+  fclose(file);
+  ArchiveCompressor compressor(nullptr);
+  std::vector<ArchiveIndexEntry> entries;
+  ASSERT_FALSE(compressor.ListArchive(kTarPath, L"", entries));
+  ASSERT_EQ(2u, entries.size());
+  for (size_t i = 0; i < 2; i++) {
+    EXPECT_EQ(OemToWide(names[i]), entries[i].path);
+    EXPECT_EQ(5 + names[i].size(), entries[i].size);
+    EXPECT_FALSE(entries[i].is_dir);
+  }
+  ::DeleteFileW(kTarPath);
+}
@@ -0,0 +1,106 @@
+#include <cstdint>
+#include <string>
+#include "compressor/archive_update.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::ArchiveItemMatcher;
+using compressor::ArchivedItem;
+using compressor::kNoArchiveIndex;
+using compressor::kUpdateTimeTolerance;
+
+namespace {
+
+  const uint64_t kMTime = 132000000000000000ull;
+
+  ArchivedItem MakeItem(uint32_t index, uint64_t size, uint64_t mtime) {
+    ArchivedItem item;
+    item.index = index;
+    item.size = size;
+    item.mtime = mtime;
+    item.crc = 0;
+    item.has_crc = false;
+    return item;
+  }
+
+}
+
+TEST(ArchiveUpdateTest, ExactMatch) {
+  ArchiveItemMatcher matcher;
+  matcher.Reset(0);
+  matcher.Add(L"dir\\a.txt", MakeItem(3, 100, kMTime));
+  EXPECT_EQ(1u, matcher.size());
+  EXPECT_EQ(3u, matcher.Match(L"dir\\a.txt", 100, kMTime, L"", false));
+  EXPECT_EQ(kNoArchiveIndex, matcher.Match(L"dir\\a.txt", 101, kMTime, L"", false));
+  EXPECT_EQ(kNoArchiveIndex, matcher.Match(L"dir\\a.txt", 100, kMTime + 1, L"", false));
+  EXPECT_EQ(kNoArchiveIndex, matcher.Match(L"dir\\b.txt", 100, kMTime, L"", false));
+}
+TEST(ArchiveUpdateTest, Separators) {
+  //zip and tar report '/',the scan uses '\'
+  ArchiveItemMatcher matcher;
+  matcher.Add(L"dir/sub/a.txt", MakeItem(7, 1, kMTime));
+  EXPECT_EQ(7u, matcher.Match(L"dir\\sub\\a.txt", 1, kMTime, L"", false));
+}
+TEST(ArchiveUpdateTest, TimeTolerance) {
+  ArchiveItemMatcher matcher;
+  matcher.Reset(kUpdateTimeTolerance);
+  matcher.Add(L"a.txt", MakeItem(0, 10, kMTime));
+  EXPECT_EQ(0u, matcher.Match(L"a.txt", 10, kMTime + kUpdateTimeTolerance, L"", false));
+  EXPECT_EQ(0u, matcher.Match(L"a.txt", 10, kMTime - kUpdateTimeTolerance, L"", false));
+  EXPECT_EQ(kNoArchiveIndex, matcher.Match(L"a.txt", 10, kMTime + kUpdateTimeTolerance + 1, L"", false));
+}
+TEST(ArchiveUpdateTest, UnknownTime) {
+  //an item without a time can not be shown unchanged
+  ArchiveItemMatcher matcher;
+  matcher.Reset(kUpdateTimeTolerance);
+  matcher.Add(L"a.txt", MakeItem(0, 10, 0));
+  EXPECT_EQ(kNoArchiveIndex, matcher.Match(L"a.txt", 10, 0, L"", false));
+}
+TEST(ArchiveUpdateTest, LastCopyWins) {
+  ArchiveItemMatcher matcher;
+  matcher.Add(L"a.txt", MakeItem(1, 10, kMTime));
+  matcher.Add(L"a.txt", MakeItem(5, 10, kMTime));
+  EXPECT_EQ(1u, matcher.size());
+  EXPECT_EQ(5u, matcher.Match(L"a.txt", 10, kMTime, L"", false));
+}
+TEST(ArchiveUpdateTest, ResetClears) {
+  ArchiveItemMatcher matcher;
+  matcher.Add(L"a.txt", MakeItem(1, 10, kMTime));
+  matcher.Reset(0);
+  EXPECT_EQ(0u, matcher.size());
+  EXPECT_EQ(kNoArchiveIndex, matcher.Match(L"a.txt", 10, kMTime, L"", false));
+}
+TEST(ArchiveUpdateTest, VerifyCrc) {
+  const char* const name = "archive_update_unittest.txt";
+  FILE* file = fopen(name, "wb");
+  ASSERT_TRUE(file != nullptr);
+  fwrite("0123456789", 1, 10, file);
+  fclose(file);
+  const std::string narrow(name);
+  const std::wstring path(narrow.begin(), narrow.end());
+  uint32_t crc = 0;
+  ASSERT_FALSE(ArchiveItemMatcher::FileCrc(path, crc));
+  //crc32 of "0123456789"
+  EXPECT_EQ(0xA684C7C6u, crc);
+  ArchiveItemMatcher matcher;
+  ArchivedItem item = MakeItem(2, 10, kMTime);
+  item.crc = crc;
+  item.has_crc = true;
+  matcher.Add(L"a.txt", item);
+  EXPECT_EQ(2u, matcher.Match(L"a.txt", 10, kMTime, path, true));
+  item.crc = crc ^ 1;
+  matcher.Add(L"a.txt", item);
+  EXPECT_EQ(kNoArchiveIndex, matcher.Match(L"a.txt", 10, kMTime, path, true));
+  //without verify_crc the stored CRC is not looked at
+  EXPECT_EQ(2u, matcher.Match(L"a.txt", 10, kMTime, path, false));
+  remove(name);
+}
+TEST(ArchiveUpdateTest, IsUpdatable) {
+  EXPECT_TRUE(ArchiveItemMatcher::IsUpdatable(L"7z"));
+  EXPECT_TRUE(ArchiveItemMatcher::IsUpdatable(L"zip"));
+  EXPECT_FALSE(ArchiveItemMatcher::IsUpdatable(L"gz"));
+}
@@ -0,0 +1,129 @@
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "compressor/dir_scanner.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::DirScanner;
+using compressor::ItemTable;
+using compressor::ScanEntry;
+
+namespace {
+
+  const wchar_t* const kScanDir = L"dir_scanner_unittest";
+  const int kTreeDepth = 3;
+  const int kTreeWidth = 3;
+  const int kTreeFiles = 2;
+
+  //every folder holds kTreeFiles files and,above kTreeDepth,kTreeWidth folders;
+  //a file is as many bytes long as its path
+  void MakeTree(const std::wstring& path, int depth, std::vector<std::wstring>& created) {
+    ASSERT_TRUE(::CreateDirectoryW(path.c_str(), nullptr) != FALSE);
+    created.push_back(path);
+    for (int i = 0; i < kTreeFiles; i++) {
+      const std::wstring file_path = path + L"\\file" + std::to_wstring(i) + L".txt";
+      FILE* file = _wfopen(file_path.c_str(), L"wb");
+      ASSERT_TRUE(file != nullptr);
+      const std::string data(file_path.size(), 'x');
+      fwrite(data.data(), 1, data.size(), file);
+      fclose(file);
+      created.push_back(file_path);
+    }
+    if (depth == kTreeDepth) {
+      return;
+    }
+    for (int i = 0; i < kTreeWidth; i++) {
+      MakeTree(path + L"\\dir" + std::to_wstring(i), depth + 1, created);
+    }
+  }
+  void RemoveTree(const std::vector<std::wstring>& created) {
+    //files and folders in reverse,children before their parents
+    for (size_t i = created.size(); i > 0; i--) {
+      if (!::DeleteFileW(created[i - 1].c_str())) {
+        ::RemoveDirectoryW(created[i - 1].c_str());
+      }
+    }
+  }
+  size_t TreeCount(int depth) {
+    return depth == kTreeDepth ? kTreeFiles : kTreeFiles + kTreeWidth * (1 + TreeCount(depth + 1));
+  }
+  std::vector<std::wstring> Paths(const ItemTable& table) {
+    std::vector<std::wstring> paths;
+    for (size_t i = 0; i < table.size(); i++) {
+      paths.push_back(table.Path(i));
+    }
+    return paths;
+  }
+
+}
+
+TEST(DirScannerTest, ListsTreeInPathOrder) {
+  std::vector<std::wstring> created;
+  MakeTree(kScanDir, 0, created);
+  ItemTable table;
+  DirScanner scanner(8);
+  scanner.AddRoot(kScanDir, L"tree");
+  EXPECT_FALSE(scanner.Scan(table));
+  EXPECT_TRUE(scanner.failed_paths().empty());
+  ASSERT_EQ(TreeCount(0), table.size());
+  for (size_t i = 0; i < table.size(); i++) {
+    const std::wstring path = table.Path(i);
+    EXPECT_EQ(0u, path.find(L"tree\\"));
+    EXPECT_EQ(std::wstring(kScanDir) + path.substr(4), table.DiskPath(i));
+    if (table.IsDir(i)) {
+      continue;
+    }
+    EXPECT_EQ(table.DiskPath(i).size(), table.Size(i));
+    //the folder of a file is listed before it
+    const std::wstring parent = path.substr(0, path.find_last_of(L'\\'));
+    bool is_parent_found = parent == L"tree";
+    for (size_t j = 0; j < i && !is_parent_found; j++) {
+      is_parent_found = table.IsDir(j) && table.Path(j) == parent;
+    }
+    EXPECT_TRUE(is_parent_found);
+  }
+  //the order does not depend on the threads
+  ItemTable single;
+  DirScanner single_scanner(1);
+  single_scanner.AddRoot(kScanDir, L"tree");
+  EXPECT_FALSE(single_scanner.Scan(single));
+  EXPECT_TRUE(Paths(single) == Paths(table));
+  RemoveTree(created);
+}
+TEST(DirScannerTest, RootsAndFilesKeepTheirOrder) {
+  std::vector<std::wstring> created;
+  MakeTree(kScanDir, kTreeDepth, created);
+  ItemTable table;
+  DirScanner scanner(4);
+  scanner.AddRoot(kScanDir, L"b");
+  ScanEntry entry = { L"file0.txt", 7, 0, 0, 0, FILE_ATTRIBUTE_ARCHIVE, 0, false };
+  scanner.AddFile(kScanDir, entry);
+  scanner.AddRoot(kScanDir, L"a");
+  EXPECT_FALSE(scanner.Scan(table));
+  const std::vector<std::wstring> paths = Paths(table);
+  ASSERT_EQ(2 * kTreeFiles + 1, (int)paths.size());
+  EXPECT_EQ(L"b\\file0.txt", paths[0]);
+  EXPECT_EQ(L"b\\file1.txt", paths[1]);
+  EXPECT_EQ(L"file0.txt", paths[2]);
+  EXPECT_EQ(7u, table.Size(2));
+  EXPECT_EQ(L"a\\file0.txt", paths[3]);
+  EXPECT_EQ(L"a\\file1.txt", paths[4]);
+  RemoveTree(created);
+}
+TEST(DirScannerTest, ReportsMissingRoot) {
+  ItemTable table;
+  DirScanner scanner(2);
+  const std::wstring missing = L"dir_scanner_unittest_missing";
+  scanner.AddRoot(missing, L"missing");
+  EXPECT_TRUE(scanner.Scan(table));
+  ASSERT_EQ(1u, scanner.failed_paths().size());
+  EXPECT_EQ(missing, scanner.failed_paths()[0]);
+  EXPECT_EQ(0u, table.size());
+}
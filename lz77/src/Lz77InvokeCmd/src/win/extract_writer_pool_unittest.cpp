@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "compressor/extract_writer_pool.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::ExtractFileMeta;
+using compressor::ExtractWriteJob;
+using compressor::ExtractWriterPool;
+using compressor::kWriterChunkSize;
+
+namespace {
+
+  const wchar_t* const kPoolDir = L"writer_pool_unittest";
+
+  std::vector<uint8_t> MakeData(size_t size, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+      data[i] = (uint8_t)(((i + seed) * 2654435761u) >> 24);
+    }
+    return data;
+  }
+  bool ReadAll(const std::wstring& path, std::vector<uint8_t>& data) {
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    uint8_t buffer[4096];
+    size_t count = 0;
+    data.resize(0);
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return false;
+  }
+  ExtractFileMeta MakeMeta(uint64_t mtime) {
+    ExtractFileMeta meta = { 0, 0, mtime, 0, false };
+    return meta;
+  }
+  std::wstring PoolPath(const wchar_t* name) {
+    return std::wstring(kPoolDir) + L"\\" + name;
+  }
+  void RemovePoolDir() {
+    const wchar_t* files[] = { L"empty.bin", L"small.bin", L"large.bin", L"a\\b\\nested.bin", L"blocker", L"good.bin" };
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+      ::DeleteFileW(PoolPath(files[i]).c_str());
+    }
+    ::RemoveDirectoryW(PoolPath(L"a\\b").c_str());
+    ::RemoveDirectoryW(PoolPath(L"a").c_str());
+    ::RemoveDirectoryW(kPoolDir);
+  }
+
+}
+
+TEST(ExtractWriterPoolTest, InterleavedFiles) {
+  RemovePoolDir();
+  ASSERT_TRUE(::CreateDirectoryW(kPoolDir, nullptr) != FALSE);
+  const wchar_t* names[] = { L"empty.bin", L"small.bin", L"large.bin" };
+  std::vector<uint8_t> data[3] = { MakeData(0, 1), MakeData(1000, 2), MakeData(3 * kWriterChunkSize + 17, 3) };
+  //a budget of a few chunks:the decoder has to wait for the writers
+  ExtractWriterPool pool(2, 3 * kWriterChunkSize);
+  ExtractWriteJob* jobs[3];
+  for (int i = 0; i < 3; i++) {
+    jobs[i] = pool.Open(PoolPath(names[i]), data[i].size());
+  }
+  const size_t piece = 7000;
+  uint64_t total = 0;
+  for (size_t offset = 0; ; offset += piece) {
+    bool is_any_left = false;
+    for (int i = 0; i < 3; i++) {
+      if (offset >= data[i].size()) {
+        continue;
+      }
+      const size_t n = (std::min)(piece, data[i].size() - offset);
+      ASSERT_FALSE(pool.Write(jobs[i], &data[i][offset], n));
+      total += n;
+      is_any_left = true;
+    }
+    if (!is_any_left) {
+      break;
+    }
+  }
+  const uint64_t mtime = 132000000000000000ull;
+  for (int i = 0; i < 3; i++) {
+    pool.Close(jobs[i], MakeMeta(mtime));
+  }
+  pool.Finish();
+  EXPECT_TRUE(pool.errors().empty());
+  EXPECT_EQ(total, pool.bytes_written());
+  for (int i = 0; i < 3; i++) {
+    std::vector<uint8_t> read;
+    ASSERT_FALSE(ReadAll(PoolPath(names[i]), read));
+    EXPECT_TRUE(read == data[i]);
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    ASSERT_TRUE(::GetFileAttributesExW(PoolPath(names[i]).c_str(), GetFileExInfoStandard, &attributes) != FALSE);
+    EXPECT_EQ(mtime, ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+  }
+  RemovePoolDir();
+}
+TEST(ExtractWriterPoolTest, CreatesMissingFolders) {
+  RemovePoolDir();
+  const std::vector<uint8_t> data = MakeData(5000, 4);
+  ExtractWriterPool pool(1, compressor::kWriterMaxInflightBytes);
+  ExtractWriteJob* job = pool.Open(PoolPath(L"a\\b\\nested.bin"), data.size());
+  ASSERT_FALSE(pool.Write(job, &data[0], data.size()));
+  pool.Close(job, MakeMeta(0));
+  pool.Finish();
+  EXPECT_TRUE(pool.errors().empty());
+  std::vector<uint8_t> read;
+  ASSERT_FALSE(ReadAll(PoolPath(L"a\\b\\nested.bin"), read));
+  EXPECT_TRUE(read == data);
+  RemovePoolDir();
+}
+TEST(ExtractWriterPoolTest, ReportsOpenFailure) {
+  RemovePoolDir();
+  ASSERT_TRUE(::CreateDirectoryW(kPoolDir, nullptr) != FALSE);
+  //a file where the parent folder should be
+  FILE* blocker = _wfopen(PoolPath(L"blocker").c_str(), L"wb");
+  ASSERT_TRUE(blocker != nullptr);
+  fclose(blocker);
+  const std::vector<uint8_t> data = MakeData(100, 5);
+  ExtractWriterPool pool(2, compressor::kWriterMaxInflightBytes);
+  const std::wstring bad_path = PoolPath(L"blocker\\file.bin");
+  ExtractWriteJob* bad = pool.Open(bad_path, data.size());
+  ExtractWriteJob* good = pool.Open(PoolPath(L"good.bin"), data.size());
+  ASSERT_FALSE(pool.Write(bad, &data[0], data.size()));
+  ASSERT_FALSE(pool.Write(good, &data[0], data.size()));
+  pool.Close(bad, MakeMeta(0));
+  pool.Close(good, MakeMeta(0));
+  pool.Finish();
+  ASSERT_EQ(1u, pool.errors().size());
+  EXPECT_TRUE(pool.errors().find(bad_path) != pool.errors().end());
+  std::vector<uint8_t> read;
+  ASSERT_FALSE(ReadAll(PoolPath(L"good.bin"), read));
+  EXPECT_TRUE(read == data);
+  RemovePoolDir();
+}
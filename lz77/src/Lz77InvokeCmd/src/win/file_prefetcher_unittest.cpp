@@ -0,0 +1,112 @@
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "compressor/file_prefetcher.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::FilePrefetcher;
+using compressor::kPrefetchMaxFileSize;
+
+namespace {
+
+  const int kPrefetchFiles = 12;
+
+  std::vector<uint8_t> MakeData(size_t size, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+      data[i] = (uint8_t)(((i + seed) * 2654435761u) >> 24);
+    }
+    return data;
+  }
+  std::wstring PrefetchPath(int index) {
+    return L"prefetcher_unittest_" + std::to_wstring(index) + L".bin";
+  }
+  //file i holds 1000 + 100 * i bytes
+  std::vector<uint8_t> FileData(int index) {
+    return MakeData(1000 + 100 * index, index);
+  }
+  void MakeFiles() {
+    for (int i = 0; i < kPrefetchFiles; i++) {
+      FILE* file = _wfopen(PrefetchPath(i).c_str(), L"wb");
+      ASSERT_TRUE(file != nullptr);
+      const std::vector<uint8_t> data = FileData(i);
+      fwrite(&data[0], 1, data.size(), file);
+      fclose(file);
+    }
+  }
+  void RemoveFiles() {
+    for (int i = 0; i < kPrefetchFiles; i++) {
+      ::DeleteFileW(PrefetchPath(i).c_str());
+    }
+  }
+  void AddFiles(FilePrefetcher& prefetcher) {
+    for (int i = 0; i < kPrefetchFiles; i++) {
+      prefetcher.Add(i, PrefetchPath(i), FileData(i).size());
+    }
+  }
+
+}
+
+TEST(FilePrefetcherTest, TakesInOrder) {
+  MakeFiles();
+  //room for about three files:the window only moves on as buffers come back
+  FilePrefetcher prefetcher(4000, 2);
+  AddFiles(prefetcher);
+  prefetcher.Start();
+  for (int i = 0; i < kPrefetchFiles; i++) {
+    std::vector<uint8_t> data;
+    ASSERT_FALSE(prefetcher.Take(i, data));
+    EXPECT_TRUE(data == FileData(i));
+    prefetcher.Recycle(data);
+  }
+  prefetcher.Stop();
+  RemoveFiles();
+}
+TEST(FilePrefetcherTest, SkippedItemsAreDropped) {
+  MakeFiles();
+  FilePrefetcher prefetcher;
+  AddFiles(prefetcher);
+  prefetcher.Start();
+  std::vector<uint8_t> data;
+  ASSERT_FALSE(prefetcher.Take(5, data));
+  EXPECT_TRUE(data == FileData(5));
+  prefetcher.Recycle(data);
+  //behind the window now,the caller reads them itself
+  EXPECT_TRUE(prefetcher.Take(2, data));
+  EXPECT_TRUE(prefetcher.Take(5, data));
+  for (int i = 6; i < kPrefetchFiles; i++) {
+    ASSERT_FALSE(prefetcher.Take(i, data));
+    EXPECT_TRUE(data == FileData(i));
+    prefetcher.Recycle(data);
+  }
+  prefetcher.Stop();
+  RemoveFiles();
+}
+TEST(FilePrefetcherTest, LeavesLargeAndMissingFilesToCaller) {
+  MakeFiles();
+  FilePrefetcher prefetcher;
+  prefetcher.Add(0, PrefetchPath(0), FileData(0).size());
+  prefetcher.Add(1, L"prefetcher_unittest_large.bin", kPrefetchMaxFileSize + 1);
+  prefetcher.Add(2, L"prefetcher_unittest_missing.bin", 100);
+  prefetcher.Add(3, PrefetchPath(3), 0);
+  prefetcher.Add(4, PrefetchPath(4), FileData(4).size());
+  std::vector<uint8_t> data;
+  //nothing is read before Start
+  EXPECT_TRUE(prefetcher.Take(0, data));
+  prefetcher.Start();
+  EXPECT_TRUE(prefetcher.Take(1, data));
+  EXPECT_TRUE(prefetcher.Take(2, data));
+  EXPECT_TRUE(prefetcher.Take(3, data));
+  ASSERT_FALSE(prefetcher.Take(4, data));
+  EXPECT_TRUE(data == FileData(4));
+  prefetcher.Recycle(data);
+  prefetcher.Stop();
+  RemoveFiles();
+}
@@ -0,0 +1,62 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "compressor/filter_sniffer.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::FilterKind;
+using compressor::FilterSniffer;
+using compressor::kFilterProbeSize;
+
+static FilterKind KindOfHead(const uint8_t* prefix, size_t prefix_size, size_t size = kFilterProbeSize) {
+  std::vector<uint8_t> head(size, 0);
+  memcpy(head.data(), prefix, (std::min)(prefix_size, size));
+  return FilterSniffer::KindOf(head.data(), head.size());
+}
+
+TEST(FilterSnifferTest, Pe) {
+  const uint8_t mz[] = { 'M', 'Z', 0x90, 0x00 };
+  EXPECT_EQ(FilterKind::kExecutable, KindOfHead(mz, sizeof(mz)));
+  //a DOS header is 0x40 bytes,shorter is not an executable
+  EXPECT_EQ(FilterKind::kNone, KindOfHead(mz, sizeof(mz), 0x3F));
+}
+TEST(FilterSnifferTest, Elf) {
+  const uint8_t elf[] = { 0x7F, 'E', 'L', 'F', 2, 1, 1 };
+  EXPECT_EQ(FilterKind::kExecutable, KindOfHead(elf, sizeof(elf)));
+  EXPECT_EQ(FilterKind::kNone, KindOfHead(elf, sizeof(elf), 3));
+}
+TEST(FilterSnifferTest, MachO) {
+  const uint8_t magics[][4] = {
+    { 0xCE, 0xFA, 0xED, 0xFE }, { 0xCF, 0xFA, 0xED, 0xFE },
+    { 0xFE, 0xED, 0xFA, 0xCE }, { 0xFE, 0xED, 0xFA, 0xCF } };
+  for (size_t i = 0; i < sizeof(magics) / sizeof(magics[0]); i++) {
+    EXPECT_EQ(FilterKind::kExecutable, KindOfHead(magics[i], 4));
+  }
+  //fat binaries start with CAFEBABE,as do Java classes:left alone
+  const uint8_t fat[] = { 0xCA, 0xFE, 0xBA, 0xBE };
+  EXPECT_EQ(FilterKind::kNone, KindOfHead(fat, sizeof(fat)));
+}
+TEST(FilterSnifferTest, Wave) {
+  uint8_t wave[0x16] = { 'R', 'I', 'F', 'F', 0x24, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ',
+    16, 0, 0, 0, 1, 0 };
+  EXPECT_EQ(FilterKind::kPcm, KindOfHead(wave, sizeof(wave)));
+  //format 3 is IEEE float,Delta does not help it
+  wave[0x14] = 3;
+  EXPECT_EQ(FilterKind::kNone, KindOfHead(wave, sizeof(wave)));
+  wave[0x14] = 1;
+  EXPECT_EQ(FilterKind::kNone, KindOfHead(wave, sizeof(wave), 0x15));
+}
+TEST(FilterSnifferTest, Other) {
+  const uint8_t text[] = { 'H', 'e', 'l', 'l', 'o' };
+  EXPECT_EQ(FilterKind::kNone, KindOfHead(text, sizeof(text)));
+  EXPECT_EQ(FilterKind::kNone, FilterSniffer::KindOf(text, 0));
+}
+TEST(FilterSnifferTest, IsFiltered) {
+  EXPECT_TRUE(FilterSniffer::IsFiltered(L"7z"));
+  EXPECT_FALSE(FilterSniffer::IsFiltered(L"zip"));
+}
@@ -0,0 +1,142 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "compressor/iso_extractor.h"
+#include "compressor/lib7zip_compressor.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::IsoExtractor;
+using compressor::IsoVolumeKind;
+using compressor::kIsoSectorSize;
+using compressor::kIsoDescriptorSector;
+
+namespace {
+
+  const wchar_t* const kProbeImage = L"iso_probe_unittest.iso";
+  const wchar_t* const kJolietDir = L"iso_joliet_unittest";
+  const wchar_t* const kJolietImage = L"iso_joliet_unittest.iso";
+  const wchar_t* const kJolietOutDir = L"iso_joliet_unittest_out";
+  //not an 8.3 ISO 9660 name:only a Joliet reader gives it back as is
+  const wchar_t* const kJolietName = L"Long Mixed Case Name \u00e4\u00f6\u00fc.txt";
+  const char kJolietData[] = "joliet names come back through the 7-Zip handler";
+
+  struct Descriptor
+  {
+    uint8_t type;
+    const char* id;
+    bool is_joliet;
+  };
+
+  //the 16 system sectors,then one sector per descriptor
+  void WriteImage(const std::vector<Descriptor>& descriptors) {
+    std::vector<uint8_t> image((kIsoDescriptorSector + descriptors.size() + 1) * kIsoSectorSize, 0);
+    for (size_t i = 0; i < descriptors.size(); i++) {
+      uint8_t* sector = &image[(kIsoDescriptorSector + i) * kIsoSectorSize];
+      sector[0] = descriptors[i].type;
+      memcpy(sector + 1, descriptors[i].id, 5);
+      sector[6] = 1;
+      if (descriptors[i].is_joliet) {
+        //UCS-2 level 3 escape sequence
+        sector[88] = '%';
+        sector[89] = '/';
+        sector[90] = 'E';
+      }
+    }
+    const std::wstring name(kProbeImage);
+    FILE* file = fopen(std::string(name.begin(), name.end()).c_str(), "wb");
+    ASSERT_TRUE(file != nullptr);
+    ASSERT_EQ(image.size(), fwrite(image.data(), 1, image.size(), file));
+    fclose(file);
+  }
+  void RemoveImage() {
+    const std::wstring name(kProbeImage);
+    remove(std::string(name.begin(), name.end()).c_str());
+  }
+  bool ReadAll(const std::wstring& path, std::string& data) {
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    char buffer[256];
+    size_t count = 0;
+    data.resize(0);
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      data.append(buffer, count);
+    }
+    fclose(file);
+    return false;
+  }
+  void RemoveJoliet() {
+    ::DeleteFileW((std::wstring(kJolietDir) + L"\\" + kJolietName).c_str());
+    ::RemoveDirectoryW(kJolietDir);
+    ::DeleteFileW((std::wstring(kJolietOutDir) + L"\\" + kJolietName).c_str());
+    ::RemoveDirectoryW(kJolietOutDir);
+    ::DeleteFileW(kJolietImage);
+  }
+
+}
+
+TEST(IsoProbeTest, Iso9660) {
+  WriteImage({ { 1, "CD001", false }, { 255, "CD001", false } });
+  EXPECT_EQ(IsoVolumeKind::kIso9660, IsoExtractor::Probe(kProbeImage));
+  RemoveImage();
+}
+TEST(IsoProbeTest, Joliet) {
+  WriteImage({ { 1, "CD001", false }, { 2, "CD001", true }, { 255, "CD001", false } });
+  EXPECT_EQ(IsoVolumeKind::kJoliet, IsoExtractor::Probe(kProbeImage));
+  RemoveImage();
+}
+TEST(IsoProbeTest, SupplementaryWithoutEscape) {
+  WriteImage({ { 1, "CD001", false }, { 2, "CD001", false }, { 255, "CD001", false } });
+  EXPECT_EQ(IsoVolumeKind::kIso9660, IsoExtractor::Probe(kProbeImage));
+  RemoveImage();
+}
+TEST(IsoProbeTest, UdfBridge) {
+  WriteImage({ { 1, "CD001", false }, { 255, "CD001", false }, { 0, "BEA01", false },
+    { 0, "NSR02", false }, { 0, "TEA01", false } });
+  EXPECT_EQ(IsoVolumeKind::kUdf, IsoExtractor::Probe(kProbeImage));
+  RemoveImage();
+}
+TEST(IsoProbeTest, StopsAtTerminator) {
+  //anything after TEA01 is not part of the recognition area
+  WriteImage({ { 0, "BEA01", false }, { 0, "TEA01", false }, { 0, "NSR03", false } });
+  EXPECT_EQ(IsoVolumeKind::kUnknown, IsoExtractor::Probe(kProbeImage));
+  RemoveImage();
+}
+TEST(IsoProbeTest, NotAnImage) {
+  WriteImage({});
+  EXPECT_EQ(IsoVolumeKind::kUnknown, IsoExtractor::Probe(kProbeImage));
+  RemoveImage();
+  EXPECT_EQ(IsoVolumeKind::kUnknown, IsoExtractor::Probe(L"iso_probe_unittest_missing.iso"));
+}
+TEST(IsoFallbackTest, JolietGoesThrough7Zip) {
+  //libarchive 2.4 only reads the primary volume,a Joliet image has to go
+  //through the 7-Zip Iso handler to keep its long names
+  RemoveJoliet();
+  ASSERT_TRUE(::CreateDirectoryW(kJolietDir, nullptr) != FALSE);
+  const std::wstring source = std::wstring(kJolietDir) + L"\\" + kJolietName;
+  FILE* file = _wfopen(source.c_str(), L"wb");
+  ASSERT_TRUE(file != nullptr);
+  ASSERT_EQ(sizeof(kJolietData) - 1, fwrite(kJolietData, 1, sizeof(kJolietData) - 1, file));
+  fclose(file);
+  compressor::ArchiveCompressor compressor(nullptr);
+  compressor::DiscImageOptions options;
+  options.format = compressor::DiscImageFormat::kIsoJoliet;
+  ASSERT_FALSE(compressor.CreateImage(kJolietDir, kJolietImage, options));
+  ASSERT_EQ(IsoVolumeKind::kJoliet, IsoExtractor::Probe(kJolietImage));
+  EXPECT_FALSE(compressor.ExtractingExceptionsISO(kJolietImage, kJolietOutDir));
+  EXPECT_TRUE(compressor.IsDecompressOK());
+  std::string data;
+  EXPECT_FALSE(ReadAll(std::wstring(kJolietOutDir) + L"\\" + kJolietName, data));
+  EXPECT_EQ(std::string(kJolietData), data);
+  RemoveJoliet();
+}
@@ -0,0 +1,78 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "compressor/lib7zip_compressor.h"
+#include "compressor/compression_profile.h"
+#include "compressor/memory_archive.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+static void MakeItems(std::vector<std::string>& blobs, std::vector<compressor::MemoryItem>& items) {
+  blobs.resize(3);
+  for (int i = 0; i < 4096; i++) {
+    blobs[0] += "Hello Hello Hello Hello!\n";
+  }
+  for (int i = 0; i < 65536; i++) {
+    blobs[1].push_back((char)((i * 2654435761u) >> 24));
+  }
+  blobs[2].resize(0);
+  const wchar_t* names[] = { L"dir\\a.txt", L"dir\\b.bin", L"empty.txt" };
+  items.resize(0);
+  compressor::MemoryItem dir = { L"dir", nullptr, 0, 0, true };
+  items.push_back(dir);
+  for (size_t i = 0; i < blobs.size(); i++) {
+    compressor::MemoryItem item = { names[i], (const uint8_t*)blobs[i].data(), blobs[i].size(),
+      132000000000000000ull, false };
+    items.push_back(item);
+  }
+}
+static void RoundTrip(const wchar_t* ext, const std::wstring& password) {
+  std::vector<std::string> blobs;
+  std::vector<compressor::MemoryItem> items;
+  MakeItems(blobs, items);
+  compressor::ArchiveCompressor compressor(nullptr);
+  ASSERT_FALSE(compressor.IsSupportedARCExt(ext));
+  std::vector<uint8_t> archive;
+  ASSERT_FALSE(compressor.CompressToMemory(items, password, compressor::CompressionProfile(), archive));
+  ASSERT_FALSE(archive.empty());
+  std::vector<compressor::MemoryEntry> entries;
+  ASSERT_FALSE(compressor.ExtractFromMemory(archive.data(), archive.size(), ext, password, entries));
+  ASSERT_EQ(items.size(), entries.size());
+  for (size_t i = 0; i < items.size(); i++) {
+    bool is_found = false;
+    for (size_t j = 0; j < entries.size(); j++) {
+      if (entries[j].name != items[i].name) {
+        continue;
+      }
+      is_found = true;
+      EXPECT_EQ(items[i].is_dir, entries[j].is_dir);
+      EXPECT_TRUE(entries[j].is_ok);
+      if (!items[i].is_dir) {
+        ASSERT_EQ(items[i].size, entries[j].data.size());
+        EXPECT_TRUE(std::equal(entries[j].data.begin(), entries[j].data.end(), items[i].data));
+      }
+    }
+    EXPECT_TRUE(is_found);
+  }
+}
+
+TEST(MemoryArchiveTest, RoundTrip7z) {
+  RoundTrip(L"7z", L"");
+}
+TEST(MemoryArchiveTest, RoundTripZip) {
+  RoundTrip(L"zip", L"");
+}
+TEST(MemoryArchiveTest, RoundTrip7zPassword) {
+  RoundTrip(L"7z", L"secret");
+}
+TEST(MemoryArchiveTest, ExtractGarbage) {
+  const uint8_t garbage[64] = { 'n', 'o', 't', ' ', 'a', 'n', ' ', 'a', 'r', 'c' };
+  compressor::ArchiveCompressor compressor(nullptr);
+  std::vector<compressor::MemoryEntry> entries;
+  EXPECT_TRUE(compressor.ExtractFromMemory(garbage, sizeof(garbage), L"7z", L"", entries));
+  EXPECT_TRUE(entries.empty());
+}
@@ -0,0 +1,170 @@
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <zlib.h>
+//the stream interface GUIDs are defined once per module,here for the tests
+#include "CPP/Common/MyInitGuid.h"
+#include "compressor/win/multi_volume_stream.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::CMultiVolumeOutStream;
+
+namespace {
+
+  const wchar_t* const kVolumeBase = L"multi_volume_unittest.7z";
+  const uint64_t kVolumeSize = 1000;
+
+  std::vector<uint8_t> MakeData(size_t size, uint32_t seed) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+      data[i] = (uint8_t)(((i + seed) * 2654435761u) >> 24);
+    }
+    return data;
+  }
+  std::wstring VolumePath(int index) {
+    wchar_t number[16];
+    swprintf(number, 16, L".%03d", index + 1);
+    return std::wstring(kVolumeBase) + number;
+  }
+  bool ReadAll(const std::wstring& path, std::vector<uint8_t>& data) {
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    uint8_t buffer[4096];
+    size_t count = 0;
+    data.resize(0);
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      data.insert(data.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return false;
+  }
+  //volume contents joined,as 7-Zip reads the set
+  std::vector<uint8_t> ReadVolumes(int count) {
+    std::vector<uint8_t> joined;
+    for (int i = 0; i < count; i++) {
+      std::vector<uint8_t> data;
+      EXPECT_FALSE(ReadAll(VolumePath(i), data));
+      joined.insert(joined.end(), data.begin(), data.end());
+    }
+    return joined;
+  }
+  //every "name crc" line of the manifest must match the volume on disk
+  void CheckManifest(int count) {
+    std::vector<uint8_t> manifest;
+    ASSERT_FALSE(ReadAll(std::wstring(kVolumeBase) + compressor::kVolumeManifestExt, manifest));
+    const std::string text(manifest.begin(), manifest.end());
+    size_t lines = 0;
+    for (size_t begin = 0; begin < text.size(); lines++) {
+      const size_t end = text.find("\r\n", begin);
+      ASSERT_NE(std::string::npos, end);
+      const std::string line = text.substr(begin, end - begin);
+      begin = end + 2;
+      const size_t space = line.rfind(' ');
+      ASSERT_NE(std::string::npos, space);
+      const std::string name = line.substr(0, space);
+      const std::wstring path = VolumePath((int)lines);
+      EXPECT_EQ(std::string(path.begin(), path.end()), name);
+      std::vector<uint8_t> data;
+      ASSERT_FALSE(ReadAll(path, data));
+      const uLong crc = crc32(0L, data.empty() ? Z_NULL : &data[0], (uInt)data.size());
+      EXPECT_EQ((uint32_t)crc, (uint32_t)strtoul(line.substr(space + 1).c_str(), nullptr, 16));
+    }
+    EXPECT_EQ((size_t)count, lines);
+  }
+  void RemoveVolumes() {
+    for (int i = 0; i < 8; i++) {
+      ::DeleteFileW(VolumePath(i).c_str());
+    }
+    ::DeleteFileW((std::wstring(kVolumeBase) + compressor::kVolumeManifestExt).c_str());
+  }
+  HRESULT WriteAt(IOutStream* stream, uint64_t offset, const std::vector<uint8_t>& data) {
+    RINOK(stream->Seek((Int64)offset, STREAM_SEEK_SET, nullptr));
+    UInt32 processed = 0;
+    RINOK(stream->Write(&data[0], (UInt32)data.size(), &processed));
+    return processed == data.size() ? S_OK : E_FAIL;
+  }
+
+}
+
+TEST(MultiVolumeStreamTest, RewritesPatchTheCrc) {
+  RemoveVolumes();
+  std::vector<uint8_t> expected = MakeData(3500, 1);
+  {
+    CMultiVolumeOutStream* spec = new CMultiVolumeOutStream(kVolumeBase, kVolumeSize, true);
+    CMyComPtr<IOutStream> stream(spec);
+    ASSERT_EQ(S_OK, WriteAt(stream, 0, expected));
+    //the 7z start header in the open first volume
+    const std::vector<uint8_t> header = MakeData(32, 2);
+    ASSERT_EQ(S_OK, WriteAt(stream, 0, header));
+    std::copy(header.begin(), header.end(), expected.begin());
+    //a rewrite across the end of a closed volume,it is reopened
+    const std::vector<uint8_t> patch = MakeData(100, 3);
+    ASSERT_EQ(S_OK, WriteAt(stream, 1950, patch));
+    std::copy(patch.begin(), patch.end(), expected.begin() + 1950);
+    EXPECT_EQ(S_OK, spec->Close());
+  }
+  EXPECT_TRUE(ReadVolumes(4) == expected);
+  CheckManifest(4);
+  RemoveVolumes();
+}
+TEST(MultiVolumeStreamTest, SeekPastEndFillsZeros) {
+  RemoveVolumes();
+  const std::vector<uint8_t> head = MakeData(300, 4);
+  const std::vector<uint8_t> tail = MakeData(200, 5);
+  std::vector<uint8_t> expected(head);
+  expected.resize(700, 0);
+  expected.insert(expected.end(), tail.begin(), tail.end());
+  {
+    CMultiVolumeOutStream* spec = new CMultiVolumeOutStream(kVolumeBase, kVolumeSize, true);
+    CMyComPtr<IOutStream> stream(spec);
+    ASSERT_EQ(S_OK, WriteAt(stream, 0, head));
+    //the hole is written out,so the running CRC covers it
+    ASSERT_EQ(S_OK, WriteAt(stream, 700, tail));
+    EXPECT_EQ(S_OK, spec->Close());
+  }
+  EXPECT_TRUE(ReadVolumes(1) == expected);
+  CheckManifest(1);
+  RemoveVolumes();
+}
+TEST(MultiVolumeStreamTest, SetSizeDropsVolumes) {
+  RemoveVolumes();
+  std::vector<uint8_t> expected = MakeData(3500, 6);
+  {
+    CMultiVolumeOutStream* spec = new CMultiVolumeOutStream(kVolumeBase, kVolumeSize, true);
+    CMyComPtr<IOutStream> stream(spec);
+    ASSERT_EQ(S_OK, WriteAt(stream, 0, expected));
+    //the volumes past the new end go,the second one is cut and its CRC
+    //recomputed
+    ASSERT_EQ(S_OK, stream->SetSize(1500));
+    expected.resize(1500);
+    EXPECT_EQ(S_OK, spec->Close());
+  }
+  EXPECT_TRUE(ReadVolumes(2) == expected);
+  EXPECT_TRUE(::GetFileAttributesW(VolumePath(2).c_str()) == INVALID_FILE_ATTRIBUTES);
+  CheckManifest(2);
+  RemoveVolumes();
+}
+TEST(MultiVolumeStreamTest, DiscardDeletesVolumes) {
+  RemoveVolumes();
+  {
+    CMultiVolumeOutStream* spec = new CMultiVolumeOutStream(kVolumeBase, kVolumeSize, true);
+    CMyComPtr<IOutStream> stream(spec);
+    ASSERT_EQ(S_OK, WriteAt(stream, 0, MakeData(2500, 7)));
+    spec->Discard();
+  }
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(::GetFileAttributesW(VolumePath(i).c_str()) == INVALID_FILE_ATTRIBUTES);
+  }
+  EXPECT_TRUE(::GetFileAttributesW((std::wstring(kVolumeBase) + compressor::kVolumeManifestExt).c_str()) == INVALID_FILE_ATTRIBUTES);
+}
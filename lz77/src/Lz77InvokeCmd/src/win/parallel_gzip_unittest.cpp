@@ -0,0 +1,113 @@
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+#include "compressor/byte_ring.h"
+#include "compressor/parallel_gzip.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+namespace {
+
+  class VectorSink : public compressor::GzipSink
+  {
+  public:
+    virtual bool Write(const void* data, size_t size) {
+      const uint8_t* bytes = static_cast<const uint8_t*>(data);
+      out.insert(out.end(), bytes, bytes + size);
+      //success
+      return false;
+    }
+    std::vector<uint8_t> out;
+  };
+
+  bool Gunzip(const std::vector<uint8_t>& in, std::vector<uint8_t>& out) {
+    z_stream stream = {};
+    //16:gzip wrapper,the trailer CRC and size are checked
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+      //fail
+      return true;
+    }
+    stream.next_in = const_cast<Bytef*>(in.data());
+    stream.avail_in = (uInt)in.size();
+    std::vector<uint8_t> buffer(64 * 1024);
+    int res = Z_OK;
+    while (res == Z_OK) {
+      stream.next_out = buffer.data();
+      stream.avail_out = (uInt)buffer.size();
+      res = inflate(&stream, Z_NO_FLUSH);
+      out.insert(out.end(), buffer.data(), buffer.data() + (buffer.size() - stream.avail_out));
+    }
+    const bool fail = (res != Z_STREAM_END) || stream.avail_in != 0;
+    inflateEnd(&stream);
+    return fail;
+  }
+
+  void Encode(const std::vector<uint8_t>& data, int level, unsigned int num_threads, std::vector<uint8_t>& gz) {
+    compressor::ByteRing ring(1024 * 1024);
+    std::thread producer([&]() {
+      //odd pieces,so blocks never line up with the writes
+      const size_t piece = 7919;
+      for (size_t pos = 0; pos < data.size(); pos += piece) {
+        const size_t size = (std::min)(piece, data.size() - pos);
+        if (ring.Write(&data[pos], size)) {
+          //fail
+          break;
+        }
+      }
+      ring.CloseWrite(false);
+    });
+    compressor::ParallelGzipWriter writer(level, num_threads);
+    VectorSink sink;
+    const bool fail = writer.Encode(&ring, &sink, 0);
+    producer.join();
+    ASSERT_FALSE(fail);
+    EXPECT_EQ(data.size(), writer.bytes_in());
+    gz.swap(sink.out);
+  }
+
+}
+
+TEST(ParallelGzipTest, ManyBlocks) {
+  std::vector<uint8_t> data;
+  //text with a long period,so the primed dictionaries matter
+  for (uint32_t i = 0; data.size() < 10 * compressor::kGzipBlockSize + 123; i++) {
+    const std::string line = "line " + std::to_string(i % 1000) + " of the parallel gzip test\n";
+    data.insert(data.end(), line.begin(), line.end());
+  }
+  std::vector<uint8_t> gz;
+  Encode(data, 6, 4, gz);
+  ASSERT_GE(gz.size(), 18u);
+  EXPECT_EQ(0x1f, gz[0]);
+  EXPECT_EQ(0x8b, gz[1]);
+  EXPECT_LT(gz.size(), data.size());
+  std::vector<uint8_t> out;
+  ASSERT_FALSE(Gunzip(gz, out));
+  EXPECT_TRUE(out == data);
+}
+TEST(ParallelGzipTest, Incompressible) {
+  std::vector<uint8_t> data(3 * compressor::kGzipBlockSize);
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < data.size(); i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = (uint8_t)(seed >> 16);
+  }
+  std::vector<uint8_t> gz;
+  Encode(data, 9, 2, gz);
+  std::vector<uint8_t> out;
+  ASSERT_FALSE(Gunzip(gz, out));
+  EXPECT_TRUE(out == data);
+}
+TEST(ParallelGzipTest, Empty) {
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> gz;
+  Encode(data, 6, 4, gz);
+  std::vector<uint8_t> out;
+  ASSERT_FALSE(Gunzip(gz, out));
+  EXPECT_TRUE(out.empty());
+}
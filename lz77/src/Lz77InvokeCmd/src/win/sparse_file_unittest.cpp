@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include "compressor/sparse_file.h"
+#include <gtest\gtest.h>
+#if defined(OS_WIN_X86)
+#pragma comment(lib,"gtest.lib")
+#else
+#pragma comment(lib,"gtest_x64.lib")
+#endif
+
+using compressor::SparseFileWriter;
+using compressor::kSparseMinSize;
+using compressor::kSparseRunSize;
+
+namespace {
+
+  const wchar_t* const kSparsePath = L"sparse_file_unittest.bin";
+
+  //data runs and zero runs,each size a multiple of kSparseRunSize unless noted
+  struct Run
+  {
+    uint64_t size;
+    bool is_zero;
+  };
+
+  std::vector<uint8_t> MakeImage(const std::vector<Run>& runs) {
+    std::vector<uint8_t> image;
+    for (size_t i = 0; i < runs.size(); i++) {
+      const size_t begin = image.size();
+      image.resize(begin + (size_t)runs[i].size, 0);
+      if (!runs[i].is_zero) {
+        for (size_t j = begin; j < image.size(); j++) {
+          image[j] = (uint8_t)((j * 2654435761u) >> 24) | 1;
+        }
+      }
+    }
+    return image;
+  }
+  //writes image in pieces of piece bytes,as a decoder hands them out
+  bool WriteImage(const std::vector<uint8_t>& image, size_t piece, bool is_preallocated) {
+    HANDLE file = ::CreateFileW(kSparsePath, GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+      CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      //fail
+      return true;
+    }
+    SparseFileWriter writer;
+    writer.Attach(file);
+    if (is_preallocated) {
+      writer.Preallocate(image.size());
+    }
+    bool fail = false;
+    for (size_t offset = 0; offset < image.size() && !fail; offset += piece) {
+      const size_t n = (std::min)(piece, image.size() - offset);
+      fail = writer.Write(&image[offset], n);
+    }
+    fail = writer.Finish() || fail;
+    fail = !::CloseHandle(file) || fail;
+    return fail;
+  }
+  bool ReadImage(std::vector<uint8_t>& image) {
+    FILE* file = _wfopen(kSparsePath, L"rb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    uint8_t buffer[64 * 1024];
+    size_t count = 0;
+    image.resize(0);
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      image.insert(image.end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return false;
+  }
+  bool IsSparseVolume() {
+    DWORD flags = 0;
+    if (!::GetVolumeInformationW(nullptr, nullptr, 0, nullptr, nullptr, &flags, nullptr, 0)) {
+      return false;
+    }
+    return (flags & FILE_SUPPORTS_SPARSE_FILES) != 0;
+  }
+  uint64_t AllocatedSize() {
+    DWORD high = 0;
+    const DWORD low = ::GetCompressedFileSizeW(kSparsePath, &high);
+    return ((uint64_t)high << 32) | low;
+  }
+  void RoundTrip(const std::vector<Run>& runs, size_t piece, bool is_preallocated) {
+    const std::vector<uint8_t> image = MakeImage(runs);
+    ASSERT_FALSE(WriteImage(image, piece, is_preallocated));
+    std::vector<uint8_t> read;
+    ASSERT_FALSE(ReadImage(read));
+    ASSERT_EQ(image.size(), read.size());
+    EXPECT_TRUE(read == image);
+  }
+
+}
+
+TEST(SparseFileTest, SmallFileWrittenAsIs) {
+  //below kSparseMinSize nothing is scanned,zero runs are written
+  RoundTrip({ { kSparseRunSize, false }, { 2 * kSparseRunSize, true }, { 100, false } }, 4096, true);
+  EXPECT_EQ(3 * kSparseRunSize + 100, AllocatedSize());
+  ::DeleteFileW(kSparsePath);
+}
+TEST(SparseFileTest, ZeroRunsBecomeHoles) {
+  const uint64_t hole = kSparseMinSize;
+  RoundTrip({ { kSparseRunSize, false }, { hole, true }, { kSparseRunSize + 7, false } }, 256 * 1024 + 3, true);
+  if (IsSparseVolume()) {
+    EXPECT_LT(AllocatedSize(), hole);
+  }
+  ::DeleteFileW(kSparsePath);
+}
+TEST(SparseFileTest, EndsInHole) {
+  //nothing is written after the last seek,Finish sets the end of file
+  RoundTrip({ { 3 * kSparseRunSize, false }, { kSparseMinSize, true } }, kSparseRunSize, true);
+  ::DeleteFileW(kSparsePath);
+}
+TEST(SparseFileTest, UnknownSizeIsNotScanned) {
+  //no Preallocate:the size is unknown,every byte is written
+  RoundTrip({ { kSparseRunSize, false }, { kSparseMinSize, true }, { kSparseRunSize, false } }, 1024 * 1024, false);
+  EXPECT_EQ(kSparseMinSize + 2 * kSparseRunSize, AllocatedSize());
+  ::DeleteFileW(kSparsePath);
+}
@@ -0,0 +1,485 @@
+#include "compressor/archive_index_cache.h"
+#include "compressor/item_table.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <windows.h>
+#include "lz4-dev/lib/xxhash.h"
+
+namespace compressor {
+
+  static const wchar_t* const kIndexCacheDir = L"\\Lz77\\IndexCache";
+  static const wchar_t* const kIndexCacheExt = L".idx";
+  static const wchar_t* const kIndexCacheTempExt = L".tmp";
+  //tells apart the temp files of two writers of the same cache file
+  static std::atomic<uint32_t> temp_serial(0);
+
+  static uint64_t HashPath(const std::wstring& archive_name) {
+    std::wstring lower(archive_name);
+    for (size_t i = 0; i < lower.size(); i++) {
+      lower[i] = towlower(lower[i]);
+    }
+    return XXH64(lower.c_str(), lower.size() * sizeof(wchar_t), 0);
+  }
+
+  static uint64_t ToFileTime(const FILETIME& time) {
+    return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime;
+  }
+
+  static uint64_t NowFileTime() {
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return ToFileTime(now);
+  }
+
+  static bool EndsWith(const wchar_t* name, const wchar_t* ext) {
+    const size_t name_len = wcslen(name);
+    const size_t ext_len = wcslen(ext);
+    return name_len >= ext_len && _wcsicmp(name + name_len - ext_len, ext) == 0;
+  }
+
+  struct IndexCacheFile
+  {
+    std::wstring path;
+    uint64_t size;
+    uint64_t time;
+  };
+
+  bool ArchiveIndexCache::ComputeKey(const std::wstring& archive_name, ArchiveIndexKey& key) {
+    memset(&key, 0, sizeof(key));
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExW(archive_name.c_str(), GetFileExInfoStandard, &data)) {
+      //fail
+      return true;
+    }
+    key.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    key.mtime = ToFileTime(data.ftLastWriteTime);
+    FILE* file = _wfopen(archive_name.c_str(), L"rb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    //7z/zip keep their directory at the tail,tar/iso at the head,hash both ends
+    std::vector<uint8_t> probe(kIndexCacheProbeBytes);
+    XXH64_state_t* state = XXH64_createState();
+    XXH64_reset(state, key.size);
+    size_t count = fread(&probe[0], 1, probe.size(), file);
+    XXH64_update(state, &probe[0], count);
+    if (key.size > kIndexCacheProbeBytes) {
+      _fseeki64(file, -(int64_t)kIndexCacheProbeBytes, SEEK_END);
+      count = fread(&probe[0], 1, probe.size(), file);
+      XXH64_update(state, &probe[0], count);
+    }
+    key.header_hash = XXH64_digest(state);
+    XXH64_freeState(state);
+    fclose(file);
+    //success
+    return false;
+  }
+
+  std::wstring ArchiveIndexCache::CacheDir() {
+    std::wstring cache_dir;
+    const wchar_t* root = _wgetenv(L"LOCALAPPDATA");
+    if (!root) {
+      root = _wgetenv(L"TEMP");
+    }
+    if (!root) {
+      return cache_dir;
+    }
+    cache_dir = root;
+    cache_dir += kIndexCacheDir;
+    return cache_dir;
+  }
+
+  std::wstring ArchiveIndexCache::CachePath(const std::wstring& archive_name) {
+    std::wstring cache_path = CacheDir();
+    if (cache_path.empty()) {
+      return cache_path;
+    }
+    wchar_t name[32] = { 0 };
+    swprintf(name, 32, L"\\%016llx", (unsigned long long)HashPath(archive_name));
+    cache_path += name;
+    cache_path += kIndexCacheExt;
+    return cache_path;
+  }
+
+  ArchiveIndexCache::ArchiveIndexCache() {
+    header_ = nullptr;
+    records_ = nullptr;
+    string_pool_ = nullptr;
+    view_ = nullptr;
+    view_size_ = 0;
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = nullptr;
+  }
+  ArchiveIndexCache::~ArchiveIndexCache() {
+    Close();
+  }
+  void ArchiveIndexCache::Close() {
+    if (view_) {
+      UnmapViewOfFile(view_);
+    }
+    if (mapping_) {
+      CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+    }
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = nullptr;
+    view_ = nullptr;
+    view_size_ = 0;
+    header_ = nullptr;
+    records_ = nullptr;
+    string_pool_ = nullptr;
+  }
+  bool ArchiveIndexCache::Map(const std::wstring& cache_path) {
+    //write attributes only to restamp the file on a hit,see Load
+    file_ = CreateFileW(cache_path.c_str(), GENERIC_READ | FILE_WRITE_ATTRIBUTES,
+      FILE_SHARE_READ | FILE_SHARE_DELETE,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      //fail
+      return true;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart < (LONGLONG)sizeof(ArchiveIndexHeader)) {
+      //fail
+      return true;
+    }
+    mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_) {
+      //fail
+      return true;
+    }
+    view_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    view_size_ = file_size.QuadPart;
+    //fail return true
+    return view_ == nullptr;
+  }
+  bool ArchiveIndexCache::Load(const std::wstring& archive_name) {
+    Close();
+    ArchiveIndexKey key;
+    if (ComputeKey(archive_name, key)) {
+      //fail
+      return true;
+    }
+    const std::wstring cache_path = CachePath(archive_name);
+    if (cache_path.empty() || Map(cache_path)) {
+      Close();
+      //fail
+      return true;
+    }
+    const ArchiveIndexHeader* header = static_cast<const ArchiveIndexHeader*>(view_);
+    const uint64_t records_size = (uint64_t)header->item_count * sizeof(ArchiveIndexRecord);
+    const uint64_t expect_size = sizeof(ArchiveIndexHeader) + records_size +
+      (uint64_t)header->string_pool_size * sizeof(wchar_t);
+    if (memcmp(header->magic, kIndexCacheMagic, sizeof(kIndexCacheMagic)) != 0 ||
+      header->version != kIndexCacheVersion ||
+      header->wchar_size != sizeof(wchar_t) ||
+      header->archive_size != key.size ||
+      header->archive_mtime != key.mtime ||
+      header->header_hash != key.header_hash ||
+      expect_size != view_size_) {
+      //stale or foreign cache
+      Close();
+      return true;
+    }
+    header_ = header;
+    records_ = reinterpret_cast<const ArchiveIndexRecord*>(header + 1);
+    string_pool_ = reinterpret_cast<const wchar_t*>(records_ + header->item_count);
+    if (!IsValid()) {
+      //a truncated or corrupt file,parse the archive instead
+      Close();
+      return true;
+    }
+    //the write time is the last use,Prune keeps the files in use
+    FILETIME write_time;
+    const uint64_t now = NowFileTime();
+    if (GetFileTime(file_, nullptr, nullptr, &write_time) &&
+      now > ToFileTime(write_time) + kIndexCacheTouchInterval) {
+      write_time.dwLowDateTime = (DWORD)now;
+      write_time.dwHighDateTime = (DWORD)(now >> 32);
+      SetFileTime(file_, nullptr, nullptr, &write_time);
+    }
+    //success
+    return false;
+  }
+  bool ArchiveIndexCache::IsValid() const {
+    const uint64_t pool_size = header_->string_pool_size;
+    for (uint32_t i = 0; i < header_->item_count; i++) {
+      const ArchiveIndexRecord& rec = records_[i];
+      if ((uint64_t)rec.path_offset + rec.path_len > pool_size) {
+        return false;
+      }
+    }
+    return true;
+  }
+  bool ArchiveIndexCache::BuildRecords(C7ZipArchive* archive,
+    std::vector<ArchiveIndexRecord>& records,
+    std::wstring& string_pool) {
+    unsigned int num_items = 0;
+    if (!archive || !archive->GetItemCount(&num_items)) {
+      //fail
+      return true;
+    }
+    //columns first,then the per item extras by index:no item objects
+    ItemTable table;
+    if (!archive->ReadItemTable(table) || table.size() != num_items) {
+      //fail
+      return true;
+    }
+    records.resize(num_items);
+    string_pool.resize(0);
+    for (unsigned int i = 0; i < num_items; i++) {
+      ArchiveIndexRecord& record = records[i];
+      memset(&record, 0, sizeof(record));
+      record.block = kIndexCacheNoBlock;
+      const std::wstring rpath = table.Path(i);
+      record.path_offset = (uint32_t)string_pool.size();
+      record.path_len = (uint32_t)rpath.size();
+      string_pool += rpath;
+      record.size = table.Size(i);
+      record.attrib = table.Attrib(i);
+      unsigned __int64 value = 0;
+      if (archive->GetItemUInt64Property(i, lib7zip::kpidCRC, value)) {
+        record.crc = (uint32_t)value;
+        record.flags |= kIndexFlagCRCDefined;
+      }
+      if (archive->GetItemUInt64Property(i, lib7zip::kpidBlock, value)) {
+        record.block = (uint32_t)value;
+      }
+      if (archive->GetItemUInt64Property(i, lib7zip::kpidOffset, value)) {
+        record.offset = value;
+      }
+      if (table.IsDir(i)) {
+        record.flags |= kIndexFlagDir;
+      }
+      bool is_encrypted = false;
+      if (archive->GetItemBoolProperty(i, lib7zip::kpidEncrypted, is_encrypted) && is_encrypted) {
+        record.flags |= kIndexFlagEncrypted;
+      }
+    }
+    //success
+    return false;
+  }
+  void ArchiveIndexCache::ToEntry(const ArchiveIndexRecord& rec,
+    const wchar_t* string_pool,
+    ArchiveIndexEntry& entry) {
+    entry.path.assign(string_pool + rec.path_offset, rec.path_len);
+    entry.size = rec.size;
+    entry.offset = rec.offset;
+    entry.crc = rec.crc;
+    entry.attrib = rec.attrib;
+    entry.block = rec.block;
+    entry.is_dir = (rec.flags & kIndexFlagDir) != 0;
+    entry.is_encrypted = (rec.flags & kIndexFlagEncrypted) != 0;
+    entry.crc_defined = (rec.flags & kIndexFlagCRCDefined) != 0;
+  }
+  bool ArchiveIndexCache::ReadEntries(C7ZipArchive* archive, std::vector<ArchiveIndexEntry>& entries) {
+    std::vector<ArchiveIndexRecord> records;
+    std::wstring string_pool;
+    if (BuildRecords(archive, records, string_pool)) {
+      //fail
+      return true;
+    }
+    entries.resize(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+      ToEntry(records[i], string_pool.c_str(), entries[i]);
+    }
+    //success
+    return false;
+  }
+  bool ArchiveIndexCache::Prepare(const std::wstring& archive_name, C7ZipArchive* archive,
+    ArchiveIndexPending& pending) {
+    ArchiveIndexKey key;
+    if (ComputeKey(archive_name, key) || BuildRecords(archive, pending.records, pending.string_pool)) {
+      //fail
+      return true;
+    }
+    pending.archive_name = archive_name;
+    ArchiveIndexHeader& header = pending.header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kIndexCacheMagic, sizeof(kIndexCacheMagic));
+    header.version = kIndexCacheVersion;
+    header.wchar_size = sizeof(wchar_t);
+    header.archive_size = key.size;
+    header.archive_mtime = key.mtime;
+    header.header_hash = key.header_hash;
+    header.item_count = (uint32_t)pending.records.size();
+    header.string_pool_size = (uint32_t)pending.string_pool.size();
+    //success
+    return false;
+  }
+  bool ArchiveIndexCache::Write(const ArchiveIndexPending& pending) {
+    const std::wstring cache_path = CachePath(pending.archive_name);
+    if (cache_path.empty()) {
+      //fail
+      return true;
+    }
+    const uint32_t num_items = pending.header.item_count;
+    const std::wstring& string_pool = pending.string_pool;
+    //write beside the final name and rename,readers never see a torn file;
+    //the temp name is unique so two processes never write the same one
+    wchar_t suffix[48] = { 0 };
+    swprintf(suffix, 48, L".%lx.%lx%ls", (unsigned long)GetCurrentProcessId(),
+      (unsigned long)temp_serial.fetch_add(1), kIndexCacheTempExt);
+    const std::wstring temp_path = cache_path + suffix;
+    const std::wstring cache_dir = CacheDir();
+    CreateDirectoryW(cache_dir.substr(0, cache_dir.find_last_of(L"\\")).c_str(), nullptr);
+    CreateDirectoryW(cache_dir.c_str(), nullptr);
+    FILE* file = _wfopen(temp_path.c_str(), L"wb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    bool fail = (fwrite(&pending.header, sizeof(pending.header), 1, file) != 1);
+    if (!fail && num_items) {
+      fail = (fwrite(&pending.records[0], sizeof(ArchiveIndexRecord), num_items, file) != num_items);
+    }
+    if (!fail && string_pool.size()) {
+      fail = (fwrite(string_pool.c_str(), sizeof(wchar_t), string_pool.size(), file) != string_pool.size());
+    }
+    fail = (fclose(file) != 0) || fail;
+    if (fail || !MoveFileExW(temp_path.c_str(), cache_path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+      DeleteFileW(temp_path.c_str());
+      //fail
+      return true;
+    }
+    //success
+    return false;
+  }
+  void ArchiveIndexCache::Prune() {
+    const std::wstring cache_dir = CacheDir();
+    if (cache_dir.empty()) {
+      return;
+    }
+    WIN32_FIND_DATAW data;
+    HANDLE find = FindFirstFileW((cache_dir + L"\\*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    const uint64_t now = NowFileTime();
+    std::vector<IndexCacheFile> files;
+    uint64_t total_size = 0;
+    do {
+      if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+        continue;
+      }
+      IndexCacheFile file;
+      file.path = cache_dir + L"\\" + data.cFileName;
+      file.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+      file.time = ToFileTime(data.ftLastWriteTime);
+      if (EndsWith(data.cFileName, kIndexCacheTempExt)) {
+        //left behind by a writer that never got to the rename
+        if (now > file.time + kIndexCacheTempAge) {
+          DeleteFileW(file.path.c_str());
+        }
+      }
+      else if (EndsWith(data.cFileName, kIndexCacheExt)) {
+        if (now > file.time + kIndexCacheMaxAge) {
+          DeleteFileW(file.path.c_str());
+        }
+        else {
+          total_size += file.size;
+          files.push_back(file);
+        }
+      }
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+    if (total_size <= kIndexCacheMaxBytes) {
+      return;
+    }
+    std::sort(files.begin(), files.end(), [](const IndexCacheFile& a, const IndexCacheFile& b) {
+      return a.time < b.time;
+    });
+    for (size_t i = 0; i < files.size() && total_size > kIndexCacheMaxBytes; i++) {
+      //a mapped file goes once its reader closes it,FILE_SHARE_DELETE in Map
+      if (DeleteFileW(files[i].path.c_str())) {
+        total_size -= files[i].size;
+      }
+    }
+  }
+  const wchar_t* ArchiveIndexCache::path(uint32_t index, uint32_t* len) const {
+    const ArchiveIndexRecord& rec = records_[index];
+    if (len) {
+      *len = rec.path_len;
+    }
+    return string_pool_ + rec.path_offset;
+  }
+  bool ArchiveIndexCache::IsFirstFileEncrypted() const {
+    //same walk as Wrapper7zCompress::TestAttributeFlag:stop at the first file
+    for (uint32_t i = 0; i < size(); i++) {
+      const ArchiveIndexRecord& rec = records_[i];
+      if (rec.flags & kIndexFlagEncrypted) {
+        return true;
+      }
+      if (!(rec.flags & kIndexFlagDir)) {
+        break;
+      }
+    }
+    return false;
+  }
+  void ArchiveIndexCache::GetEntries(std::vector<ArchiveIndexEntry>& entries) const {
+    entries.resize(size());
+    for (uint32_t i = 0; i < size(); i++) {
+      ToEntry(records_[i], string_pool_, entries[i]);
+    }
+  }
+
+
+  ArchiveIndexBatch::ArchiveIndexBatch() {
+    pending_.resize(0);
+  }
+  ArchiveIndexBatch::~ArchiveIndexBatch() {
+    Flush();
+  }
+  bool ArchiveIndexBatch::Stage(const std::wstring& archive_name, C7ZipArchive* archive) {
+    ArchiveIndexPending pending;
+    //the records come from the archive while it is open,the write waits
+    if (ArchiveIndexCache::Prepare(archive_name, archive, pending)) {
+      //fail
+      return true;
+    }
+    std::lock_guard<std::mutex> lock(lock_);
+    for (size_t i = 0; i < pending_.size(); i++) {
+      if (pending_[i].archive_name == archive_name) {
+        pending_[i] = std::move(pending);
+        //success
+        return false;
+      }
+    }
+    pending_.push_back(std::move(pending));
+    if (pending_.size() >= kIndexCacheBatchSize) {
+      FlushLocked();
+    }
+    //success
+    return false;
+  }
+  void ArchiveIndexBatch::FlushIfStaged(const std::wstring& archive_name) {
+    std::lock_guard<std::mutex> lock(lock_);
+    for (size_t i = 0; i < pending_.size(); i++) {
+      if (pending_[i].archive_name == archive_name) {
+        FlushLocked();
+        return;
+      }
+    }
+  }
+  void ArchiveIndexBatch::Flush() {
+    std::lock_guard<std::mutex> lock(lock_);
+    FlushLocked();
+  }
+  void ArchiveIndexBatch::FlushLocked() {
+    if (pending_.empty()) {
+      return;
+    }
+    for (size_t i = 0; i < pending_.size(); i++) {
+      //a cache that cannot be written is only a later miss
+      ArchiveIndexCache::Write(pending_[i]);
+    }
+    pending_.resize(0);
+    ArchiveIndexCache::Prune();
+  }
+
+}
@@ -0,0 +1,161 @@
+#ifndef COMPRESSOR_ARCHIVE_INDEX_CACHE_H_
+#define COMPRESSOR_ARCHIVE_INDEX_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "lib7zip/Lib7Zip/lib7zip.h"
+
+namespace compressor {
+
+  static const char kIndexCacheMagic[8] = { 'L','Z','7','7','I','D','X','1' };
+  static const uint32_t kIndexCacheVersion = 1;
+  static const uint32_t kIndexCacheProbeBytes = 64 * 1024;
+  static const uint32_t kIndexCacheNoBlock = 0xFFFFFFFF;
+  //listings kept in memory before they are written out together
+  static const size_t kIndexCacheBatchSize = 32;
+  //the cache folder is pruned to this,least recently used files first
+  static const uint64_t kIndexCacheMaxBytes = 64 * 1024 * 1024;
+  //in 100ns file time units:30 days unused and a file is dropped
+  static const uint64_t kIndexCacheMaxAge = 30ULL * 24 * 3600 * 10000000;
+  //a hit restamps its file at most this often,one day
+  static const uint64_t kIndexCacheTouchInterval = 24ULL * 3600 * 10000000;
+  //temp files of a writer that died are removed after one hour
+  static const uint64_t kIndexCacheTempAge = 3600ULL * 10000000;
+
+  //the key of one cache file,all fields must match the archive on disk
+  struct ArchiveIndexKey
+  {
+    uint64_t size;
+    uint64_t mtime;
+    uint64_t header_hash;
+  };
+
+  enum ArchiveIndexFlag
+  {
+    kIndexFlagDir = 1 << 0,
+    kIndexFlagEncrypted = 1 << 1,
+    kIndexFlagCRCDefined = 1 << 2
+  };
+
+#pragma pack(push, 8)
+  struct ArchiveIndexHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t wchar_size;
+    uint64_t archive_size;
+    uint64_t archive_mtime;
+    uint64_t header_hash;
+    uint32_t item_count;
+    uint32_t string_pool_size;
+  };
+
+  struct ArchiveIndexRecord
+  {
+    uint64_t size;
+    uint64_t offset;
+    uint32_t crc;
+    uint32_t attrib;
+    uint32_t block;
+    uint32_t flags;
+    uint32_t path_offset;
+    uint32_t path_len;
+  };
+#pragma pack(pop)
+
+  struct ArchiveIndexEntry
+  {
+    std::wstring path;
+    uint64_t size;
+    uint64_t offset;
+    uint32_t crc;
+    uint32_t attrib;
+    uint32_t block;
+    bool is_dir;
+    bool is_encrypted;
+    bool crc_defined;
+  };
+
+  //one cache file built from an open archive,not yet on disk
+  struct ArchiveIndexPending
+  {
+    std::wstring archive_name;
+    ArchiveIndexHeader header;
+    std::vector<ArchiveIndexRecord> records;
+    std::wstring string_pool;
+  };
+
+  //On-disk listing cache of an archive,keyed by (path, size, mtime, header hash).
+  //The file is a fixed header,an array of ArchiveIndexRecord and a wchar_t string
+  //pool,so a loaded cache is served straight from the mapped view.
+  class ArchiveIndexCache
+  {
+  public:
+    static bool ComputeKey(const std::wstring& archive_name, ArchiveIndexKey& key);
+    static std::wstring CacheDir();
+    static std::wstring CachePath(const std::wstring& archive_name);
+    static bool ReadEntries(C7ZipArchive* archive, std::vector<ArchiveIndexEntry>& entries);
+    static bool Prepare(const std::wstring& archive_name, C7ZipArchive* archive,
+      ArchiveIndexPending& pending);
+    static bool Write(const ArchiveIndexPending& pending);
+    //drops files unused for kIndexCacheMaxAge,then the least recently
+    //used ones until the folder fits in kIndexCacheMaxBytes
+    static void Prune();
+    ArchiveIndexCache();
+    virtual ~ArchiveIndexCache();
+    bool Load(const std::wstring& archive_name);
+    void Close();
+    bool IsLoaded() const {
+      return header_ != nullptr;
+    }
+    uint32_t size() const {
+      return header_ ? header_->item_count : 0;
+    }
+    const ArchiveIndexRecord& record(uint32_t index) const {
+      return records_[index];
+    }
+    const wchar_t* path(uint32_t index, uint32_t* len) const;
+    bool IsFirstFileEncrypted() const;
+    void GetEntries(std::vector<ArchiveIndexEntry>& entries) const;
+  private:
+    static bool BuildRecords(C7ZipArchive* archive,
+      std::vector<ArchiveIndexRecord>& records,
+      std::wstring& string_pool);
+    static void ToEntry(const ArchiveIndexRecord& rec,
+      const wchar_t* string_pool,
+      ArchiveIndexEntry& entry);
+    bool Map(const std::wstring& cache_path);
+    bool IsValid() const;
+    const ArchiveIndexHeader* header_;
+    const ArchiveIndexRecord* records_;
+    const wchar_t* string_pool_;
+    void* view_;
+    uint64_t view_size_;
+    void* file_;
+    void* mapping_;
+  };
+
+  //Collects the listings of archives that missed the cache and writes them
+  //in one go,when the batch is full,before one of them is looked up again
+  //and when the batch goes away,so a run of probes is not a run of rewrites.
+  //Every flush also prunes the cache folder.
+  class ArchiveIndexBatch
+  {
+  public:
+    ArchiveIndexBatch();
+    virtual ~ArchiveIndexBatch();
+    bool Stage(const std::wstring& archive_name, C7ZipArchive* archive);
+    //writes the batch if archive_name is waiting in it
+    void FlushIfStaged(const std::wstring& archive_name);
+    void Flush();
+  private:
+    void FlushLocked();
+    std::mutex lock_;
+    std::vector<ArchiveIndexPending> pending_;
+  };
+
+}
+
+#endif // !COMPRESSOR_ARCHIVE_INDEX_CACHE_H_
@@ -0,0 +1,132 @@
+#include "compressor/archive_session.h"
+#include "base/path.h"
+
+namespace compressor {
+
+  static const wchar_t k7zFmtMulVolumeExt[] = L".001";
+
+  ArchiveSession::ArchiveSession(C7ZipLibrary* lib) :lib_(lib) {
+    archive_ = nullptr;
+    volumes_ = nullptr;
+    stream_ = nullptr;
+    item_count_ = 0;
+    need_password_ = false;
+    stats_ = nullptr;
+  }
+  ArchiveSession::~ArchiveSession() {
+    Close();
+  }
+  void ArchiveSession::Close() {
+    if (archive_ != nullptr) {
+      delete archive_;
+      archive_ = nullptr;
+    }
+    if (volumes_ != nullptr) {
+      delete volumes_;
+      volumes_ = nullptr;
+    }
+    if (stream_ != nullptr) {
+      delete stream_;
+      stream_ = nullptr;
+    }
+    archive_name_.resize(0);
+    ext_.resize(0);
+    item_count_ = 0;
+    need_password_ = false;
+  }
+  bool ArchiveSession::Open(const std::wstring& archive_name, const std::wstring& password) {
+    Close();
+    base::Path path(archive_name);
+    if (!path.IsFile()) {
+      //fail
+      return true;
+    }
+    archive_name_ = archive_name;
+    ext_ = path.ext();
+    {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kOpen);
+      if (wcsncmp(ext_.c_str(), k7zFmtMulVolumeExt,
+        sizeof(k7zFmtMulVolumeExt) / sizeof(wchar_t) - 1) == 0) {
+        volumes_ = new Wrapper7zMultiVolumes(archive_name);
+      }
+      else {
+        stream_ = new Wrapper7zInStream(archive_name, ext_);
+      }
+    }
+    return OpenStreams(password);
+  }
+  bool ArchiveSession::OpenStreams(const std::wstring& password) {
+    bool opened = false;
+    {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kHeaderParse);
+      if (volumes_) {
+        opened = lib_->OpenMultiVolumeArchive(volumes_, &archive_, password, true);
+      }
+      else {
+        opened = lib_->OpenArchive(stream_, &archive_, password, true);
+      }
+    }
+    if (!opened) {
+      archive_ = nullptr;
+      need_password_ = (lib_->GetLastError() == lib7zip::LIB7ZIP_NEED_PASSWORD);
+      //fail
+      return true;
+    }
+    need_password_ = false;
+    archive_->SetStats(stats_);
+    archive_->GetItemCount(&item_count_);
+    if (password.length() > 0) {
+      archive_->SetArchivePassword(password);
+    }
+    //success
+    return false;
+  }
+  bool ArchiveSession::Unlock(const std::wstring& password) {
+    if (archive_) {
+      if (password.length() > 0) {
+        archive_->SetArchivePassword(password);
+      }
+      //success
+      return false;
+    }
+    if (!need_password_ || password.empty()) {
+      //fail
+      return true;
+    }
+    //encrypted headers:the item table can only be read with the password
+    return OpenStreams(password);
+  }
+  bool ArchiveSession::Test() {
+    if (!archive_) {
+      //fail
+      return true;
+    }
+    return !archive_->ExtractTest(nullptr, nullptr);
+  }
+  void ArchiveSession::SetStats(OperationStats* stats) {
+    stats_ = stats;
+    if (archive_) {
+      archive_->SetStats(stats_);
+    }
+  }
+  bool ArchiveSession::IsFirstFileEncrypted() const {
+    bool is_encrypted = false;
+    for (unsigned int i = 0; archive_ && i < item_count_; i++) {
+      C7ZipArchiveItem * archive_item = NULL;
+      if (!archive_->GetItemInfo(i, &archive_item)) {
+        continue;
+      }
+      archive_item->GetBoolProperty(lib7zip::kpidEncrypted, is_encrypted);
+      if (is_encrypted) {
+        break;
+      }
+      bool is_dir = false;
+      archive_item->GetBoolProperty(lib7zip::kpidIsDir, is_dir);
+      if (!is_dir) {
+        break;
+      }
+    }
+    return is_encrypted;
+  }
+
+}
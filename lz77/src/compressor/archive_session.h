@@ -0,0 +1,60 @@
+#ifndef COMPRESSOR_ARCHIVE_SESSION_H_
+#define COMPRESSOR_ARCHIVE_SESSION_H_
+
+#include <string>
+#include "lib7zip/Lib7Zip/lib7zip.h"
+#include "compressor/lib7zip_wrapper.h"
+#include "compressor/operation_stats.h"
+
+namespace compressor {
+
+  //Opens an archive once and keeps the IInArchive,its item table and the
+  //password state alive,so probe,list,test and extract share one header parse.
+  class ArchiveSession
+  {
+  public:
+    explicit ArchiveSession(C7ZipLibrary* lib);
+    virtual ~ArchiveSession();
+    bool Open(const std::wstring& archive_name, const std::wstring& password);
+    bool Unlock(const std::wstring& password);
+    bool Test();
+    void Close();
+    bool IsSame(const std::wstring& archive_name) const {
+      return (archive_ != nullptr || need_password_) && archive_name_ == archive_name;
+    }
+    bool IsOpen() const {
+      return archive_ != nullptr;
+    }
+    bool NeedPassword() const {
+      return need_password_;
+    }
+    bool IsFirstFileEncrypted() const;
+    void SetStats(OperationStats* stats);
+    OperationStats* stats() const {
+      return stats_;
+    }
+    C7ZipArchive* archive() {
+      return archive_;
+    }
+    unsigned int item_count() const {
+      return item_count_;
+    }
+    const std::wstring& archive_name() const {
+      return archive_name_;
+    }
+  private:
+    bool OpenStreams(const std::wstring& password);
+    C7ZipLibrary* lib_;
+    C7ZipArchive* archive_;
+    Wrapper7zMultiVolumes* volumes_;
+    Wrapper7zInStream* stream_;
+    std::wstring archive_name_;
+    std::wstring ext_;
+    unsigned int item_count_;
+    bool need_password_;
+    OperationStats* stats_;
+  };
+
+}
+
+#endif // !COMPRESSOR_ARCHIVE_SESSION_H_
@@ -0,0 +1,165 @@
+#include "compressor/archive_tester.h"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "compressor/archive_session.h"
+
+namespace compressor {
+
+  ArchiveTester::ArchiveTester(C7ZipLibrary* lib) :lib_(lib) {
+    first_error_msg_.resize(0);
+  }
+  ArchiveTester::~ArchiveTester() {
+    first_error_msg_.resize(0);
+  }
+  const wchar_t* ArchiveTester::StatusName(ItemTestStatus status) {
+    switch (status) {
+    case ItemTestStatus::kNotTested:
+      return L"kNotTested";
+    case ItemTestStatus::kOK:
+      return L"kOK";
+    case ItemTestStatus::kUnsupportedMethod:
+      return L"kUnsupportedMethod";
+    case ItemTestStatus::kDataError:
+      return L"kDataError";
+    case ItemTestStatus::kCrcError:
+      return L"kCrcFailed";
+    case ItemTestStatus::kUnavailable:
+      return L"kUnavailableData";
+    case ItemTestStatus::kUnexpectedEnd:
+      return L"kUnexpectedEnd";
+    case ItemTestStatus::kDataAfterEnd:
+      return L"kDataAfterEnd";
+    case ItemTestStatus::kIsNotArc:
+      return L"kIsNotArc";
+    case ItemTestStatus::kHeadersError:
+      return L"kHeadersError";
+    case ItemTestStatus::kWrongPassword:
+      return L"kWrongPassword";
+    }
+    return L"kError";
+  }
+  void ArchiveTester::GroupItems(C7ZipArchive* archive,
+    std::vector<ItemTestResult>& results,
+    std::vector<TestGroup>& groups) {
+    unsigned int item_count = 0;
+    archive->GetItemCount(&item_count);
+    results.resize(item_count);
+    groups.resize(0);
+    std::map<uint64_t, size_t> block_groups;
+    for (unsigned int i = 0; i < item_count; i++) {
+      ItemTestResult& result = results[i];
+      result.index = i;
+      result.size = 0;
+      result.is_dir = false;
+      result.status = ItemTestStatus::kNotTested;
+      result.path = archive->GetItemFullPath(i);
+      archive->GetItemBoolProperty(i, lib7zip::kpidIsDir, result.is_dir);
+      unsigned __int64 size = 0;
+      if (archive->GetItemUInt64Property(i, lib7zip::kpidSize, size)) {
+        result.size = size;
+      }
+      if (result.is_dir) {
+        //nothing to decode
+        result.status = ItemTestStatus::kOK;
+        continue;
+      }
+      unsigned __int64 block = 0;
+      if (!archive->GetItemUInt64Property(i, lib7zip::kpidBlock, block)) {
+        //no solid block (zip entry,empty 7z file):independent unit
+        TestGroup group;
+        group.indices.push_back(i);
+        group.size = result.size;
+        groups.push_back(group);
+        continue;
+      }
+      std::map<uint64_t, size_t>::iterator it = block_groups.find(block);
+      if (it == block_groups.end()) {
+        it = block_groups.insert(std::make_pair(block, groups.size())).first;
+        groups.push_back(TestGroup());
+        groups.back().size = 0;
+      }
+      groups[it->second].indices.push_back(i);
+      groups[it->second].size += result.size;
+    }
+    //largest first,so one big block does not start last
+    std::stable_sort(groups.begin(), groups.end(), [](const TestGroup& a, const TestGroup& b) {
+      return a.size > b.size;
+    });
+  }
+  bool ArchiveTester::Run(const std::wstring& archive_name,
+    const std::wstring& password,
+    unsigned int worker_count,
+    std::vector<ItemTestResult>& results) {
+    results.resize(0);
+    first_error_msg_.resize(0);
+    std::mutex lock;
+    ArchiveSession probe(lib_);
+    probe.Open(archive_name, password);
+    if (probe.Unlock(password)) {
+      //fail
+      return true;
+    }
+    std::vector<TestGroup> groups;
+    GroupItems(probe.archive(), results, groups);
+    if (worker_count == 0) {
+      worker_count = std::thread::hardware_concurrency();
+    }
+    worker_count = (std::max)(1u, (std::min)(worker_count, static_cast<unsigned int>(groups.size())));
+    std::atomic<size_t> next_group(0);
+    auto worker = [&](unsigned int worker_id) {
+      std::unique_ptr<ArchiveSession> own_session;
+      ArchiveSession* session = &probe;
+      if (worker_id != 0) {
+        //handlers are not reentrant,every worker decodes from its own instance
+        std::lock_guard<std::mutex> open_lock(lock);
+        own_session.reset(new ArchiveSession(lib_));
+        own_session->Open(archive_name, password);
+        if (own_session->Unlock(password)) {
+          return;
+        }
+        session = own_session.get();
+      }
+      C7ZipArchive* archive = session->archive();
+      //one slot per item,TestItems only rewrites the slots of its group
+      std::vector<int> codes(results.size(), -1);
+      for (;;) {
+        const size_t g = next_group++;
+        if (g >= groups.size()) {
+          break;
+        }
+        const bool is_ok = archive->TestItems(groups[g].indices, codes);
+        for (size_t j = 0; j < groups[g].indices.size(); j++) {
+          const unsigned int index = groups[g].indices[j];
+          results[index].status = static_cast<ItemTestStatus>(codes[index]);
+        }
+        if (!is_ok) {
+          std::lock_guard<std::mutex> msg_lock(lock);
+          if (first_error_msg_.empty()) {
+            first_error_msg_ = archive->OpResMsg();
+          }
+        }
+      }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int i = 1; i < worker_count; i++) {
+      workers.push_back(std::thread(worker, i));
+    }
+    worker(0);
+    for (size_t i = 0; i < workers.size(); i++) {
+      workers[i].join();
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+      if (results[i].status != ItemTestStatus::kOK) {
+        //fail
+        return true;
+      }
+    }
+    //success
+    return false;
+  }
+
+}
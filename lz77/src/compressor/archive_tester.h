@@ -0,0 +1,68 @@
+#ifndef COMPRESSOR_ARCHIVE_TESTER_H_
+#define COMPRESSOR_ARCHIVE_TESTER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "lib7zip/Lib7Zip/lib7zip.h"
+
+namespace compressor {
+
+  //values match NArchive::NExtract::NOperationResult
+  enum class ItemTestStatus
+  {
+    kNotTested = -1,
+    kOK = 0,
+    kUnsupportedMethod,
+    kDataError,
+    kCrcError,
+    kUnavailable,
+    kUnexpectedEnd,
+    kDataAfterEnd,
+    kIsNotArc,
+    kHeadersError,
+    kWrongPassword
+  };
+
+  struct ItemTestResult
+  {
+    unsigned int index;
+    std::wstring path;
+    uint64_t size;
+    bool is_dir;
+    ItemTestStatus status;
+  };
+
+  //Verifies every item without writing anything. Items are grouped by solid
+  //block (one group per entry for formats without blocks,e.g. zip) and the
+  //groups are spread over workers,each with its own opened archive,since a
+  //handler instance can only decode one stream at a time.
+  class ArchiveTester
+  {
+  public:
+    explicit ArchiveTester(C7ZipLibrary* lib);
+    virtual ~ArchiveTester();
+    bool Run(const std::wstring& archive_name,
+      const std::wstring& password,
+      unsigned int worker_count,
+      std::vector<ItemTestResult>& results);
+    const std::wstring& first_error_msg() const {
+      return first_error_msg_;
+    }
+    static const wchar_t* StatusName(ItemTestStatus status);
+  private:
+    struct TestGroup
+    {
+      std::vector<unsigned int> indices;
+      uint64_t size;
+    };
+    static void GroupItems(C7ZipArchive* archive,
+      std::vector<ItemTestResult>& results,
+      std::vector<TestGroup>& groups);
+    C7ZipLibrary* lib_;
+    std::wstring first_error_msg_;
+  };
+
+}
+
+#endif // !COMPRESSOR_ARCHIVE_TESTER_H_
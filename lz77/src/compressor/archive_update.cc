@@ -0,0 +1,87 @@
+#include "compressor/archive_update.h"
+#include <cstdio>
+#include <vector>
+#include <zlib.h>
+
+namespace compressor {
+
+  ArchiveItemMatcher::ArchiveItemMatcher() {
+    Reset(0);
+  }
+  ArchiveItemMatcher::~ArchiveItemMatcher() {
+    items_.clear();
+  }
+  void ArchiveItemMatcher::Reset(uint64_t time_tolerance) {
+    items_.clear();
+    time_tolerance_ = time_tolerance;
+  }
+  std::wstring ArchiveItemMatcher::NormalizePath(const std::wstring& path) {
+    //handlers report either separator depending on the format
+    std::wstring normal = path;
+    for (size_t i = 0; i < normal.size(); i++) {
+      if (normal[i] == L'/') {
+        normal[i] = L'\\';
+      }
+    }
+    return normal;
+  }
+  bool ArchiveItemMatcher::IsUpdatable(const std::wstring& ext) {
+    for (size_t i = 0; kUpdatableArchiveTable[i] != nullptr; i++) {
+      if (ext == kUpdatableArchiveTable[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+  void ArchiveItemMatcher::Add(const std::wstring& path, const ArchivedItem& item) {
+    //a path stored twice keeps its last copy,as extraction would
+    items_[NormalizePath(path)] = item;
+  }
+  uint32_t ArchiveItemMatcher::Match(const std::wstring& path,
+    uint64_t size,
+    uint64_t mtime,
+    const std::wstring& full_path,
+    bool verify_crc) const {
+    std::unordered_map<std::wstring, ArchivedItem>::const_iterator it = items_.find(NormalizePath(path));
+    if (it == items_.end()) {
+      return kNoArchiveIndex;
+    }
+    const ArchivedItem& item = it->second;
+    if (item.size != size || !item.mtime) {
+      return kNoArchiveIndex;
+    }
+    const uint64_t delta = (item.mtime > mtime) ? item.mtime - mtime : mtime - item.mtime;
+    if (delta > time_tolerance_) {
+      return kNoArchiveIndex;
+    }
+    if (verify_crc && item.has_crc) {
+      uint32_t crc = 0;
+      if (FileCrc(full_path, crc) || crc != item.crc) {
+        return kNoArchiveIndex;
+      }
+    }
+    return item.index;
+  }
+  bool ArchiveItemMatcher::FileCrc(const std::wstring& path, uint32_t& crc) {
+#if defined(OS_WIN)
+    FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+    FILE* file = fopen(std::string(path.begin(), path.end()).c_str(), "rb");
+#endif
+    if (!file) {
+      //fail
+      return true;
+    }
+    std::vector<uint8_t> buffer(kUpdateCrcBufferSize);
+    uLong value = crc32(0L, Z_NULL, 0);
+    size_t count = 0;
+    while ((count = fread(&buffer[0], 1, buffer.size(), file)) > 0) {
+      value = crc32(value, &buffer[0], (uInt)count);
+    }
+    const bool fail = ferror(file) != 0;
+    fclose(file);
+    crc = (uint32_t)value;
+    return fail;
+  }
+
+}
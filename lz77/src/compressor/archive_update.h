@@ -0,0 +1,57 @@
+#ifndef COMPRESSOR_ARCHIVE_UPDATE_H_
+#define COMPRESSOR_ARCHIVE_UPDATE_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace compressor {
+
+  enum class ArchiveUpdateMode { kCreate, kUpdate, kUpdateVerifyCrc };
+
+  //formats whose handler can copy packed items from the opened archive
+  static const wchar_t *kUpdatableArchiveTable[] = { L"7z", L"zip", L"tar", L"wim", nullptr };
+  //zip/tar keep DOS/unix times,2 s covers the rounding
+  static const uint64_t kUpdateTimeTolerance = 2 * 10000000ull;
+  static const uint32_t kNoArchiveIndex = 0xFFFFFFFF;
+  static const size_t kUpdateCrcBufferSize = 1024 * 1024;
+
+  struct ArchivedItem
+  {
+    uint32_t index;
+    uint64_t size;
+    uint64_t mtime; //FILETIME ticks,0:unknown
+    uint32_t crc;
+    bool has_crc;
+  };
+
+  //Index of the items already in the archive being updated. A file whose
+  //path,size and mtime match keeps its packed data (newData=false);with
+  //verify_crc it must also match the stored CRC,which costs a read of the
+  //file but still no compression.
+  class ArchiveItemMatcher
+  {
+  public:
+    ArchiveItemMatcher();
+    virtual ~ArchiveItemMatcher();
+    void Reset(uint64_t time_tolerance);
+    void Add(const std::wstring& path, const ArchivedItem& item);
+    uint32_t Match(const std::wstring& path,
+      uint64_t size,
+      uint64_t mtime,
+      const std::wstring& full_path,
+      bool verify_crc) const;
+    size_t size() const {
+      return items_.size();
+    }
+    static bool IsUpdatable(const std::wstring& ext);
+    static bool FileCrc(const std::wstring& path, uint32_t& crc);
+  private:
+    static std::wstring NormalizePath(const std::wstring& path);
+    std::unordered_map<std::wstring, ArchivedItem> items_;
+    uint64_t time_tolerance_;
+  };
+
+}
+
+#endif // !COMPRESSOR_ARCHIVE_UPDATE_H_
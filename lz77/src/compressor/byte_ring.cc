@@ -0,0 +1,126 @@
+#include "compressor/byte_ring.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace compressor {
+
+  static const unsigned int kRingSpinCount = 64;
+  static const unsigned int kRingYieldCount = 256;
+
+  ByteRing::ByteRing(size_t capacity) {
+    //power of two,positions wrap with a mask
+    size_t size = 4096;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    buffer_.resize(size);
+    mask_ = size - 1;
+    head_ = 0;
+    tail_ = 0;
+    is_closed_ = false;
+    is_write_failed_ = false;
+    is_aborted_ = false;
+  }
+  ByteRing::~ByteRing() {
+    buffer_.clear();
+  }
+  void ByteRing::Backoff(unsigned int& spins) {
+    spins++;
+    if (spins < kRingSpinCount) {
+      return;
+    }
+    if (spins < kRingYieldCount) {
+      std::this_thread::yield();
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  bool ByteRing::Write(const void* data, size_t size) {
+    const uint8_t* byte_data = static_cast<const uint8_t*>(data);
+    const size_t capacity = buffer_.size();
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    while (size > 0) {
+      unsigned int spins = 0;
+      size_t room = 0;
+      for (;;) {
+        if (is_aborted_) {
+          //fail
+          return true;
+        }
+        room = capacity - static_cast<size_t>(head - tail_.load(std::memory_order_acquire));
+        if (room > 0) {
+          break;
+        }
+        Backoff(spins);
+      }
+      const size_t pos = static_cast<size_t>(head) & mask_;
+      const size_t n = (std::min)((std::min)(size, room), capacity - pos);
+      memcpy(&buffer_[pos], byte_data, n);
+      head += n;
+      head_.store(head, std::memory_order_release);
+      byte_data += n;
+      size -= n;
+    }
+    //success
+    return false;
+  }
+  void ByteRing::CloseWrite(bool is_failed) {
+    is_write_failed_ = is_failed;
+    is_closed_.store(true, std::memory_order_release);
+  }
+  size_t ByteRing::Read(void* data, size_t size) {
+    if (size == 0) {
+      return 0;
+    }
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    unsigned int spins = 0;
+    size_t avail = 0;
+    for (;;) {
+      if (is_aborted_) {
+        return 0;
+      }
+      avail = static_cast<size_t>(head_.load(std::memory_order_acquire) - tail);
+      if (avail > 0) {
+        break;
+      }
+      if (is_closed_.load(std::memory_order_acquire)) {
+        //closed after the last store,recheck once
+        avail = static_cast<size_t>(head_.load(std::memory_order_acquire) - tail);
+        if (avail == 0) {
+          return 0;
+        }
+        break;
+      }
+      Backoff(spins);
+    }
+    const size_t pos = static_cast<size_t>(tail) & mask_;
+    const size_t n = (std::min)((std::min)(size, avail), buffer_.size() - pos);
+    memcpy(data, &buffer_[pos], n);
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+  void ByteRing::Drain() {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    unsigned int spins = 0;
+    while (!is_aborted_) {
+      const uint64_t head = head_.load(std::memory_order_acquire);
+      if (head != tail) {
+        tail = head;
+        tail_.store(tail, std::memory_order_release);
+        spins = 0;
+        continue;
+      }
+      if (is_closed_.load(std::memory_order_acquire) &&
+        head_.load(std::memory_order_acquire) == tail) {
+        return;
+      }
+      Backoff(spins);
+    }
+  }
+  void ByteRing::Abort() {
+    is_aborted_ = true;
+  }
+
+}
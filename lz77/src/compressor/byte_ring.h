@@ -0,0 +1,48 @@
+#ifndef COMPRESSOR_BYTE_RING_H_
+#define COMPRESSOR_BYTE_RING_H_
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+namespace compressor {
+
+  static const size_t kNestedRingSize = 8 * 1024 * 1024;
+  static const unsigned int kNestedChunkSize = 256 * 1024;
+
+  //Single-producer/single-consumer byte pipe between two coders. Positions
+  //are atomics and each side only stores its own,so the hot path takes no
+  //lock;a side that finds the ring full/empty spins,yields,then naps.
+  class ByteRing
+  {
+  public:
+    explicit ByteRing(size_t capacity);
+    virtual ~ByteRing();
+    //producer:blocks while full,fails once the consumer aborted
+    bool Write(const void* data, size_t size);
+    void CloseWrite(bool is_failed);
+    //consumer:blocks until data is there,0 on end of stream or abort
+    size_t Read(void* data, size_t size);
+    //reads and drops the rest,so the producer finishes its integrity checks
+    void Drain();
+    void Abort();
+    bool is_write_failed() const {
+      return is_write_failed_;
+    }
+    bool is_aborted() const {
+      return is_aborted_;
+    }
+  private:
+    static void Backoff(unsigned int& spins);
+    std::vector<uint8_t> buffer_;
+    size_t mask_;
+    std::atomic<uint64_t> head_; //bytes written
+    std::atomic<uint64_t> tail_; //bytes read
+    std::atomic<bool> is_closed_;
+    std::atomic<bool> is_write_failed_;
+    std::atomic<bool> is_aborted_;
+  };
+
+}
+
+#endif // !COMPRESSOR_BYTE_RING_H_
@@ -0,0 +1,145 @@
+#include "compressor/compression_profile.h"
+#include "compressor/file_prefetcher.h"
+#include "compressor/concurrency.h"
+
+namespace compressor {
+
+  CompressionProfile::CompressionProfile(CompressionPreset preset) {
+    this->preset = preset;
+    level = 5;
+    method.resize(0);
+    dictionary_size = 0;
+    solid_block_size = 0;
+    xz_block_size = 0;
+    is_solid = true;
+    is_content_order = true;
+    num_threads = 0;
+    volume_size = 0;
+    is_volume_manifest = false;
+    is_store_incompressible = true;
+    read_ahead_size = kPrefetchMemoryBudget;
+    is_exe_filter = true;
+  }
+  CompressionProfile::~CompressionProfile() {
+    method.resize(0);
+  }
+  uint32_t CompressionProfile::EffectiveLevel() const {
+    switch (preset) {
+    case CompressionPreset::kFastest:
+      return 1;
+    case CompressionPreset::kMax:
+      return 9;
+    case CompressionPreset::kCustom:
+      return level > 9 ? 9 : level;
+    default:
+      return 5;
+    }
+  }
+  uint32_t CompressionProfile::EffectiveThreads() const {
+    return num_threads ? num_threads : Concurrency::Threads();
+  }
+  CompressionProfile CompressionProfile::StoreProfile() const {
+    CompressionProfile profile(*this);
+    profile.level = EffectiveLevel();
+    profile.preset = CompressionPreset::kCustom;
+    profile.method = L"Copy";
+    //Copy takes no dictionary,and there is nothing to gain from solid blocks
+    profile.dictionary_size = 0;
+    profile.solid_block_size = 0;
+    //stored data is not filtered either
+    profile.is_exe_filter = false;
+    return profile;
+  }
+  void CompressionProfile::AddNumber(std::vector<CompressionProperty>& props, const wchar_t* name, uint32_t number) {
+    CompressionProperty prop;
+    prop.name = name;
+    prop.type = CompressionProperty::Type::kNumber;
+    prop.number = number;
+    prop.flag = false;
+    props.push_back(prop);
+  }
+  void CompressionProfile::AddString(std::vector<CompressionProperty>& props, const wchar_t* name, const std::wstring& text) {
+    CompressionProperty prop;
+    prop.name = name;
+    prop.type = CompressionProperty::Type::kString;
+    prop.number = 0;
+    prop.text = text;
+    prop.flag = false;
+    props.push_back(prop);
+  }
+  void CompressionProfile::AddBool(std::vector<CompressionProperty>& props, const wchar_t* name, bool flag) {
+    CompressionProperty prop;
+    prop.name = name;
+    prop.type = CompressionProperty::Type::kBool;
+    prop.number = 0;
+    prop.flag = flag;
+    props.push_back(prop);
+  }
+  std::wstring CompressionProfile::ToSizeString(uint64_t size) {
+    //explicit unit,a bare number below 32 would be read as a power of two
+    return std::to_wstring(size) + L"b";
+  }
+  void CompressionProfile::GetProperties(const std::wstring& format, std::vector<CompressionProperty>& props) const {
+    props.resize(0);
+    const bool is_custom = preset == CompressionPreset::kCustom;
+    const uint32_t threads = EffectiveThreads();
+    if (format == L"7z") {
+      AddNumber(props, L"x", EffectiveLevel());
+      if (is_custom && !method.empty()) {
+        AddString(props, L"0", method);
+      }
+      if (is_custom && dictionary_size) {
+        AddString(props, L"d", ToSizeString(dictionary_size));
+      }
+      if (is_custom && !is_solid) {
+        AddBool(props, L"s", false);
+      }
+      else if (is_custom && solid_block_size) {
+        AddString(props, L"s", ToSizeString(solid_block_size));
+      }
+      if (is_content_order) {
+        //otherwise the handler re-sorts the items by name
+        AddBool(props, L"qc", true);
+      }
+      if (is_exe_filter) {
+        //analysis level 9 parses the head of every new file,not just *.exe;
+        //BCJ2 instead of BCJ from x8 up,as 7-Zip decides
+        AddNumber(props, L"yx", 9);
+      }
+      else {
+        AddBool(props, L"f", false);
+      }
+      AddNumber(props, L"mt", threads);
+    }
+    else if (format == L"zip") {
+      AddNumber(props, L"x", EffectiveLevel());
+      if (is_custom && !method.empty()) {
+        AddString(props, L"m", method);
+        //Deflate/Deflate64 reject a dictionary size
+        if (dictionary_size && method.compare(0, 7, L"Deflate")) {
+          AddString(props, L"d", ToSizeString(dictionary_size));
+        }
+      }
+      //zip compresses several files at once,one per thread
+      AddNumber(props, L"mt", threads);
+    }
+    else if (format == L"xz" || format == L"bzip2") {
+      AddNumber(props, L"x", EffectiveLevel());
+      if (is_custom && dictionary_size) {
+        //bzip2 reads it as the block size
+        AddString(props, L"d", ToSizeString(dictionary_size));
+      }
+      if (format == L"xz" && xz_block_size) {
+        //any preset,it decides parallelism rather than ratio
+        AddString(props, L"s", ToSizeString(xz_block_size));
+      }
+      //xz:one block per thread,bzip2:one 100-900 KB block per thread
+      AddNumber(props, L"mt", threads);
+    }
+    else if (format == L"gzip") {
+      //single Deflate stream,the level is all there is
+      AddNumber(props, L"x", EffectiveLevel());
+    }
+  }
+
+}
@@ -0,0 +1,61 @@
+#ifndef COMPRESSOR_COMPRESSION_PROFILE_H_
+#define COMPRESSOR_COMPRESSION_PROFILE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace compressor {
+
+  enum class CompressionPreset { kFastest, kBalanced, kMax, kCustom };
+
+  //One ISetProperties name/value pair,typed the way the 7z handlers parse it.
+  struct CompressionProperty
+  {
+    enum class Type { kNumber, kString, kBool };
+    std::wstring name;
+    Type type;
+    uint32_t number;
+    std::wstring text;
+    bool flag;
+  };
+
+  //Trades ratio for speed per archive job. The presets only set the level
+  //(x1/x5/x9);kCustom also honours method,dictionary and solid block size.
+  //num_threads 0 takes the Concurrency setting.
+  class CompressionProfile
+  {
+  public:
+    explicit CompressionProfile(CompressionPreset preset = CompressionPreset::kBalanced);
+    virtual ~CompressionProfile();
+    CompressionPreset preset;
+    uint32_t level; //0-9,kCustom only
+    std::wstring method; //kCustom only,empty keeps the format default
+    uint64_t dictionary_size; //bytes,0 keeps the level default
+    uint64_t solid_block_size; //bytes,0 keeps the level default,7z only
+    uint64_t xz_block_size; //bytes per xz block,the unit the encoder threads and the decoder split on,0 keeps 4x dictionary
+    bool is_solid; //7z only
+    bool is_content_order; //7z/tar,group by type and place duplicates together
+    uint32_t num_threads;
+    uint64_t volume_size; //bytes per volume,name.ext.001...,0 writes a single file
+    bool is_volume_manifest; //name.ext.sfv with a CRC32 per volume
+    bool is_store_incompressible; //7z/zip,store media and archives in a group of their own
+    uint64_t read_ahead_size; //bytes of small input files read ahead of the encoder,0 turns it off
+    bool is_exe_filter; //7z,branch/delta filters for executables and PCM found by their headers
+    //properties for the handler named by kCompressArchiveTable,empty when
+    //the format has nothing to tune (tar,wim)
+    void GetProperties(const std::wstring& format, std::vector<CompressionProperty>& props) const;
+    uint32_t EffectiveLevel() const;
+    uint32_t EffectiveThreads() const;
+    //the same job with the Copy method,for the stored group
+    CompressionProfile StoreProfile() const;
+  private:
+    static void AddNumber(std::vector<CompressionProperty>& props, const wchar_t* name, uint32_t number);
+    static void AddString(std::vector<CompressionProperty>& props, const wchar_t* name, const std::wstring& text);
+    static void AddBool(std::vector<CompressionProperty>& props, const wchar_t* name, bool flag);
+    static std::wstring ToSizeString(uint64_t size);
+  };
+
+}
+
+#endif // !COMPRESSOR_COMPRESSION_PROFILE_H_
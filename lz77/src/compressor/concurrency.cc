@@ -0,0 +1,20 @@
+#include "compressor/concurrency.h"
+#include <thread>
+
+namespace compressor {
+
+  std::atomic<uint32_t> Concurrency::num_threads_(0);
+
+  void Concurrency::SetThreads(uint32_t num_threads) {
+    num_threads_ = num_threads;
+  }
+  uint32_t Concurrency::Threads() {
+    const uint32_t num_threads = num_threads_;
+    if (num_threads) {
+      return num_threads;
+    }
+    const uint32_t cores = std::thread::hardware_concurrency();
+    return cores ? cores : 1;
+  }
+
+}
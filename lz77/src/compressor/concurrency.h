@@ -0,0 +1,25 @@
+#ifndef COMPRESSOR_CONCURRENCY_H_
+#define COMPRESSOR_CONCURRENCY_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace compressor {
+
+  //Process-wide thread budget for the coders:xz block threads,bzip2,7z/zip
+  //encoders,ParallelGzipWriter,and the xz/bzip2/7z decoders,set when an
+  //archive is opened.
+  //A profile's own num_threads still wins for that job.
+  class Concurrency
+  {
+  public:
+    //0 means every core
+    static void SetThreads(uint32_t num_threads);
+    static uint32_t Threads();
+  private:
+    static std::atomic<uint32_t> num_threads_;
+  };
+
+}
+
+#endif // !COMPRESSOR_CONCURRENCY_H_
@@ -0,0 +1,348 @@
+#include "compressor/dir_scanner.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+#if defined(OS_WIN)
+#include <windows.h>
+#else
+#include <codecvt>
+#include <locale>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+namespace compressor {
+
+  static bool IsDots(const wchar_t* name) {
+    return name[0] == L'.' && (name[1] == 0 || (name[1] == L'.' && name[2] == 0));
+  }
+
+  DirScanner::DirScanner(unsigned int num_threads) {
+    if (!num_threads) {
+      num_threads = std::thread::hardware_concurrency() * kScanThreadsPerCore;
+    }
+    num_threads_ = (std::max)(1u, (std::min)(num_threads, kScanMaxThreads));
+    pending_dirs_ = 0;
+    roots_.resize(0);
+    failed_paths_.resize(0);
+  }
+  DirScanner::~DirScanner() {
+    workers_.clear();
+    roots_.resize(0);
+    failed_paths_.resize(0);
+  }
+  bool DirScanner::ComparePath(const ScanEntry& left, const ScanEntry& right) {
+    //the separator sorts below every other character,so "a\b" comes right
+    //after "a" and before "a b"
+    if (left.root != right.root) {
+      return left.root < right.root;
+    }
+    const std::wstring& a = left.name;
+    const std::wstring& b = right.name;
+    const size_t len = (std::min)(a.size(), b.size());
+    for (size_t i = 0; i < len; i++) {
+      const wchar_t ca = (a[i] == kScanPathSeparator) ? 0 : a[i];
+      const wchar_t cb = (b[i] == kScanPathSeparator) ? 0 : b[i];
+      if (ca != cb) {
+        return ca < cb;
+      }
+    }
+    return a.size() < b.size();
+  }
+  void DirScanner::AddRoot(const std::wstring& dir, const std::wstring& prefix) {
+    ScanRoot root;
+    root.path = dir;
+    root.prefix = prefix;
+    root.is_file = false;
+    roots_.push_back(std::move(root));
+  }
+  void DirScanner::AddFile(const std::wstring& dir, const ScanEntry& entry) {
+    ScanRoot root;
+    root.path = dir;
+    root.is_file = true;
+    root.file = entry;
+    roots_.push_back(std::move(root));
+  }
+  bool DirScanner::Scan(ItemTable& table) {
+    failed_paths_.resize(0);
+    workers_.clear();
+    for (unsigned int i = 0; i < num_threads_; i++) {
+      workers_.push_back(std::unique_ptr<ScanWorker>(new ScanWorker));
+    }
+    pending_dirs_ = 0;
+    //spread the roots,the threads start without stealing
+    unsigned int next_worker = 0;
+    for (size_t i = 0; i < roots_.size(); i++) {
+      if (!roots_[i].is_file) {
+        Push(next_worker, roots_[i].path, std::wstring(), static_cast<uint32_t>(i));
+        next_worker = (next_worker + 1) % num_threads_;
+      }
+    }
+    std::vector<std::thread> threads;
+    if (pending_dirs_.load() != 0) {
+      for (unsigned int i = 1; i < num_threads_; i++) {
+        threads.push_back(std::thread(&DirScanner::WorkerMain, this, i));
+      }
+      WorkerMain(0);
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < workers_.size(); i++) {
+      total += workers_[i]->entries.size();
+    }
+    std::vector<ScanEntry> entries;
+    entries.reserve(total);
+    for (size_t i = 0; i < workers_.size(); i++) {
+      ScanWorker& worker = *workers_[i];
+      std::move(worker.entries.begin(), worker.entries.end(), std::back_inserter(entries));
+      failed_paths_.insert(failed_paths_.end(), worker.failed_paths.begin(), worker.failed_paths.end());
+    }
+    workers_.clear();
+    std::sort(entries.begin(), entries.end(), ComparePath);
+    std::sort(failed_paths_.begin(), failed_paths_.end());
+    //entries come sorted by root,a directory before its contents,so every
+    //parent is in the table by the time its children arrive
+    table.Reserve(table.size() + entries.size() + roots_.size());
+    size_t next = 0;
+    for (size_t i = 0; i < roots_.size(); i++) {
+      const ScanRoot& scan_root = roots_[i];
+      if (scan_root.is_file) {
+        const ScanEntry& file = scan_root.file;
+        //single files from one directory share their root
+        const uint32_t root = table.AddRoot(L"", scan_root.path);
+        table.Add(root, file.name, file.size, file.ctime, file.atime, file.mtime, file.attrib, file.is_dir);
+        continue;
+      }
+      const uint32_t root = table.AddRoot(scan_root.prefix, scan_root.path);
+      for (; next < entries.size() && entries[next].root == i; next++) {
+        const ScanEntry& entry = entries[next];
+        table.Add(root, entry.name, entry.size, entry.ctime, entry.atime, entry.mtime, entry.attrib, entry.is_dir);
+      }
+      table.EndRoot();
+    }
+    roots_.resize(0);
+    return !failed_paths_.empty();
+  }
+  void DirScanner::Push(unsigned int id, const std::wstring& path, const std::wstring& name, uint32_t root) {
+    //counted before it is visible,the count never drops to 0 while a
+    //directory is still queued or being read
+    pending_dirs_.fetch_add(1, std::memory_order_acq_rel);
+    ScanWorker& worker = *workers_[id];
+    std::lock_guard<std::mutex> lock(worker.lock);
+    ScanDir dir;
+    dir.path = path;
+    dir.name = name;
+    dir.root = root;
+    worker.dirs.push_back(std::move(dir));
+  }
+  bool DirScanner::PopOwn(unsigned int id, ScanDir& dir) {
+    //newest first,the subtree just listed is still hot in the cache
+    ScanWorker& worker = *workers_[id];
+    std::lock_guard<std::mutex> lock(worker.lock);
+    if (worker.dirs.empty()) {
+      return false;
+    }
+    dir = std::move(worker.dirs.back());
+    worker.dirs.pop_back();
+    return true;
+  }
+  bool DirScanner::Steal(unsigned int id, ScanDir& dir) {
+    //oldest first,those are the highest in the tree and carry the most work
+    for (unsigned int i = 1; i < num_threads_; i++) {
+      ScanWorker& victim = *workers_[(id + i) % num_threads_];
+      std::lock_guard<std::mutex> lock(victim.lock);
+      if (victim.dirs.empty()) {
+        continue;
+      }
+      dir = std::move(victim.dirs.front());
+      victim.dirs.pop_front();
+      return true;
+    }
+    return false;
+  }
+  void DirScanner::WorkerMain(unsigned int id) {
+    unsigned int idle = 0;
+    while (pending_dirs_.load(std::memory_order_acquire) != 0) {
+      ScanDir dir;
+      if (PopOwn(id, dir) || Steal(id, dir)) {
+        ReadDir(id, dir);
+        pending_dirs_.fetch_sub(1, std::memory_order_acq_rel);
+        idle = 0;
+        continue;
+      }
+      //other workers are still listing,their subdirectories may show up
+      if (++idle < 64) {
+        std::this_thread::yield();
+      }
+      else {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+  }
+#if defined(OS_WIN)
+  static uint64_t ToTicks(const FILETIME& time) {
+    return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+  }
+  bool DirScanner::ReadDir(unsigned int id, const ScanDir& dir) {
+    ScanWorker& worker = *workers_[id];
+    const std::wstring pattern = dir.path + kScanPathSeparator + L"*";
+    WIN32_FIND_DATAW data;
+    //no 8.3 names,and the kernel fills a larger buffer per call
+    HANDLE find = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data,
+      FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+    if (find == INVALID_HANDLE_VALUE) {
+      if (GetLastError() == ERROR_FILE_NOT_FOUND) {
+        //success,empty
+        return false;
+      }
+      worker.failed_paths.push_back(dir.path);
+      //fail
+      return true;
+    }
+    do {
+      if (IsDots(data.cFileName)) {
+        continue;
+      }
+      ScanEntry entry;
+      entry.name = dir.name.empty() ? std::wstring(data.cFileName) : dir.name + kScanPathSeparator + data.cFileName;
+      entry.size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+      entry.ctime = ToTicks(data.ftCreationTime);
+      entry.atime = ToTicks(data.ftLastAccessTime);
+      entry.mtime = ToTicks(data.ftLastWriteTime);
+      entry.attrib = data.dwFileAttributes;
+      entry.root = dir.root;
+      entry.is_dir = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+      if (entry.is_dir && !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+        Push(id, dir.path + kScanPathSeparator + data.cFileName, entry.name, dir.root);
+      }
+      worker.entries.push_back(std::move(entry));
+    } while (FindNextFileW(find, &data));
+    FindClose(find);
+    //success
+    return false;
+  }
+#else
+  static const size_t kScanDentsBufferSize = 64 * 1024;
+  static const uint64_t kUnixEpochTicks = 116444736000000000ull;
+  static const uint32_t kAttribDirectory = 0x10;
+  static const uint32_t kAttribArchive = 0x20;
+  static const uint32_t kAttribUnixExtension = 0x8000;
+
+  struct ScanDirent64
+  {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+  };
+
+  static uint64_t ToTicks(int64_t sec, uint32_t nsec) {
+    if (sec < 0) {
+      return 0;
+    }
+    return static_cast<uint64_t>(sec) * 10000000ull + nsec / 100 + kUnixEpochTicks;
+  }
+  static bool StatEntry(int dir_fd, const char* name, ScanEntry& entry) {
+    uint32_t mode = 0;
+#if defined(STATX_BASIC_STATS)
+    struct statx st;
+    if (statx(dir_fd, name, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+      STATX_BASIC_STATS | STATX_BTIME, &st)) {
+      //fail
+      return true;
+    }
+    mode = st.stx_mode;
+    entry.size = st.stx_size;
+    entry.ctime = (st.stx_mask & STATX_BTIME) ? ToTicks(st.stx_btime.tv_sec, st.stx_btime.tv_nsec) :
+      ToTicks(st.stx_ctime.tv_sec, st.stx_ctime.tv_nsec);
+    entry.atime = ToTicks(st.stx_atime.tv_sec, st.stx_atime.tv_nsec);
+    entry.mtime = ToTicks(st.stx_mtime.tv_sec, st.stx_mtime.tv_nsec);
+#else
+    struct stat st;
+    if (fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW)) {
+      //fail
+      return true;
+    }
+    mode = st.st_mode;
+    entry.size = st.st_size;
+    entry.ctime = ToTicks(st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+    entry.atime = ToTicks(st.st_atim.tv_sec, st.st_atim.tv_nsec);
+    entry.mtime = ToTicks(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+#endif
+    entry.is_dir = S_ISDIR(mode);
+    if (entry.is_dir) {
+      entry.size = 0;
+    }
+    entry.attrib = (entry.is_dir ? kAttribDirectory : kAttribArchive) | kAttribUnixExtension | (mode << 16);
+    //success
+    return false;
+  }
+  bool DirScanner::ReadDir(unsigned int id, const ScanDir& dir) {
+    ScanWorker& worker = *workers_[id];
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> conv;
+    const int fd = open(conv.to_bytes(dir.path).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+      worker.failed_paths.push_back(dir.path);
+      //fail
+      return true;
+    }
+    std::vector<char> buffer(kScanDentsBufferSize);
+    bool fail = false;
+    for (;;) {
+      //raw getdents64:one syscall per buffer,no per-entry readdir overhead
+      const long size = syscall(SYS_getdents64, fd, &buffer[0], buffer.size());
+      if (size <= 0) {
+        fail = size < 0;
+        break;
+      }
+      for (long pos = 0; pos < size;) {
+        const ScanDirent64* dent = reinterpret_cast<const ScanDirent64*>(&buffer[pos]);
+        pos += dent->d_reclen;
+        std::wstring name;
+        try {
+          name = conv.from_bytes(dent->d_name);
+        }
+        catch (const std::range_error&) {
+          //not UTF-8,the entry can not be named in the archive:report it
+          //byte for byte and keep listing
+          const char* raw = dent->d_name;
+          name.resize(0);
+          while (*raw) {
+            name.push_back(static_cast<wchar_t>(static_cast<unsigned char>(*raw++)));
+          }
+          worker.failed_paths.push_back(dir.path + kScanPathSeparator + name);
+          continue;
+        }
+        if (IsDots(name.c_str())) {
+          continue;
+        }
+        ScanEntry entry;
+        if (StatEntry(fd, dent->d_name, entry)) {
+          //removed while listing
+          continue;
+        }
+        entry.name = dir.name.empty() ? name : dir.name + kScanPathSeparator + name;
+        entry.root = dir.root;
+        if (entry.is_dir) {
+          Push(id, dir.path + kScanPathSeparator + name, entry.name, dir.root);
+        }
+        worker.entries.push_back(std::move(entry));
+      }
+    }
+    close(fd);
+    if (fail) {
+      worker.failed_paths.push_back(dir.path);
+    }
+    return fail;
+  }
+#endif
+
+}
@@ -0,0 +1,95 @@
+#ifndef COMPRESSOR_DIR_SCANNER_H_
+#define COMPRESSOR_DIR_SCANNER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include "compressor/item_table.h"
+
+namespace compressor {
+
+#if defined(OS_WIN)
+  static const wchar_t kScanPathSeparator = L'\\';
+#else
+  static const wchar_t kScanPathSeparator = L'/';
+#endif
+  //directory reads are mostly waiting on the disk,keep its queue busy
+  static const unsigned int kScanThreadsPerCore = 2;
+  static const unsigned int kScanMaxThreads = 32;
+
+  struct ScanEntry
+  {
+    std::wstring name; //path below the root
+    uint64_t size;
+    uint64_t ctime; //FILETIME ticks
+    uint64_t atime;
+    uint64_t mtime;
+    uint32_t attrib; //FILE_ATTRIBUTE_*,unix mode in the high 16 bits elsewhere
+    uint32_t root; //AddRoot() order
+    bool is_dir;
+  };
+
+  //Parallel directory walker. Every worker owns a deque of directories:it
+  //pops its own newest one and,when empty,steals the oldest from another
+  //worker,so a deep subtree spreads across all threads. Entries collect in
+  //per-worker vectors without locking and are sorted by path at the end,
+  //a directory before its contents,so the result does not depend on timing.
+  //Several roots share one set of threads and one sort;they go into the
+  //ItemTable in the order they were added,single files in between.
+  //Reparse points/symlinks to directories are listed but not descended.
+  class DirScanner
+  {
+  public:
+    explicit DirScanner(unsigned int num_threads = 0);
+    virtual ~DirScanner();
+    //queues the contents of dir (not dir itself),named prefix\child...
+    void AddRoot(const std::wstring& dir, const std::wstring& prefix);
+    //queues a file the caller already looked up,entry.name is its name in dir
+    void AddFile(const std::wstring& dir, const ScanEntry& entry);
+    //lists every queued root and appends them to table,in the order queued
+    bool Scan(ItemTable& table);
+    //directories that could not be listed,entries whose name could not be read
+    const std::vector<std::wstring>& failed_paths() const {
+      return failed_paths_;
+    }
+    static bool ComparePath(const ScanEntry& left, const ScanEntry& right);
+  private:
+    struct ScanDir
+    {
+      std::wstring path;
+      std::wstring name; //below the root,empty for the root itself
+      uint32_t root;
+    };
+    struct ScanRoot
+    {
+      std::wstring path;
+      std::wstring prefix;
+      bool is_file;
+      ScanEntry file;
+    };
+    struct ScanWorker
+    {
+      std::mutex lock;
+      std::deque<ScanDir> dirs;
+      std::vector<ScanEntry> entries;
+      std::vector<std::wstring> failed_paths;
+    };
+    void WorkerMain(unsigned int id);
+    void Push(unsigned int id, const std::wstring& path, const std::wstring& name, uint32_t root);
+    bool PopOwn(unsigned int id, ScanDir& dir);
+    bool Steal(unsigned int id, ScanDir& dir);
+    bool ReadDir(unsigned int id, const ScanDir& dir);
+    unsigned int num_threads_;
+    std::vector<std::unique_ptr<ScanWorker>> workers_;
+    std::atomic<uint64_t> pending_dirs_;
+    std::vector<ScanRoot> roots_;
+    std::vector<std::wstring> failed_paths_;
+  };
+
+}
+
+#endif // !COMPRESSOR_DIR_SCANNER_H_
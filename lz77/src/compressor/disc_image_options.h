@@ -0,0 +1,22 @@
+#ifndef COMPRESSOR_DISC_IMAGE_OPTIONS_H_
+#define COMPRESSOR_DISC_IMAGE_OPTIONS_H_
+
+#include <string>
+
+namespace compressor {
+
+  enum class DiscImageFormat { kIso, kIsoJoliet, kIsoUdf, kIsoUdfJoliet, kUdf };
+
+  //Layout of an image built from a folder. The default is the bridge format
+  //Windows and most players read:ISO 9660 with Joliet names plus UDF,which
+  //also holds files of 4 GiB and more.
+  struct DiscImageOptions
+  {
+    DiscImageOptions() : format(DiscImageFormat::kIsoUdfJoliet) {}
+    DiscImageFormat format;
+    std::wstring volume_label; //empty takes the folder name
+  };
+
+}
+
+#endif // !COMPRESSOR_DISC_IMAGE_OPTIONS_H_
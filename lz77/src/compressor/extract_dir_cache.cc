@@ -0,0 +1,106 @@
+#include "compressor/extract_dir_cache.h"
+#include <algorithm>
+#include "base/path.h"
+
+#if defined(OS_WIN)
+#include <windows.h>
+#endif
+
+namespace compressor {
+
+  ExtractDirCache::ExtractDirCache() {
+    created_.clear();
+  }
+  ExtractDirCache::~ExtractDirCache() {
+    created_.clear();
+  }
+  bool ExtractDirCache::IsCreated(const wchar_t* dir, size_t len) {
+    dir_buffer_.assign(dir, len);
+    return created_.find(dir_buffer_) != created_.end();
+  }
+  void ExtractDirCache::Reset(const std::wstring& root_dir) {
+    created_.clear();
+    root_ = root_dir;
+    while (root_.size() > 1 && root_[root_.size() - 1] == kPathSeparator) {
+      root_.resize(root_.size() - 1);
+    }
+    std::wstring root_with_sep = root_ + kPathSeparator;
+    base::Path::mkpath(root_with_sep.c_str());
+    created_.insert(root_);
+  }
+  bool ExtractDirCache::CreateOnce(const wchar_t* dir, size_t len) {
+    if (IsCreated(dir, len)) {
+      //success
+      return false;
+    }
+#if defined(OS_WIN)
+    if (!CreateDirectoryW(dir_buffer_.c_str(), nullptr) &&
+      GetLastError() != ERROR_ALREADY_EXISTS) {
+      //fail
+      return true;
+    }
+#else
+    dir_buffer_ += kPathSeparator;
+    if (base::Path::mkpath(dir_buffer_.c_str())) {
+      //fail
+      return true;
+    }
+#endif
+    created_.insert(std::wstring(dir, len));
+    //success
+    return false;
+  }
+  bool ExtractDirCache::EnsureDir(const wchar_t* dir, size_t len) {
+    while (len > 1 && dir[len - 1] == kPathSeparator) {
+      len--;
+    }
+    if (len == 0 || IsCreated(dir, len)) {
+      //success
+      return false;
+    }
+    size_t pos = 0;
+    if (len > root_.size() && dir[root_.size()] == kPathSeparator &&
+      wcsncmp(dir, root_.c_str(), root_.size()) == 0) {
+      //the root exists,start with its first child
+      pos = root_.size() + 1;
+    }
+    for (; pos < len; pos++) {
+      if (dir[pos] == kPathSeparator && pos > 0 && dir[pos - 1] != kPathSeparator) {
+        //intermediate failures (drive,unc share) are decided by the last one
+        CreateOnce(dir, pos);
+      }
+    }
+    return CreateOnce(dir, len);
+  }
+  bool ExtractDirCache::EnsureParent(const std::wstring& full_path) {
+    const size_t pos = full_path.find_last_of(kPathSeparator);
+    if (pos == std::wstring::npos || pos == 0) {
+      //success
+      return false;
+    }
+    return EnsureDir(full_path.c_str(), pos);
+  }
+  const std::wstring& ExtractDirCache::Join(const std::wstring& rpath) {
+    if (rpath.size() > 1 && rpath[1] == L':') {
+      path_buffer_.assign(rpath);
+      return path_buffer_;
+    }
+    path_buffer_.assign(root_);
+    if (!rpath.empty() && rpath[0] != kPathSeparator) {
+      path_buffer_ += kPathSeparator;
+    }
+    path_buffer_ += rpath;
+    return path_buffer_;
+  }
+  void ExtractDirCache::Prepare(const std::vector<std::wstring>& dirs) {
+    std::vector<std::wstring> sorted_dirs(dirs);
+    std::sort(sorted_dirs.begin(), sorted_dirs.end());
+    sorted_dirs.erase(std::unique(sorted_dirs.begin(), sorted_dirs.end()), sorted_dirs.end());
+    //sorted order visits every parent before its children
+    for (size_t i = 0; i < sorted_dirs.size(); i++) {
+      const std::wstring& full_dir = Join(sorted_dirs[i]);
+      EnsureDir(full_dir.c_str(), full_dir.size());
+    }
+  }
+
+}
@@ -0,0 +1,40 @@
+#ifndef COMPRESSOR_EXTRACT_DIR_CACHE_H_
+#define COMPRESSOR_EXTRACT_DIR_CACHE_H_
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+namespace compressor {
+
+  static const wchar_t kPathSeparator = L'\\';
+
+  //Extraction scoped set of directories already created under the root dir.
+  //Directories are keyed by their full path;lookups go through a reused
+  //buffer,so the per-file path does not allocate and each directory costs
+  //at most one mkdir.
+  class ExtractDirCache
+  {
+  public:
+    ExtractDirCache();
+    virtual ~ExtractDirCache();
+    void Reset(const std::wstring& root_dir);
+    void Prepare(const std::vector<std::wstring>& dirs);
+    bool EnsureDir(const wchar_t* dir, size_t len);
+    bool EnsureParent(const std::wstring& full_path);
+    const std::wstring& Join(const std::wstring& rpath);
+    const std::wstring& root() const {
+      return root_;
+    }
+  private:
+    bool IsCreated(const wchar_t* dir, size_t len);
+    bool CreateOnce(const wchar_t* dir, size_t len);
+    std::unordered_set<std::wstring> created_;
+    std::wstring root_;
+    std::wstring path_buffer_;
+    std::wstring dir_buffer_;
+  };
+
+}
+
+#endif // !COMPRESSOR_EXTRACT_DIR_CACHE_H_
@@ -0,0 +1,177 @@
+#include "compressor/extract_filter.h"
+#include <algorithm>
+#include <cwctype>
+
+namespace compressor {
+
+  static const wchar_t kFilterSeparator = L'\\';
+
+  static std::wstring NormalizeFilterPath(const std::wstring& path) {
+    std::wstring normalized(path);
+    for (size_t i = 0; i < normalized.size(); i++) {
+      if (normalized[i] == L'/') {
+        normalized[i] = kFilterSeparator;
+      }
+    }
+    while (!normalized.empty() && normalized[normalized.size() - 1] == kFilterSeparator) {
+      normalized.resize(normalized.size() - 1);
+    }
+    return normalized;
+  }
+
+  ExtractFilter::ExtractFilter() {
+    Clear();
+  }
+  ExtractFilter::~ExtractFilter() {
+    Clear();
+  }
+  void ExtractFilter::Clear() {
+    includes_.clear();
+    excludes_.clear();
+    indices_.clear();
+  }
+  bool ExtractFilter::MakeRule(const std::wstring& pattern, ExtractFilterSyntax syntax, FilterRule& rule) {
+    rule.syntax = syntax;
+    if (syntax == ExtractFilterSyntax::kRegex) {
+      rule.pattern = pattern;
+      rule.is_name_only = false;
+      try {
+        rule.regex.assign(pattern, std::regex_constants::ECMAScript | std::regex_constants::icase);
+      }
+      catch (const std::regex_error&) {
+        //fail
+        return true;
+      }
+      //success
+      return false;
+    }
+    rule.pattern = NormalizeFilterPath(pattern);
+    if (rule.pattern.empty()) {
+      //fail
+      return true;
+    }
+    rule.is_name_only = (rule.pattern.find(kFilterSeparator) == std::wstring::npos);
+    //success
+    return false;
+  }
+  bool ExtractFilter::AddInclude(const std::wstring& pattern, ExtractFilterSyntax syntax) {
+    FilterRule rule;
+    if (MakeRule(pattern, syntax, rule)) {
+      //fail
+      return true;
+    }
+    includes_.push_back(rule);
+    //success
+    return false;
+  }
+  bool ExtractFilter::AddExclude(const std::wstring& pattern, ExtractFilterSyntax syntax) {
+    FilterRule rule;
+    if (MakeRule(pattern, syntax, rule)) {
+      //fail
+      return true;
+    }
+    excludes_.push_back(rule);
+    //success
+    return false;
+  }
+  void ExtractFilter::AddIndex(unsigned int index) {
+    indices_.push_back(index);
+  }
+  bool ExtractFilter::MatchGlob(const wchar_t* pattern, const wchar_t* text, size_t text_len) {
+    //iterative wildcard match,'*' backtracks to the last star only
+    size_t t = 0;
+    const wchar_t* star = nullptr;
+    size_t star_t = 0;
+    while (t < text_len) {
+      if (*pattern == L'*') {
+        star = pattern++;
+        star_t = t;
+      }
+      else if (*pattern != L'\0' && (*pattern == L'?' ||
+        std::towlower(*pattern) == std::towlower(text[t]))) {
+        pattern++;
+        t++;
+      }
+      else if (star) {
+        pattern = star + 1;
+        t = ++star_t;
+      }
+      else {
+        return false;
+      }
+    }
+    while (*pattern == L'*') {
+      pattern++;
+    }
+    return *pattern == L'\0';
+  }
+  bool ExtractFilter::MatchRule(const FilterRule& rule, const std::wstring& path, size_t len) {
+    if (rule.syntax == ExtractFilterSyntax::kRegex) {
+      return std::regex_search(path.begin(), path.begin() + len, rule.regex);
+    }
+    if (!rule.is_name_only) {
+      return MatchGlob(rule.pattern.c_str(), path.c_str(), len);
+    }
+    size_t name_pos = 0;
+    for (size_t i = len; i > 0; i--) {
+      if (path[i - 1] == kFilterSeparator) {
+        name_pos = i;
+        break;
+      }
+    }
+    return MatchGlob(rule.pattern.c_str(), path.c_str() + name_pos, len - name_pos);
+  }
+  bool ExtractFilter::MatchAny(const std::vector<FilterRule>& rules, const std::wstring& path) {
+    //the item itself first,then every parent directory
+    for (size_t i = 0; i < rules.size(); i++) {
+      size_t len = path.size();
+      while (len > 0) {
+        if (MatchRule(rules[i], path, len)) {
+          return true;
+        }
+        len = path.find_last_of(kFilterSeparator, len - 1);
+        if (len == std::wstring::npos) {
+          break;
+        }
+      }
+    }
+    return false;
+  }
+  bool ExtractFilter::Resolve(C7ZipArchive* archive, std::vector<unsigned int>& indices) const {
+    indices.resize(0);
+    unsigned int item_count = 0;
+    if (!archive || !archive->GetItemCount(&item_count)) {
+      //fail
+      return true;
+    }
+    const bool select_all = includes_.empty() && indices_.empty();
+    std::vector<bool> selected(item_count, select_all);
+    for (size_t i = 0; i < indices_.size(); i++) {
+      if (indices_[i] < item_count) {
+        selected[indices_[i]] = true;
+      }
+    }
+    if (!includes_.empty() || !excludes_.empty()) {
+      for (unsigned int i = 0; i < item_count; i++) {
+        if (!selected[i] && includes_.empty()) {
+          continue;
+        }
+        const std::wstring path = NormalizeFilterPath(archive->GetItemFullPath(i));
+        if (!selected[i]) {
+          selected[i] = MatchAny(includes_, path);
+        }
+        if (selected[i] && !excludes_.empty() && MatchAny(excludes_, path)) {
+          selected[i] = false;
+        }
+      }
+    }
+    for (unsigned int i = 0; i < item_count; i++) {
+      if (selected[i]) {
+        indices.push_back(i);
+      }
+    }
+    //success
+    return false;
+  }
+
+}
@@ -0,0 +1,52 @@
+#ifndef COMPRESSOR_EXTRACT_FILTER_H_
+#define COMPRESSOR_EXTRACT_FILTER_H_
+
+#include <string>
+#include <vector>
+#include <regex>
+#include "lib7zip/Lib7Zip/lib7zip.h"
+
+namespace compressor {
+
+  enum class ExtractFilterSyntax { kGlob, kRegex };
+
+  //Selects archive items by include/exclude patterns and explicit indices.
+  //Resolve() turns the selection into one sorted index array,so the caller
+  //can hand it to a single IInArchive::Extract and decode each solid block once.
+  //A pattern without a separator matches item names,otherwise the full path;
+  //a matched directory selects everything below it.
+  class ExtractFilter
+  {
+  public:
+    ExtractFilter();
+    virtual ~ExtractFilter();
+    bool AddInclude(const std::wstring& pattern,
+      ExtractFilterSyntax syntax = ExtractFilterSyntax::kGlob);
+    bool AddExclude(const std::wstring& pattern,
+      ExtractFilterSyntax syntax = ExtractFilterSyntax::kGlob);
+    void AddIndex(unsigned int index);
+    void Clear();
+    bool IsSelectAll() const {
+      return includes_.empty() && excludes_.empty() && indices_.empty();
+    }
+    bool Resolve(C7ZipArchive* archive, std::vector<unsigned int>& indices) const;
+    static bool MatchGlob(const wchar_t* pattern, const wchar_t* text, size_t text_len);
+  private:
+    struct FilterRule
+    {
+      std::wstring pattern;
+      std::wregex regex;
+      ExtractFilterSyntax syntax;
+      bool is_name_only;
+    };
+    static bool MakeRule(const std::wstring& pattern, ExtractFilterSyntax syntax, FilterRule& rule);
+    static bool MatchRule(const FilterRule& rule, const std::wstring& path, size_t len);
+    static bool MatchAny(const std::vector<FilterRule>& rules, const std::wstring& path);
+    std::vector<FilterRule> includes_;
+    std::vector<FilterRule> excludes_;
+    std::vector<unsigned int> indices_;
+  };
+
+}
+
+#endif // !COMPRESSOR_EXTRACT_FILTER_H_
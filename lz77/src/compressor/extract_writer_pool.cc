@@ -0,0 +1,291 @@
+#include "compressor/extract_writer_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "base/path.h"
+
+#if defined(OS_WIN)
+#include <windows.h>
+#endif
+
+namespace compressor {
+
+  static const wchar_t * const kWriterOpenFailed = L"open failed!";
+  static const wchar_t * const kWriterWriteFailed = L"write failed!";
+
+  ExtractWriterPool::ExtractWriterPool(unsigned int writer_count, size_t max_inflight_bytes) {
+    if (writer_count == 0) {
+      writer_count = std::thread::hardware_concurrency();
+    }
+    writer_count = (std::max)(writer_count, 1u);
+    pool_.resize(static_cast<int>(writer_count));
+    buffer_count_ = 0;
+    //one buffer per writer plus the one the decoder is filling,at least
+    max_buffers_ = (std::max)(max_inflight_bytes / kWriterChunkSize, static_cast<size_t>(writer_count) + 1);
+    pending_jobs_ = 0;
+    bytes_written_ = 0;
+    stats_ = nullptr;
+    errors_.clear();
+  }
+  ExtractWriterPool::~ExtractWriterPool() {
+    Finish();
+    pool_.stop(true);
+    for (size_t i = 0; i < free_buffers_.size(); i++) {
+      delete free_buffers_[i];
+    }
+    free_buffers_.clear();
+  }
+  std::vector<uint8_t>* ExtractWriterPool::AcquireBuffer() {
+    std::unique_lock<std::mutex> lock(lock_);
+    //bounded memory:the decoder waits here while the writers catch up
+    buffer_cv_.wait(lock, [this] {
+      return !free_buffers_.empty() || buffer_count_ < max_buffers_;
+    });
+    if (!free_buffers_.empty()) {
+      std::vector<uint8_t>* buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+      return buffer;
+    }
+    buffer_count_++;
+    return new std::vector<uint8_t>(kWriterChunkSize);
+  }
+  void ExtractWriterPool::ReleaseBuffer(std::vector<uint8_t>* buffer) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      free_buffers_.push_back(buffer);
+    }
+    buffer_cv_.notify_one();
+  }
+  ExtractWriteJob* ExtractWriterPool::Open(const std::wstring& path, uint64_t size) {
+    ExtractWriteJob* job = new ExtractWriteJob;
+    job->path = path;
+    job->size = size;
+    job->filling.buffer = nullptr;
+    job->filling.size = 0;
+    job->meta.ctime = 0;
+    job->meta.atime = 0;
+    job->meta.mtime = 0;
+    job->meta.attrib = 0;
+    job->meta.has_attrib = false;
+    job->file = nullptr;
+    job->is_scheduled = false;
+    job->is_closed = false;
+    job->is_failed = false;
+    std::lock_guard<std::mutex> lock(lock_);
+    pending_jobs_++;
+    return job;
+  }
+  bool ExtractWriterPool::Write(ExtractWriteJob* job, const void* data, size_t size) {
+    const uint8_t* byte_data = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+      if (!job->filling.buffer) {
+        job->filling.buffer = AcquireBuffer();
+        job->filling.size = 0;
+      }
+      const size_t n = (std::min)(size, kWriterChunkSize - job->filling.size);
+      memcpy(&(*job->filling.buffer)[job->filling.size], byte_data, n);
+      job->filling.size += n;
+      byte_data += n;
+      size -= n;
+      if (job->filling.size == kWriterChunkSize) {
+        std::lock_guard<std::mutex> lock(lock_);
+        job->chunks.push_back(job->filling);
+        job->filling.buffer = nullptr;
+        Schedule(job);
+      }
+    }
+    //success
+    return false;
+  }
+  void ExtractWriterPool::Close(ExtractWriteJob* job, const ExtractFileMeta& meta) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (job->filling.buffer) {
+      job->chunks.push_back(job->filling);
+      job->filling.buffer = nullptr;
+    }
+    job->meta = meta;
+    job->is_closed = true;
+    Schedule(job);
+  }
+  void ExtractWriterPool::Schedule(ExtractWriteJob* job) {
+    //lock_ held
+    if (job->is_scheduled) {
+      return;
+    }
+    job->is_scheduled = true;
+    pool_.push([this, job](int) {
+      Drain(job);
+    });
+  }
+  void ExtractWriterPool::Drain(ExtractWriteJob* job) {
+    for (;;) {
+      ExtractWriteChunk chunk = { nullptr, 0 };
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (job->chunks.empty()) {
+          if (!job->is_closed) {
+            //more data later,the next Write schedules us again
+            job->is_scheduled = false;
+            return;
+          }
+        }
+        else {
+          chunk = job->chunks.front();
+          job->chunks.pop_front();
+        }
+      }
+      if (chunk.buffer) {
+        if (!job->is_failed && !job->file) {
+          OperationStats::ScopedPhase phase(stats_, OperationPhase::kOpen);
+          if (OpenJobFile(job)) {
+            job->is_failed = true;
+            std::lock_guard<std::mutex> lock(lock_);
+            errors_[job->path] = kWriterOpenFailed;
+          }
+        }
+        if (!job->is_failed) {
+          OperationStats::ScopedPhase phase(stats_, OperationPhase::kWrite);
+          if (WriteJobFile(job, &(*chunk.buffer)[0], chunk.size)) {
+            job->is_failed = true;
+            std::lock_guard<std::mutex> lock(lock_);
+            errors_[job->path] = kWriterWriteFailed;
+          }
+          else {
+            bytes_written_.fetch_add(chunk.size, std::memory_order_relaxed);
+          }
+        }
+        ReleaseBuffer(chunk.buffer);
+        continue;
+      }
+      //closed and drained:empty files are created here
+      if (!job->is_failed && !job->file) {
+        OperationStats::ScopedPhase phase(stats_, OperationPhase::kOpen);
+        if (OpenJobFile(job)) {
+          job->is_failed = true;
+          std::lock_guard<std::mutex> lock(lock_);
+          errors_[job->path] = kWriterOpenFailed;
+        }
+      }
+      if (job->file) {
+        //the final size and the delayed writes can still fail here
+        OperationStats::ScopedPhase phase(stats_, OperationPhase::kClose);
+        if (CloseJobFile(job) && !job->is_failed) {
+          job->is_failed = true;
+          std::lock_guard<std::mutex> lock(lock_);
+          errors_[job->path] = kWriterWriteFailed;
+        }
+      }
+      delete job;
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        pending_jobs_--;
+      }
+      done_cv_.notify_all();
+      return;
+    }
+  }
+  void ExtractWriterPool::Finish() {
+    std::unique_lock<std::mutex> lock(lock_);
+    done_cv_.wait(lock, [this] {
+      return pending_jobs_ == 0;
+    });
+  }
+#if defined(OS_WIN)
+  bool ExtractWriterPool::OpenJobFile(ExtractWriteJob* job) {
+    HANDLE file = CreateFileW(job->path.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+      nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      //parent not created up front,mkpath creates everything up to the file name
+      base::Path::mkpath(job->path.c_str());
+      file = CreateFileW(job->path.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
+        nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    }
+    if (file == INVALID_HANDLE_VALUE) {
+      //fail
+      return true;
+    }
+    job->file = file;
+    job->writer.Attach(file);
+    job->writer.Preallocate(job->size);
+    //success
+    return false;
+  }
+  bool ExtractWriterPool::WriteJobFile(ExtractWriteJob* job, const uint8_t* data, size_t size) {
+    return job->writer.Write(data, size);
+  }
+  bool ExtractWriterPool::CloseJobFile(ExtractWriteJob* job) {
+    if (!job->file) {
+      //fail
+      return true;
+    }
+    bool fail = job->writer.Finish();
+    ApplyFileTimes(job->file, job->meta);
+    fail = !CloseHandle(static_cast<HANDLE>(job->file)) || fail;
+    job->file = nullptr;
+    ApplyFileAttrib(job->path, job->meta);
+    //fail return true
+    return fail;
+  }
+  void ApplyFileTimes(void* file, const ExtractFileMeta& meta) {
+    if (!file || (!meta.ctime && !meta.atime && !meta.mtime)) {
+      return;
+    }
+    FILETIME ctime, atime, mtime;
+    ctime.dwLowDateTime = static_cast<DWORD>(meta.ctime);
+    ctime.dwHighDateTime = static_cast<DWORD>(meta.ctime >> 32);
+    atime.dwLowDateTime = static_cast<DWORD>(meta.atime);
+    atime.dwHighDateTime = static_cast<DWORD>(meta.atime >> 32);
+    mtime.dwLowDateTime = static_cast<DWORD>(meta.mtime);
+    mtime.dwHighDateTime = static_cast<DWORD>(meta.mtime >> 32);
+    SetFileTime(static_cast<HANDLE>(file), meta.ctime ? &ctime : nullptr,
+      meta.atime ? &atime : nullptr,
+      meta.mtime ? &mtime : nullptr);
+  }
+  void ApplyFileAttrib(const std::wstring& path, const ExtractFileMeta& meta) {
+    if (!meta.has_attrib) {
+      return;
+    }
+    //high bits carry unix mode bits in 7z/zip headers
+    const DWORD attrib = meta.attrib & 0x7FFF & ~FILE_ATTRIBUTE_DIRECTORY;
+    if (attrib != 0) {
+      SetFileAttributesW(path.c_str(), attrib);
+    }
+  }
+#else
+  bool ExtractWriterPool::OpenJobFile(ExtractWriteJob* job) {
+    FILE* file = wfopen(job->path.c_str(), L"wb");
+    if (!file) {
+      base::Path::mkpath(job->path.c_str());
+      file = wfopen(job->path.c_str(), L"wb");
+    }
+    if (!file) {
+      //fail
+      return true;
+    }
+    job->file = file;
+    job->writer.Attach(file);
+    job->writer.Preallocate(job->size);
+    //success
+    return false;
+  }
+  bool ExtractWriterPool::WriteJobFile(ExtractWriteJob* job, const uint8_t* data, size_t size) {
+    return job->writer.Write(data, size);
+  }
+  bool ExtractWriterPool::CloseJobFile(ExtractWriteJob* job) {
+    if (!job->file) {
+      //fail
+      return true;
+    }
+    bool fail = job->writer.Finish();
+    fail = (fclose(static_cast<FILE*>(job->file)) != 0) || fail;
+    job->file = nullptr;
+    //fail return true
+    return fail;
+  }
+  void ApplyFileTimes(void* /* file */, const ExtractFileMeta& /* meta */) {
+  }
+  void ApplyFileAttrib(const std::wstring& /* path */, const ExtractFileMeta& /* meta */) {
+  }
+#endif
+
+}
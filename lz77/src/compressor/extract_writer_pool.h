@@ -0,0 +1,149 @@
+#ifndef COMPRESSOR_EXTRACT_WRITER_POOL_H_
+#define COMPRESSOR_EXTRACT_WRITER_POOL_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <CTPL/ctpl_stl.h>
+#include "lib7zip/Lib7Zip/lib7zip.h"
+#include "compressor/operation_stats.h"
+#include "compressor/sparse_file.h"
+
+namespace compressor {
+
+  static const size_t kWriterChunkSize = 256 * 1024;
+  static const size_t kWriterMaxInflightBytes = 64 * 1024 * 1024;
+
+  struct ExtractFileMeta
+  {
+    uint64_t ctime; //0:keep
+    uint64_t atime;
+    uint64_t mtime;
+    uint32_t attrib;
+    bool has_attrib;
+  };
+
+  //stamps an extracted file,on the writer threads and on the inline path;
+  //times go on the open file,attributes once it is closed
+  void ApplyFileTimes(void* file, const ExtractFileMeta& meta);
+  void ApplyFileAttrib(const std::wstring& path, const ExtractFileMeta& meta);
+
+  struct ExtractWriteChunk
+  {
+    std::vector<uint8_t>* buffer;
+    size_t size;
+  };
+
+  struct ExtractWriteJob
+  {
+    std::wstring path;
+    uint64_t size; //from the item header,0:unknown
+    std::deque<ExtractWriteChunk> chunks;
+    ExtractWriteChunk filling;
+    ExtractFileMeta meta;
+    void* file;
+    SparseFileWriter writer;
+    bool is_scheduled;
+    bool is_closed;
+    bool is_failed;
+  };
+
+  //Write-behind sink for extraction. The decoder thread only copies data into
+  //pooled buffers;writer threads create,write,stamp and close the files.
+  //Chunks of one file are drained by one writer at a time,so they stay in
+  //order,and the buffer pool bounds the data in flight.
+  class ExtractWriterPool
+  {
+  public:
+    ExtractWriterPool(unsigned int writer_count, size_t max_inflight_bytes);
+    virtual ~ExtractWriterPool();
+    ExtractWriteJob* Open(const std::wstring& path, uint64_t size);
+    bool Write(ExtractWriteJob* job, const void* data, size_t size);
+    void Close(ExtractWriteJob* job, const ExtractFileMeta& meta);
+    void Finish();
+    //the pool lives as long as its archive,each pass reports its own errors
+    void ClearErrors() {
+      errors_.clear();
+    }
+    //starts a pass,the writers are idle
+    void SetStats(OperationStats* stats) {
+      stats_ = stats;
+      bytes_written_ = 0;
+    }
+    const std::map<std::wstring, std::wstring>& errors() const {
+      return errors_;
+    }
+    //bytes the writer threads have put on disk since SetStats
+    uint64_t bytes_written() const {
+      return bytes_written_.load(std::memory_order_relaxed);
+    }
+    //called on the decoder thread with its progress,not per write
+    void PublishBytesOut() {
+      if (stats_) {
+        stats_->SetBytesOut(bytes_written());
+      }
+    }
+  private:
+    std::vector<uint8_t>* AcquireBuffer();
+    void ReleaseBuffer(std::vector<uint8_t>* buffer);
+    void Schedule(ExtractWriteJob* job);
+    void Drain(ExtractWriteJob* job);
+    static bool OpenJobFile(ExtractWriteJob* job);
+    static bool WriteJobFile(ExtractWriteJob* job, const uint8_t* data, size_t size);
+    static bool CloseJobFile(ExtractWriteJob* job);
+    ctpl::thread_pool pool_;
+    std::mutex lock_;
+    std::condition_variable buffer_cv_;
+    std::condition_variable done_cv_;
+    std::vector<std::vector<uint8_t>*> free_buffers_;
+    size_t buffer_count_;
+    size_t max_buffers_;
+    size_t pending_jobs_;
+    std::atomic<uint64_t> bytes_written_;
+    OperationStats* stats_;
+    std::map<std::wstring, std::wstring> errors_;
+  };
+
+  //C7ZipOutStream handed to the decoder for the file being extracted
+  class ExtractPooledOutStream : public C7ZipOutStream
+  {
+  public:
+    ExtractPooledOutStream() {
+      pool_ = nullptr;
+      job_ = nullptr;
+    }
+    void Attach(ExtractWriterPool* pool, ExtractWriteJob* job) {
+      pool_ = pool;
+      job_ = job;
+    }
+    virtual int Write(const void *data, unsigned int size, unsigned int *processedSize) {
+      if (processedSize) {
+        *processedSize = 0;
+      }
+      if (!pool_ || !job_ || pool_->Write(job_, data, size)) {
+        return 1;
+      }
+      if (processedSize) {
+        *processedSize = size;
+      }
+      return 0;
+    }
+    virtual int Seek(__int64 offset, unsigned int seekOrigin, unsigned __int64 *newPosition) {
+      return 0;
+    }
+    virtual int SetSize(unsigned __int64 size) {
+      return 0;
+    }
+  private:
+    ExtractWriterPool* pool_;
+    ExtractWriteJob* job_;
+  };
+
+}
+
+#endif // !COMPRESSOR_EXTRACT_WRITER_POOL_H_
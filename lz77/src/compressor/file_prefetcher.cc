@@ -0,0 +1,203 @@
+#include "compressor/file_prefetcher.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace compressor {
+
+  FilePrefetcher::FilePrefetcher(size_t memory_budget, unsigned int num_threads) {
+    slots_.resize(0);
+    cursor_ = 0;
+    next_ = 0;
+    budget_ = memory_budget;
+    bytes_used_ = 0;
+    num_threads_ = num_threads ? num_threads : 1;
+    is_stopping_ = false;
+  }
+  FilePrefetcher::~FilePrefetcher() {
+    Stop();
+  }
+  void FilePrefetcher::Add(uint32_t index, const std::wstring& path, uint64_t size) {
+    if (size == 0 || size > kPrefetchMaxFileSize || size > budget_) {
+      return;
+    }
+    PrefetchSlot slot;
+    slot.index = index;
+    slot.path = path;
+    slot.size = size;
+    slot.state = PrefetchState::kIdle;
+    positions_[index] = slots_.size();
+    slots_.push_back(slot);
+  }
+  void FilePrefetcher::Start() {
+    if (slots_.empty() || !workers_.empty()) {
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      is_stopping_ = false;
+      Schedule();
+    }
+    const unsigned int num_threads = (std::min)(num_threads_, static_cast<unsigned int>(slots_.size()));
+    for (unsigned int i = 0; i < num_threads; i++) {
+      workers_.push_back(std::thread(&FilePrefetcher::WorkerMain, this));
+    }
+  }
+  void FilePrefetcher::Stop() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      is_stopping_ = true;
+    }
+    queued_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++) {
+      workers_[i].join();
+    }
+    workers_.resize(0);
+    std::lock_guard<std::mutex> lock(lock_);
+    queue_.clear();
+    for (size_t i = 0; i < slots_.size(); i++) {
+      if (slots_[i].state != PrefetchState::kTaken && slots_[i].state != PrefetchState::kIdle) {
+        Release(slots_[i]);
+      }
+    }
+  }
+  void FilePrefetcher::Schedule() {
+    //lock_ held
+    next_ = (std::max)(next_, cursor_);
+    while (next_ < slots_.size() && next_ - cursor_ < kPrefetchMaxItems &&
+      bytes_used_ + slots_[next_].size <= budget_) {
+      slots_[next_].state = PrefetchState::kQueued;
+      bytes_used_ += slots_[next_].size;
+      queue_.push_back(next_);
+      next_++;
+    }
+  }
+  void FilePrefetcher::Release(PrefetchSlot& slot) {
+    //lock_ held,a loading slot is released by its worker once the read ends
+    if (slot.state == PrefetchState::kLoading) {
+      slot.state = PrefetchState::kDropped;
+      return;
+    }
+    bytes_used_ -= slot.size;
+    if (!slot.data.empty() && pool_.size() < kPrefetchPoolBuffers) {
+      slot.data.resize(0);
+      pool_.push_back(std::vector<uint8_t>());
+      pool_.back().swap(slot.data);
+    }
+    std::vector<uint8_t>().swap(slot.data);
+    slot.state = PrefetchState::kIdle;
+  }
+  bool FilePrefetcher::Take(uint32_t index, std::vector<uint8_t>& data) {
+    std::unordered_map<uint32_t, size_t>::const_iterator found = positions_.find(index);
+    if (found == positions_.end() || workers_.empty()) {
+      //fail
+      return true;
+    }
+    const size_t pos = found->second;
+    std::unique_lock<std::mutex> lock(lock_);
+    if (pos < cursor_) {
+      //asked for again or after its window passed
+      return true;
+    }
+    //the handler skipped ahead,what lies between is not going to be asked for soon
+    for (size_t i = cursor_; i < pos && i < next_; i++) {
+      if (slots_[i].state != PrefetchState::kIdle) {
+        Release(slots_[i]);
+      }
+    }
+    cursor_ = pos + 1;
+    PrefetchSlot& slot = slots_[pos];
+    ready_.wait(lock, [&slot]() {
+      return slot.state != PrefetchState::kQueued && slot.state != PrefetchState::kLoading;
+    });
+    bool fail = true;
+    if (slot.state == PrefetchState::kReady) {
+      data.swap(slot.data);
+      slot.state = PrefetchState::kTaken;
+      fail = false;
+    }
+    else if (slot.state == PrefetchState::kFailed) {
+      Release(slot);
+    }
+    Schedule();
+    lock.unlock();
+    queued_.notify_all();
+    return fail;
+  }
+  void FilePrefetcher::Recycle(std::vector<uint8_t>& data) {
+    std::lock_guard<std::mutex> lock(lock_);
+    bytes_used_ -= data.size();
+    if (pool_.size() < kPrefetchPoolBuffers) {
+      data.resize(0);
+      pool_.push_back(std::vector<uint8_t>());
+      pool_.back().swap(data);
+    }
+    std::vector<uint8_t>().swap(data);
+    if (!is_stopping_) {
+      Schedule();
+      queued_.notify_all();
+    }
+  }
+  bool FilePrefetcher::LoadFile(const std::wstring& path, uint64_t size, std::vector<uint8_t>& data) {
+#if defined(OS_WIN)
+    FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+    FILE* file = fopen(std::string(path.begin(), path.end()).c_str(), "rb");
+#endif
+    if (!file) {
+      //fail
+      return true;
+    }
+    data.resize(static_cast<size_t>(size));
+    data.resize(fread(&data[0], 1, data.size(), file));
+    //the file grew since the scan,take the rest as well
+    uint8_t chunk[4096];
+    size_t count = 0;
+    while (data.size() == size && (count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+      data.insert(data.end(), chunk, chunk + count);
+      size = data.size();
+    }
+    const bool fail = ferror(file) != 0;
+    fclose(file);
+    return fail;
+  }
+  void FilePrefetcher::WorkerMain() {
+    std::unique_lock<std::mutex> lock(lock_);
+    for (;;) {
+      queued_.wait(lock, [this]() { return is_stopping_ || !queue_.empty(); });
+      if (is_stopping_) {
+        return;
+      }
+      const size_t pos = queue_.front();
+      queue_.pop_front();
+      PrefetchSlot& slot = slots_[pos];
+      if (slot.state != PrefetchState::kQueued) {
+        continue;
+      }
+      slot.state = PrefetchState::kLoading;
+      std::vector<uint8_t> data;
+      if (!pool_.empty()) {
+        data.swap(pool_.back());
+        pool_.pop_back();
+      }
+      const std::wstring path = slot.path;
+      const uint64_t size = slot.size;
+      lock.unlock();
+      const bool fail = LoadFile(path, size, data);
+      lock.lock();
+      //the budget follows the bytes actually read
+      bytes_used_ = bytes_used_ - slot.size + data.size();
+      slot.size = data.size();
+      const bool is_dropped = (slot.state == PrefetchState::kDropped);
+      slot.state = fail ? PrefetchState::kFailed : PrefetchState::kReady;
+      slot.data.swap(data);
+      if (is_dropped) {
+        Release(slot);
+        Schedule();
+        queued_.notify_all();
+        continue;
+      }
+      ready_.notify_all();
+    }
+  }
+
+}
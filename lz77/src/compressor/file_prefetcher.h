@@ -0,0 +1,77 @@
+#ifndef COMPRESSOR_FILE_PREFETCHER_H_
+#define COMPRESSOR_FILE_PREFETCHER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+
+namespace compressor {
+
+  static const size_t kPrefetchMemoryBudget = 64 * 1024 * 1024;
+  //larger files are streamed from disk,a few of them would fill the budget
+  static const uint64_t kPrefetchMaxFileSize = 4 * 1024 * 1024;
+  //items read ahead of the one being compressed
+  static const size_t kPrefetchMaxItems = 256;
+  //reads are latency bound,not cpu bound
+  static const unsigned int kPrefetchThreads = 4;
+  static const size_t kPrefetchPoolBuffers = 16;
+
+  enum class PrefetchState { kIdle, kQueued, kLoading, kReady, kFailed, kDropped, kTaken };
+
+  struct PrefetchSlot
+  {
+    uint32_t index;
+    std::wstring path;
+    uint64_t size;
+    PrefetchState state;
+    std::vector<uint8_t> data;
+  };
+
+  //Reads small input files ahead of the encoder. Items are added in the order
+  //the handler is expected to ask for them;while one is compressed the
+  //workers load the next ones into pooled buffers,as long as the reserved
+  //bytes stay within the budget. When the handler asks out of order the
+  //window follows it and the skipped items are dropped.
+  class FilePrefetcher
+  {
+  public:
+    explicit FilePrefetcher(size_t memory_budget = kPrefetchMemoryBudget, unsigned int num_threads = kPrefetchThreads);
+    virtual ~FilePrefetcher();
+    //empty and large files are left to the caller
+    void Add(uint32_t index, const std::wstring& path, uint64_t size);
+    void Start();
+    void Stop();
+    //true when the item was not read ahead (large,unreadable,dropped),
+    //the caller opens it itself
+    bool Take(uint32_t index, std::vector<uint8_t>& data);
+    //returns a buffer from Take,releasing its bytes from the budget
+    void Recycle(std::vector<uint8_t>& data);
+  private:
+    void Schedule();
+    void Release(PrefetchSlot& slot);
+    void WorkerMain();
+    static bool LoadFile(const std::wstring& path, uint64_t size, std::vector<uint8_t>& data);
+    std::vector<PrefetchSlot> slots_;
+    std::unordered_map<uint32_t, size_t> positions_;
+    size_t cursor_; //first slot the handler has not reached
+    size_t next_; //first slot not queued yet
+    std::deque<size_t> queue_;
+    std::vector<std::vector<uint8_t>> pool_;
+    size_t budget_;
+    uint64_t bytes_used_;
+    unsigned int num_threads_;
+    std::mutex lock_;
+    std::condition_variable queued_;
+    std::condition_variable ready_;
+    std::vector<std::thread> workers_;
+    bool is_stopping_;
+  };
+
+}
+
+#endif // !COMPRESSOR_FILE_PREFETCHER_H_
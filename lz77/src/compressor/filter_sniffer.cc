@@ -0,0 +1,99 @@
+#include "compressor/filter_sniffer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace compressor {
+
+  static uint32_t GetLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+  }
+
+  FilterSniffer::FilterSniffer() {
+    entries_.resize(0);
+  }
+  FilterSniffer::~FilterSniffer() {
+    entries_.resize(0);
+  }
+  bool FilterSniffer::IsFiltered(const std::wstring& ext) {
+    for (size_t i = 0; kFilterArchiveTable[i] != nullptr; i++) {
+      if (ext == kFilterArchiveTable[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+  void FilterSniffer::Add(const std::wstring& full_path, uint64_t size, bool is_dir) {
+    FilterEntry entry;
+    entry.full_path = full_path;
+    entry.size = size;
+    entry.is_dir = is_dir;
+    entries_.push_back(entry);
+  }
+  FilterKind FilterSniffer::KindOf(const uint8_t* head, size_t size) {
+    if (size >= 0x40 && head[0] == 'M' && head[1] == 'Z') {
+      //the PE header itself may lie beyond the probe,the handler checks it
+      return FilterKind::kExecutable;
+    }
+    if (size >= 4 && head[0] == 0x7F && head[1] == 'E' && head[2] == 'L' && head[3] == 'F') {
+      return FilterKind::kExecutable;
+    }
+    if (size >= 4) {
+      //32/64-bit Mach-O in either byte order
+      const uint32_t magic = GetLE32(head);
+      if (magic == 0xFEEDFACE || magic == 0xFEEDFACF || magic == 0xCEFAEDFE || magic == 0xCFFAEDFE) {
+        return FilterKind::kExecutable;
+      }
+    }
+    if (size >= 0x16 && !memcmp(head, "RIFF", 4) && !memcmp(head + 8, "WAVEfmt ", 8) &&
+      head[0x14] == 1 && head[0x15] == 0) {
+      //format 1 is integer PCM
+      return FilterKind::kPcm;
+    }
+    return FilterKind::kNone;
+  }
+  FilterKind FilterSniffer::ProbeFile(const std::wstring& path) {
+#if defined(OS_WIN)
+    FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+    FILE* file = fopen(std::string(path.begin(), path.end()).c_str(), "rb");
+#endif
+    if (!file) {
+      //unreadable,the handler will not be able to filter it either
+      return FilterKind::kNone;
+    }
+    uint8_t head[kFilterProbeSize];
+    const size_t count = fread(head, 1, sizeof(head), file);
+    fclose(file);
+    return KindOf(head, count);
+  }
+  size_t FilterSniffer::Sniff(std::vector<uint8_t>& kinds) {
+    kinds.assign(entries_.size(), (uint8_t)FilterKind::kNone);
+    std::vector<uint32_t> probes;
+    for (uint32_t i = 0; i < entries_.size(); i++) {
+      if (!entries_[i].is_dir && entries_[i].size >= kFilterProbeMinSize) {
+        probes.push_back(i);
+      }
+    }
+    std::atomic<size_t> next(0);
+    auto probe_worker = [&]() {
+      for (size_t i = next++; i < probes.size(); i = next++) {
+        kinds[probes[i]] = (uint8_t)ProbeFile(entries_[probes[i]].full_path);
+      }
+    };
+    const unsigned int num_threads = (std::max)(1u,
+      (std::min)(std::thread::hardware_concurrency(), static_cast<unsigned int>(probes.size())));
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < num_threads; i++) {
+      threads.push_back(std::thread(probe_worker));
+    }
+    probe_worker();
+    for (size_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+    return kinds.size() - std::count(kinds.begin(), kinds.end(), (uint8_t)FilterKind::kNone);
+  }
+
+}
@@ -0,0 +1,50 @@
+#ifndef COMPRESSOR_FILTER_SNIFFER_H_
+#define COMPRESSOR_FILTER_SNIFFER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace compressor {
+
+  //formats whose handler assigns branch/delta filters per solid group
+  static const wchar_t *kFilterArchiveTable[] = { L"7z", nullptr };
+  //enough for the PE/ELF/Mach-O/RIFF signatures
+  static const size_t kFilterProbeSize = 64;
+  //the handler only filters executables of at least this size
+  static const uint64_t kFilterProbeMinSize = 512;
+
+  enum class FilterKind : uint8_t { kNone, kExecutable, kPcm };
+  //the 7z handler compresses one filter group after the other,sorted by
+  //method id:unfiltered files,then Delta,then the branch filters
+  static const FilterKind kFilterGroupOrder[] = { FilterKind::kNone, FilterKind::kPcm, FilterKind::kExecutable };
+
+  struct FilterEntry
+  {
+    std::wstring full_path;
+    uint64_t size;
+    bool is_dir;
+  };
+
+  //Finds the files the 7z handler may want a filter for:PE,ELF and Mach-O
+  //executables (BCJ/BCJ2/ARM/ARMT/PPC/SPARC/IA64) and PCM wave audio (Delta).
+  //Probes read a few bytes,in parallel;the handler then parses the headers
+  //of the candidates only,instead of opening every file on its own thread.
+  class FilterSniffer
+  {
+  public:
+    FilterSniffer();
+    virtual ~FilterSniffer();
+    void Add(const std::wstring& full_path, uint64_t size, bool is_dir);
+    //kinds[i] is a FilterKind per item,returns how many are not kNone
+    size_t Sniff(std::vector<uint8_t>& kinds);
+    static bool IsFiltered(const std::wstring& ext);
+    static FilterKind KindOf(const uint8_t* head, size_t size);
+  private:
+    static FilterKind ProbeFile(const std::wstring& path);
+    std::vector<FilterEntry> entries_;
+  };
+
+}
+
+#endif // !COMPRESSOR_FILTER_SNIFFER_H_
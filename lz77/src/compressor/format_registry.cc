@@ -0,0 +1,54 @@
+#include "compressor/format_registry.h"
+#include <cwchar>
+
+namespace compressor {
+
+  bool FormatRegistry::ListHasExt(const wchar_t* list, const std::wstring& ext) {
+    //walk the space separated tokens in place,no allocation
+    const size_t len = ext.size();
+    const wchar_t* p = list;
+    while (*p) {
+      while (*p == L' ') {
+        p++;
+      }
+      const wchar_t* token = p;
+      while (*p && *p != L' ') {
+        p++;
+      }
+      if (static_cast<size_t>(p - token) == len && len > 0 && !wcsncmp(token, ext.c_str(), len)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool FormatRegistry::HasExt(const std::wstring& ext) {
+    return FindByExt(ext) != nullptr;
+  }
+  const StaticFormatInfo* FormatRegistry::FindByExt(const std::wstring& ext) {
+    for (size_t i = 0; i < kStaticFormatCount; i++) {
+      if (ListHasExt(kStaticFormats[i].exts, ext)) {
+        return &kStaticFormats[i];
+      }
+    }
+    return nullptr;
+  }
+  void FormatRegistry::GetExts(std::vector<std::wstring>& exts) {
+    exts.resize(0);
+    for (size_t i = 0; i < kStaticFormatCount; i++) {
+      const wchar_t* p = kStaticFormats[i].exts;
+      while (*p) {
+        while (*p == L' ') {
+          p++;
+        }
+        const wchar_t* token = p;
+        while (*p && *p != L' ') {
+          p++;
+        }
+        if (p != token) {
+          exts.push_back(std::wstring(token, p - token));
+        }
+      }
+    }
+  }
+
+}
@@ -0,0 +1,94 @@
+#ifndef COMPRESSOR_FORMAT_REGISTRY_H_
+#define COMPRESSOR_FORMAT_REGISTRY_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace compressor {
+
+  struct StaticFormatInfo
+  {
+    const wchar_t* name;
+    const wchar_t* exts; //space separated,as in REGISTER_ARC
+  };
+
+  //Formats compiled into this module (USE_STATIC_7Z_COMPONENT),in the order
+  //of their REGISTER_ARC entries in 7-Zip 18.05. Keep in step with the
+  //Archive sources in compressor.vcxproj;debug builds check it against the
+  //handlers the first time the library is initialized.
+  static constexpr StaticFormatInfo kStaticFormats[] = {
+    { L"7z", L"7z" },
+    { L"APM", L"apm" },
+    { L"Ar", L"ar a deb lib" },
+    { L"Arj", L"arj" },
+    { L"bzip2", L"bz2 bzip2 tbz2 tbz" },
+    { L"Cab", L"cab" },
+    { L"Chm", L"chm chi chq chw" },
+    { L"Hxs", L"hxs hxi hxr hxq hxw lit" },
+    { L"Compound", L"msi msp doc xls ppt" },
+    { L"Cpio", L"cpio" },
+    { L"CramFS", L"cramfs" },
+    { L"Dmg", L"dmg" },
+    { L"ELF", L"elf" },
+    { L"Ext", L"ext ext2 ext3 ext4 img" },
+    { L"FAT", L"fat img" },
+    { L"FLV", L"flv" },
+    { L"GPT", L"gpt mbr" },
+    { L"gzip", L"gz gzip tgz tpz apk" },
+    { L"HFS", L"hfs hfsx" },
+    { L"IHex", L"ihex" },
+    { L"Iso", L"iso img" },
+    { L"Lzh", L"lzh lha" },
+    { L"lzma", L"lzma" },
+    { L"lzma86", L"lzma86" },
+    { L"MachO", L"macho" },
+    { L"MBR", L"mbr" },
+    { L"MsLZ", L"mslz" },
+    { L"Mub", L"mub" },
+    { L"Nsis", L"nsis" },
+    { L"NTFS", L"ntfs img" },
+    { L"PE", L"exe dll sys" },
+    { L"COFF", L"obj" },
+    { L"TE", L"te" },
+    { L"Ppmd", L"pmd" },
+    { L"QCOW", L"qcow qcow2 qcow2c" },
+    { L"Rar5", L"rar r00" },
+    { L"Rar", L"rar r00" },
+    { L"Rpm", L"rpm" },
+    { L"Split", L"001" },
+    { L"SquashFS", L"squashfs" },
+    { L"SWFc", L"swf" },
+    { L"SWF", L"swf" },
+    { L"tar", L"tar ova" },
+    { L"Udf", L"udf iso img" },
+    { L"UEFIc", L"scap" },
+    { L"UEFIf", L"uefif" },
+    { L"VDI", L"vdi" },
+    { L"VHD", L"vhd" },
+    { L"VMDK", L"vmdk" },
+    { L"wim", L"wim swm esd ppkg" },
+    { L"Xar", L"xar pkg xip" },
+    { L"xz", L"xz txz" },
+    { L"Z", L"z taz" },
+    { L"zip", L"zip z01 zipx jar xpi odt ods docx xlsx epub ipa apk appx" }
+  };
+
+  static constexpr size_t kStaticFormatCount = sizeof(kStaticFormats) / sizeof(kStaticFormats[0]);
+
+  //Answers extension queries from kStaticFormats,so callers that only need
+  //to know whether a file looks like an archive (shell menu,command line
+  //dispatch) never initialize the 7z library.
+  class FormatRegistry
+  {
+  public:
+    static bool HasExt(const std::wstring& ext);
+    static const StaticFormatInfo* FindByExt(const std::wstring& ext);
+    static void GetExts(std::vector<std::wstring>& exts);
+  private:
+    static bool ListHasExt(const wchar_t* list, const std::wstring& ext);
+  };
+
+}
+
+#endif // !COMPRESSOR_FORMAT_REGISTRY_H_
@@ -0,0 +1,333 @@
+#include "compressor/iso_extractor.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <archive_entry.h>
+#include "base/string_conv.h"
+#include "compressor/extract_writer_pool.h"
+
+#if defined(OS_WIN)
+#include <windows.h>
+#endif
+
+namespace compressor {
+
+  static const wchar_t * const kIsoOpenFailed = L"open failed!";
+  static const wchar_t * const kIsoReadFailed = L"read failed!";
+  static const wchar_t * const kIsoMkdirFailed = L"mkdir failed!";
+  static const wchar_t * const kIsoUnsafePath = L"unsafe path!";
+  //100ns ticks from 1601 to 1970
+  static const uint64_t kIsoUnixEpochTicks = 116444736000000000ULL;
+
+  static uint64_t ToFileTime(time_t t) {
+    return t > 0 ? (uint64_t)t * 10000000 + kIsoUnixEpochTicks : 0;
+  }
+
+  IsoExtractor::IsoExtractor() {
+    file_ = nullptr;
+    aligned_buffer_ = nullptr;
+    image_size_ = 0;
+    position_ = 0;
+    stats_ = nullptr;
+    errors_.clear();
+  }
+  IsoExtractor::~IsoExtractor() {
+    CloseImage();
+  }
+  IsoVolumeKind IsoExtractor::Probe(const std::wstring& iso_path) {
+#if defined(OS_WIN)
+    FILE* file = _wfopen(iso_path.c_str(), L"rb");
+#else
+    FILE* file = fopen(std::string(iso_path.begin(), iso_path.end()).c_str(), "rb");
+#endif
+    if (!file) {
+      return IsoVolumeKind::kUnknown;
+    }
+    std::vector<uint8_t> sectors(kIsoMaxDescriptors * kIsoSectorSize);
+    size_t count = 0;
+    if (!fseek(file, (long)(kIsoDescriptorSector * kIsoSectorSize), SEEK_SET)) {
+      count = fread(&sectors[0], 1, sectors.size(), file) / kIsoSectorSize;
+    }
+    fclose(file);
+    IsoVolumeKind kind = IsoVolumeKind::kUnknown;
+    for (size_t i = 0; i < count; i++) {
+      const uint8_t* sector = &sectors[i * kIsoSectorSize];
+      const char* id = reinterpret_cast<const char*>(sector + 1);
+      if (!memcmp(id, "NSR02", 5) || !memcmp(id, "NSR03", 5)) {
+        //UDF wins,the ISO 9660 tree of a bridge image is often a stub
+        return IsoVolumeKind::kUdf;
+      }
+      if (!memcmp(id, "CD001", 5)) {
+        if (sector[0] == 1 && kind == IsoVolumeKind::kUnknown) {
+          kind = IsoVolumeKind::kIso9660;
+        }
+        //supplementary descriptor with a UCS-2 escape sequence
+        else if (sector[0] == 2 && sector[88] == '%' && sector[89] == '/' &&
+          (sector[90] == '@' || sector[90] == 'C' || sector[90] == 'E')) {
+          kind = IsoVolumeKind::kJoliet;
+        }
+        continue;
+      }
+      if (!memcmp(id, "BEA01", 5) || !memcmp(id, "BOOT2", 5) || !memcmp(id, "CDW02", 5)) {
+        continue;
+      }
+      //TEA01 or the end of the volume recognition area
+      break;
+    }
+    return kind;
+  }
+  bool IsoExtractor::ToRelativePath(const char* name, std::wstring& rpath) {
+    base::StringConv conv;
+    //Rock Ridge names are UTF-8 bytes as far as libarchive is concerned
+    conv.StrToWStr(name ? name : "");
+    rpath.resize(0);
+    const std::wstring& path = conv.wdst();
+    size_t pos = 0;
+    while (pos < path.size()) {
+      size_t end = path.find(L'/', pos);
+      if (end == std::wstring::npos) {
+        end = path.size();
+      }
+      const size_t len = end - pos;
+      if (len == 2 && path[pos] == L'.' && path[pos + 1] == L'.') {
+        //fail
+        return true;
+      }
+      if (len > 0 && !(len == 1 && path[pos] == L'.')) {
+        if (!rpath.empty()) {
+          rpath += kPathSeparator;
+        }
+        rpath.append(path, pos, len);
+      }
+      pos = end + 1;
+    }
+    return false;
+  }
+#if defined(OS_WIN)
+  bool IsoExtractor::OpenImage(const std::wstring& iso_path) {
+    HANDLE file = CreateFileW(iso_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      //fail
+      return true;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+      CloseHandle(file);
+      return true;
+    }
+    file_ = file;
+    image_size_ = (uint64_t)size.QuadPart;
+    //success
+    return false;
+  }
+  void IsoExtractor::CloseImage() {
+    if (file_) {
+      CloseHandle(static_cast<HANDLE>(file_));
+      file_ = nullptr;
+    }
+  }
+  ssize_t IsoExtractor::ReadCallback(struct archive* a, void* client_data, const void** buffer) {
+    IsoExtractor* self = static_cast<IsoExtractor*>(client_data);
+    DWORD count = 0;
+    if (!ReadFile(static_cast<HANDLE>(self->file_), self->aligned_buffer_, (DWORD)kIsoReadSize, &count, nullptr)) {
+      archive_set_error(a, EIO, "read failed");
+      return -1;
+    }
+    self->position_ += count;
+    *buffer = self->aligned_buffer_;
+    return (ssize_t)count;
+  }
+  off_t IsoExtractor::SkipCallback(struct archive* a, void* client_data, off_t request) {
+    IsoExtractor* self = static_cast<IsoExtractor*>(client_data);
+    //whole read blocks only,libarchive reads the rest,so reads stay aligned
+    const off_t skip = request - (off_t)(request % (off_t)kIsoReadSize);
+    if (skip <= 0) {
+      return 0;
+    }
+    LARGE_INTEGER distance;
+    distance.QuadPart = skip;
+    if (!SetFilePointerEx(static_cast<HANDLE>(self->file_), distance, nullptr, FILE_CURRENT)) {
+      return 0;
+    }
+    self->position_ += skip;
+    return skip;
+  }
+#else
+  bool IsoExtractor::OpenImage(const std::wstring& iso_path) {
+    FILE* file = fopen(std::string(iso_path.begin(), iso_path.end()).c_str(), "rb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    //our blocks are already large,no second copy through stdio
+    setvbuf(file, nullptr, _IONBF, 0);
+    fseeko(file, 0, SEEK_END);
+    image_size_ = (uint64_t)ftello(file);
+    fseeko(file, 0, SEEK_SET);
+    file_ = file;
+    //success
+    return false;
+  }
+  void IsoExtractor::CloseImage() {
+    if (file_) {
+      fclose(static_cast<FILE*>(file_));
+      file_ = nullptr;
+    }
+  }
+  ssize_t IsoExtractor::ReadCallback(struct archive* a, void* client_data, const void** buffer) {
+    IsoExtractor* self = static_cast<IsoExtractor*>(client_data);
+    FILE* file = static_cast<FILE*>(self->file_);
+    const size_t count = fread(self->aligned_buffer_, 1, kIsoReadSize, file);
+    if (count == 0 && ferror(file)) {
+      archive_set_error(a, EIO, "read failed");
+      return -1;
+    }
+    self->position_ += count;
+    *buffer = self->aligned_buffer_;
+    return (ssize_t)count;
+  }
+  off_t IsoExtractor::SkipCallback(struct archive* a, void* client_data, off_t request) {
+    IsoExtractor* self = static_cast<IsoExtractor*>(client_data);
+    const off_t skip = request - (off_t)(request % (off_t)kIsoReadSize);
+    if (skip <= 0 || fseeko(static_cast<FILE*>(self->file_), skip, SEEK_CUR)) {
+      return 0;
+    }
+    self->position_ += skip;
+    return skip;
+  }
+#endif
+  bool IsoExtractor::Extract(const std::wstring& iso_path, const std::wstring& dir) {
+    errors_.clear();
+    position_ = 0;
+    {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kOpen);
+      if (OpenImage(iso_path)) {
+        //fail
+        errors_[iso_path] = kIsoOpenFailed;
+        return true;
+      }
+    }
+    buffer_.resize(kIsoReadSize + kIsoReadAlignment);
+    const uintptr_t address = reinterpret_cast<uintptr_t>(&buffer_[0]);
+    aligned_buffer_ = &buffer_[0] + ((kIsoReadAlignment - address % kIsoReadAlignment) % kIsoReadAlignment);
+    if (stats_) {
+      stats_->SetTotal(image_size_);
+    }
+    struct archive* a = archive_read_new();
+    archive_read_support_format_iso9660(a);
+    if (archive_read_open2(a, this, nullptr, ReadCallback, SkipCallback, nullptr) != ARCHIVE_OK) {
+      errors_[iso_path] = kIsoReadFailed;
+      archive_read_finish(a);
+      CloseImage();
+      return true;
+    }
+    dir_cache_.Reset(dir);
+    ExtractWriterPool writer_pool(0, kWriterMaxInflightBytes);
+    writer_pool.SetStats(stats_);
+    bool fail = false;
+    std::wstring rpath;
+    std::wstring full_path;
+    for (;;) {
+      struct archive_entry* entry = nullptr;
+      int res = ARCHIVE_OK;
+      {
+        OperationStats::ScopedPhase phase(stats_, OperationPhase::kHeaderParse);
+        res = archive_read_next_header(a, &entry);
+      }
+      if (res == ARCHIVE_EOF) {
+        break;
+      }
+      if (res != ARCHIVE_OK && res != ARCHIVE_WARN) {
+        errors_[iso_path] = kIsoReadFailed;
+        fail = true;
+        break;
+      }
+      if (ToRelativePath(archive_entry_pathname(entry), rpath)) {
+        //never write outside dir
+        errors_[base::StringConv::widen(archive_entry_pathname(entry))] = kIsoUnsafePath;
+        continue;
+      }
+      if (rpath.empty()) {
+        continue;
+      }
+      full_path = dir_cache_.Join(rpath);
+      const mode_t type = archive_entry_filetype(entry);
+      if (type == AE_IFDIR) {
+        //before any file below it reaches a writer thread
+        OperationStats::ScopedPhase phase(stats_, OperationPhase::kMkdir);
+        if (dir_cache_.EnsureDir(full_path.c_str(), full_path.size())) {
+          errors_[full_path] = kIsoMkdirFailed;
+        }
+        continue;
+      }
+      if (type != AE_IFREG) {
+        //links and devices of Rock Ridge images have no Windows counterpart
+        continue;
+      }
+      {
+        OperationStats::ScopedPhase phase(stats_, OperationPhase::kMkdir);
+        if (dir_cache_.EnsureParent(full_path)) {
+          errors_[full_path] = kIsoMkdirFailed;
+          continue;
+        }
+      }
+      const int64_t size = archive_entry_size(entry);
+      ExtractWriteJob* job = writer_pool.Open(full_path, size > 0 ? (uint64_t)size : 0);
+      bool is_ok = true;
+      for (;;) {
+        const void* block = nullptr;
+        size_t block_size = 0;
+        off_t offset = 0;
+        {
+          OperationStats::ScopedPhase phase(stats_, OperationPhase::kDecode);
+          res = archive_read_data_block(a, &block, &block_size, &offset);
+        }
+        if (res == ARCHIVE_EOF) {
+          break;
+        }
+        if (res != ARCHIVE_OK && res != ARCHIVE_WARN) {
+          errors_[full_path] = kIsoReadFailed;
+          is_ok = false;
+          break;
+        }
+        if (block_size > 0 && writer_pool.Write(job, block, block_size)) {
+          is_ok = false;
+          break;
+        }
+        if (stats_) {
+          writer_pool.PublishBytesOut();
+          stats_->SetCompleted(position_);
+        }
+      }
+      ExtractFileMeta meta;
+      meta.ctime = ToFileTime(archive_entry_ctime(entry));
+      meta.atime = ToFileTime(archive_entry_atime(entry));
+      meta.mtime = ToFileTime(archive_entry_mtime(entry));
+      meta.attrib = 0;
+      meta.has_attrib = false;
+      writer_pool.Close(job, meta);
+      if (stats_) {
+        stats_->AddItem();
+      }
+      if (!is_ok && res != ARCHIVE_OK && res != ARCHIVE_WARN) {
+        //the stream itself is broken,the following headers cannot be trusted
+        fail = true;
+        break;
+      }
+    }
+    writer_pool.Finish();
+    writer_pool.PublishBytesOut();
+    const std::map<std::wstring, std::wstring>& write_errors = writer_pool.errors();
+    errors_.insert(write_errors.begin(), write_errors.end());
+    archive_read_close(a);
+    archive_read_finish(a);
+    CloseImage();
+    if (stats_) {
+      stats_->SetCompleted(position_);
+    }
+    return fail || !errors_.empty();
+  }
+
+}
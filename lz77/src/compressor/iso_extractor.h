@@ -0,0 +1,61 @@
+#ifndef COMPRESSOR_ISO_EXTRACTOR_H_
+#define COMPRESSOR_ISO_EXTRACTOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include "compressor/operation_stats.h"
+#include "compressor/extract_dir_cache.h"
+#include <archive.h>
+
+namespace compressor {
+
+  static const size_t kIsoSectorSize = 2048;
+  //one read per callback,a multiple of any disk sector size
+  static const size_t kIsoReadSize = 1024 * 1024;
+  static const size_t kIsoReadAlignment = 4096;
+  //volume descriptors start at sector 16,the UDF recognition area follows them
+  static const uint64_t kIsoDescriptorSector = 16;
+  static const size_t kIsoMaxDescriptors = 32;
+
+  enum class IsoVolumeKind { kUnknown, kIso9660, kJoliet, kUdf };
+
+  //Streams an ISO 9660 (Rock Ridge) image to a directory with libarchive.
+  //The image is read front to back in 1 MiB aligned blocks,directories are
+  //created on the reading thread before any file under them is handed out
+  //and file data goes through ExtractWriterPool,so the disk writes overlap
+  //the reads. libarchive 2.4 has no Joliet or UDF reader:Probe() tells the
+  //caller when the 7-Zip handler has to extract the image instead.
+  class IsoExtractor
+  {
+  public:
+    IsoExtractor();
+    virtual ~IsoExtractor();
+    static IsoVolumeKind Probe(const std::wstring& iso_path);
+    bool Extract(const std::wstring& iso_path, const std::wstring& dir);
+    void SetStats(OperationStats* stats) {
+      stats_ = stats;
+    }
+    const std::map<std::wstring, std::wstring>& errors() const {
+      return errors_;
+    }
+  private:
+    static ssize_t ReadCallback(struct archive* a, void* client_data, const void** buffer);
+    static off_t SkipCallback(struct archive* a, void* client_data, off_t request);
+    static bool ToRelativePath(const char* name, std::wstring& rpath);
+    bool OpenImage(const std::wstring& iso_path);
+    void CloseImage();
+    void* file_;
+    std::vector<uint8_t> buffer_;
+    uint8_t* aligned_buffer_;
+    uint64_t image_size_;
+    uint64_t position_;
+    ExtractDirCache dir_cache_;
+    OperationStats* stats_;
+    std::map<std::wstring, std::wstring> errors_;
+  };
+
+}
+
+#endif // !COMPRESSOR_ISO_EXTRACTOR_H_
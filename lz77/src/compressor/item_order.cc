@@ -0,0 +1,180 @@
+#include "compressor/item_order.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cwctype>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include "lz4-dev/lib/xxhash.h"
+
+namespace compressor {
+
+  ItemOrderer::ItemOrderer() {
+    duplicate_count_ = 0;
+  }
+  ItemOrderer::~ItemOrderer() {
+    duplicate_count_ = 0;
+  }
+  bool ItemOrderer::IsOrdered(const std::wstring& ext) {
+    for (size_t i = 0; kContentOrderArchiveTable[i] != nullptr; i++) {
+      if (ext == kContentOrderArchiveTable[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+  std::wstring ItemOrderer::ExtOf(const std::wstring& name) {
+    return ExtOf(name.data(), name.size());
+  }
+  std::wstring ItemOrderer::ExtOf(const wchar_t* name, size_t length) {
+    //the last dot after the last separator
+    size_t dot_pos = length;
+    for (size_t i = length; i > 0; i--) {
+      const wchar_t c = name[i - 1];
+      if (c == L'\\' || c == L'/') {
+        break;
+      }
+      if (c == L'.') {
+        dot_pos = i - 1;
+        break;
+      }
+    }
+    if (dot_pos == length) {
+      return std::wstring();
+    }
+    std::wstring ext(name + dot_pos + 1, length - dot_pos - 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), towlower);
+    return ext;
+  }
+  bool ItemOrderer::HashFile(const std::wstring& path, uint64_t& hash) {
+#if defined(OS_WIN)
+    FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+    FILE* file = fopen(std::string(path.begin(), path.end()).c_str(), "rb");
+#endif
+    if (!file) {
+      //fail
+      return true;
+    }
+    std::vector<uint8_t> buffer(kDuplicateHashBufferSize);
+    XXH64_state_t* state = XXH64_createState();
+    XXH64_reset(state, 0);
+    size_t count = 0;
+    while ((count = fread(&buffer[0], 1, buffer.size(), file)) > 0) {
+      XXH64_update(state, &buffer[0], count);
+    }
+    const bool fail = ferror(file) != 0;
+    fclose(file);
+    hash = XXH64_digest(state);
+    XXH64_freeState(state);
+    return fail;
+  }
+  void ItemOrderer::FindDuplicates(const ItemTable& items, std::vector<uint32_t>& leaders) {
+    leaders.resize(items.size());
+    for (uint32_t i = 0; i < leaders.size(); i++) {
+      leaders[i] = i;
+    }
+    //only files sharing their size with another one can be duplicates
+    std::unordered_map<uint64_t, std::vector<uint32_t>> by_size;
+    for (uint32_t i = 0; i < items.size(); i++) {
+      if (!items.IsDir(i) && items.Size(i) >= kDuplicateMinSize) {
+        by_size[items.Size(i)].push_back(i);
+      }
+    }
+    std::vector<uint32_t> candidates;
+    std::unordered_map<uint64_t, std::vector<uint32_t>>::const_iterator it;
+    for (it = by_size.begin(); it != by_size.end(); it++) {
+      if (it->second.size() > 1) {
+        candidates.insert(candidates.end(), it->second.begin(), it->second.end());
+      }
+    }
+    if (candidates.empty()) {
+      return;
+    }
+    std::sort(candidates.begin(), candidates.end());
+    std::vector<uint64_t> hashes(candidates.size(), 0);
+    std::vector<uint8_t> hashed(candidates.size(), 0);
+    std::atomic<size_t> next(0);
+    auto hash_worker = [&]() {
+      for (size_t i = next++; i < candidates.size(); i = next++) {
+        hashed[i] = !HashFile(items.DiskPath(candidates[i]), hashes[i]);
+      }
+    };
+    const unsigned int num_threads = (std::max)(1u,
+      (std::min)(std::thread::hardware_concurrency(), static_cast<unsigned int>(candidates.size())));
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < num_threads; i++) {
+      threads.push_back(std::thread(hash_worker));
+    }
+    hash_worker();
+    for (size_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+    //candidates are in item order,so the first copy becomes the leader
+    std::map<std::pair<uint64_t, uint64_t>, uint32_t> first_copy;
+    for (size_t i = 0; i < candidates.size(); i++) {
+      if (!hashed[i]) {
+        continue;
+      }
+      const uint32_t index = candidates[i];
+      const std::pair<uint64_t, uint64_t> key(items.Size(index), hashes[i]);
+      std::map<std::pair<uint64_t, uint64_t>, uint32_t>::const_iterator found = first_copy.find(key);
+      if (found == first_copy.end()) {
+        first_copy[key] = index;
+        continue;
+      }
+      leaders[index] = found->second;
+      duplicate_count_++;
+    }
+  }
+  void ItemOrderer::Build(const ItemTable& items, std::vector<uint32_t>& order) {
+    order.resize(0);
+    order.reserve(items.size());
+    duplicate_count_ = 0;
+    std::vector<uint32_t> leaders;
+    FindDuplicates(items, leaders);
+    std::vector<uint32_t> files;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> followers;
+    for (uint32_t i = 0; i < items.size(); i++) {
+      if (items.IsDir(i)) {
+        order.push_back(i);
+      }
+      else if (leaders[i] == i) {
+        files.push_back(i);
+      }
+      else {
+        followers[leaders[i]].push_back(i);
+      }
+    }
+    //each distinct extension once,ranked in name order,so the sort compares
+    //numbers instead of strings
+    std::map<std::wstring, uint32_t> exts;
+    std::vector<uint32_t*> ext_slots(items.size(), nullptr);
+    for (size_t i = 0; i < files.size(); i++) {
+      const uint32_t index = files[i];
+      ext_slots[index] = &exts[ExtOf(items.NameData(index), items.NameLength(index))];
+    }
+    uint32_t rank = 0;
+    for (std::map<std::wstring, uint32_t>::iterator it = exts.begin(); it != exts.end(); it++) {
+      it->second = rank++;
+    }
+    std::stable_sort(files.begin(), files.end(), [&items, &ext_slots](uint32_t a, uint32_t b) {
+      if (*ext_slots[a] != *ext_slots[b]) {
+        return *ext_slots[a] < *ext_slots[b];
+      }
+      if (items.Size(a) != items.Size(b)) {
+        return items.Size(a) < items.Size(b);
+      }
+      return items.CompareNames(a, b) < 0;
+    });
+    for (size_t i = 0; i < files.size(); i++) {
+      order.push_back(files[i]);
+      std::unordered_map<uint32_t, std::vector<uint32_t>>::const_iterator it = followers.find(files[i]);
+      if (it != followers.end()) {
+        order.insert(order.end(), it->second.begin(), it->second.end());
+      }
+    }
+  }
+
+}
@@ -0,0 +1,45 @@
+#ifndef COMPRESSOR_ITEM_ORDER_H_
+#define COMPRESSOR_ITEM_ORDER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "compressor/item_table.h"
+
+namespace compressor {
+
+  //formats that compress items as one stream,where the order matters
+  static const wchar_t *kContentOrderArchiveTable[] = { L"7z", L"tar", L"tar.gz", L"tar.xz", L"tar.bz2", nullptr };
+  //smaller duplicates cost less to compress than to hash
+  static const uint64_t kDuplicateMinSize = 4 * 1024;
+  static const size_t kDuplicateHashBufferSize = 1024 * 1024;
+
+  //Orders archive items so similar data shares the dictionary window:
+  //directories first,then files grouped by extension and size (like 7-Zip's
+  //-mqs),and every file directly followed by its exact duplicates. Files of
+  //equal size are hashed with XXH64 in parallel;a hash collision only costs
+  //ratio,the archive content is unaffected. Works on the ItemTable rows,disk
+  //paths are only built for the files that get hashed.
+  class ItemOrderer
+  {
+  public:
+    ItemOrderer();
+    virtual ~ItemOrderer();
+    //fills order with the row indices in archive order
+    void Build(const ItemTable& items, std::vector<uint32_t>& order);
+    size_t duplicate_count() const {
+      return duplicate_count_;
+    }
+    static bool IsOrdered(const std::wstring& ext);
+    //lower case,empty when none
+    static std::wstring ExtOf(const std::wstring& name);
+    static std::wstring ExtOf(const wchar_t* name, size_t length);
+  private:
+    static bool HashFile(const std::wstring& path, uint64_t& hash);
+    void FindDuplicates(const ItemTable& items, std::vector<uint32_t>& leaders);
+    size_t duplicate_count_;
+  };
+
+}
+
+#endif // !COMPRESSOR_ITEM_ORDER_H_
@@ -0,0 +1,166 @@
+#include "compressor/item_table.h"
+#include "compressor/dir_scanner.h"
+#include <algorithm>
+
+namespace compressor {
+
+  ItemTable::ItemTable() {
+    Clear();
+  }
+  ItemTable::~ItemTable() {
+    Clear();
+  }
+  void ItemTable::Reserve(size_t count) {
+    if (count <= size_.capacity()) {
+      return;
+    }
+    count = (std::max)(count, size_.capacity() * 2);
+    size_.reserve(count);
+    ctime_.reserve(count);
+    atime_.reserve(count);
+    mtime_.reserve(count);
+    attrib_.reserve(count);
+    parent_.reserve(count);
+    name_offset_.reserve(count);
+    name_length_.reserve(count);
+    is_dir_.reserve(count);
+  }
+  uint32_t ItemTable::AddRoot(const std::wstring& name, const std::wstring& disk_path) {
+    dirs_.clear();
+    //single files from one directory share their root
+    if (!roots_.empty() && roots_.back().name == name && roots_.back().disk_path == disk_path) {
+      return static_cast<uint32_t>(roots_.size() - 1);
+    }
+    ItemRoot root;
+    root.name = name;
+    root.disk_path = disk_path;
+    roots_.push_back(root);
+    return static_cast<uint32_t>(roots_.size() - 1);
+  }
+  uint32_t ItemTable::Add(uint32_t root, const std::wstring& path, uint64_t size,
+    uint64_t ctime, uint64_t atime, uint64_t mtime, uint32_t attrib, bool is_dir) {
+    const uint32_t index = static_cast<uint32_t>(size_.size());
+    uint32_t parent = kItemRootFlag | root;
+    size_t leaf = 0;
+    const size_t separator = path.rfind(kScanPathSeparator);
+    if (separator != std::wstring::npos) {
+      //an unknown parent keeps the whole relative path as the name
+      std::unordered_map<std::wstring, uint32_t>::const_iterator found = dirs_.find(path.substr(0, separator));
+      if (found != dirs_.end()) {
+        parent = found->second;
+        leaf = separator + 1;
+      }
+    }
+    if (is_dir) {
+      dirs_[path] = index;
+    }
+    size_.push_back(size);
+    ctime_.push_back(ctime);
+    atime_.push_back(atime);
+    mtime_.push_back(mtime);
+    attrib_.push_back(attrib);
+    parent_.push_back(parent);
+    name_offset_.push_back(static_cast<uint32_t>(names_.size()));
+    name_length_.push_back(static_cast<uint32_t>(path.size() - leaf));
+    is_dir_.push_back(is_dir ? 1 : 0);
+    names_.append(path, leaf, std::wstring::npos);
+    return index;
+  }
+  void ItemTable::EndRoot() {
+    std::unordered_map<std::wstring, uint32_t>().swap(dirs_);
+  }
+  void ItemTable::Permute(const std::vector<uint32_t>& order) {
+    std::vector<uint32_t> position(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      position[order[i]] = static_cast<uint32_t>(i);
+    }
+    std::vector<uint64_t> size(order.size());
+    std::vector<uint64_t> ctime(order.size());
+    std::vector<uint64_t> atime(order.size());
+    std::vector<uint64_t> mtime(order.size());
+    std::vector<uint32_t> attrib(order.size());
+    std::vector<uint32_t> parent(order.size());
+    std::vector<uint32_t> name_offset(order.size());
+    std::vector<uint32_t> name_length(order.size());
+    std::vector<uint8_t> is_dir(order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+      const uint32_t from = order[i];
+      size[i] = size_[from];
+      ctime[i] = ctime_[from];
+      atime[i] = atime_[from];
+      mtime[i] = mtime_[from];
+      attrib[i] = attrib_[from];
+      parent[i] = (parent_[from] & kItemRootFlag) ? parent_[from] : position[parent_[from]];
+      name_offset[i] = name_offset_[from];
+      name_length[i] = name_length_[from];
+      is_dir[i] = is_dir_[from];
+    }
+    //the arena stays as it is,only the offsets move
+    size_.swap(size);
+    ctime_.swap(ctime);
+    atime_.swap(atime);
+    mtime_.swap(mtime);
+    attrib_.swap(attrib);
+    parent_.swap(parent);
+    name_offset_.swap(name_offset);
+    name_length_.swap(name_length);
+    is_dir_.swap(is_dir);
+  }
+  void ItemTable::Clear() {
+    size_.resize(0);
+    ctime_.resize(0);
+    atime_.resize(0);
+    mtime_.resize(0);
+    attrib_.resize(0);
+    parent_.resize(0);
+    name_offset_.resize(0);
+    name_length_.resize(0);
+    is_dir_.resize(0);
+    names_.resize(0);
+    roots_.resize(0);
+    dirs_.clear();
+  }
+  uint32_t ItemTable::RelativePath(size_t index, std::wstring& path) const {
+    //one walk up for the length,a second one fills the path from its end
+    size_t length = 0;
+    uint32_t item = static_cast<uint32_t>(index);
+    for (;;) {
+      length += name_length_[item] + 1;
+      if (parent_[item] & kItemRootFlag) {
+        break;
+      }
+      item = parent_[item];
+    }
+    const uint32_t root = parent_[item] & ~kItemRootFlag;
+    path.resize(length - 1);
+    size_t pos = path.size();
+    item = static_cast<uint32_t>(index);
+    for (;;) {
+      pos -= name_length_[item];
+      names_.copy(&path[0] + pos, name_length_[item], name_offset_[item]);
+      if (parent_[item] & kItemRootFlag) {
+        break;
+      }
+      path[--pos] = kScanPathSeparator;
+      item = parent_[item];
+    }
+    return root;
+  }
+  std::wstring ItemTable::Path(size_t index) const {
+    std::wstring path;
+    const ItemRoot& root = roots_[RelativePath(index, path)];
+    if (root.name.empty()) {
+      return path;
+    }
+    return root.name + kScanPathSeparator + path;
+  }
+  std::wstring ItemTable::DiskPath(size_t index) const {
+    std::wstring path;
+    const ItemRoot& root = roots_[RelativePath(index, path)];
+    if (root.disk_path.empty()) {
+      return path;
+    }
+    return root.disk_path + kScanPathSeparator + path;
+  }
+
+}
@@ -0,0 +1,106 @@
+#ifndef COMPRESSOR_ITEM_TABLE_H_
+#define COMPRESSOR_ITEM_TABLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace compressor {
+
+  //parent_ values with this bit set name a root,not an item
+  static const uint32_t kItemRootFlag = 0x80000000u;
+
+  //Items to archive kept column by column. Sizes,times and attributes live in
+  //plain arrays;a name is only the last path component,stored in one shared
+  //character arena with the index of its parent directory,so a directory
+  //prefix is kept once however many items sit under it. Full archive and disk
+  //paths are rebuilt on demand by walking the parents up to a root.
+  //A million items take about 50 bytes each plus their leaf names,instead of
+  //two heap strings holding the whole path.
+  class ItemTable
+  {
+  public:
+    ItemTable();
+    virtual ~ItemTable();
+    //room for count items,grown at least twofold so reserving per root
+    //stays amortized
+    void Reserve(size_t count);
+    //starts a tree:its items are named name\... in the archive and read from
+    //disk_path\...,either may be empty. Returns the root to add items to
+    uint32_t AddRoot(const std::wstring& name, const std::wstring& disk_path);
+    //path is relative to the root,a directory must be added before its contents
+    uint32_t Add(uint32_t root, const std::wstring& path, uint64_t size,
+      uint64_t ctime, uint64_t atime, uint64_t mtime, uint32_t attrib, bool is_dir);
+    //drops the lookup of the root's directories once its items are all added
+    void EndRoot();
+    //reorders the items,item i becomes order[i]
+    void Permute(const std::vector<uint32_t>& order);
+    void Clear();
+
+    size_t size() const {
+      return size_.size();
+    }
+    uint64_t Size(size_t index) const {
+      return size_[index];
+    }
+    uint64_t CTime(size_t index) const {
+      return ctime_[index];
+    }
+    uint64_t ATime(size_t index) const {
+      return atime_[index];
+    }
+    uint64_t MTime(size_t index) const {
+      return mtime_[index];
+    }
+    uint32_t Attrib(size_t index) const {
+      return attrib_[index];
+    }
+    bool IsDir(size_t index) const {
+      return is_dir_[index] != 0;
+    }
+    //last path component
+    std::wstring Name(size_t index) const {
+      return names_.substr(name_offset_[index], name_length_[index]);
+    }
+    //the same,in place in the arena and not terminated
+    const wchar_t* NameData(size_t index) const {
+      return names_.data() + name_offset_[index];
+    }
+    size_t NameLength(size_t index) const {
+      return name_length_[index];
+    }
+    int CompareNames(size_t left, size_t right) const {
+      return names_.compare(name_offset_[left], name_length_[left],
+        names_, name_offset_[right], name_length_[right]);
+    }
+    //path inside the archive
+    std::wstring Path(size_t index) const;
+    //path of the file to read
+    std::wstring DiskPath(size_t index) const;
+  private:
+    struct ItemRoot
+    {
+      std::wstring name;
+      std::wstring disk_path;
+    };
+    //path below the root and the root it hangs from
+    uint32_t RelativePath(size_t index, std::wstring& path) const;
+
+    std::vector<uint64_t> size_;
+    std::vector<uint64_t> ctime_; //FILETIME ticks
+    std::vector<uint64_t> atime_;
+    std::vector<uint64_t> mtime_;
+    std::vector<uint32_t> attrib_;
+    std::vector<uint32_t> parent_; //item index,or kItemRootFlag|root
+    std::vector<uint32_t> name_offset_;
+    std::vector<uint32_t> name_length_;
+    std::vector<uint8_t> is_dir_;
+    std::wstring names_;
+    std::vector<ItemRoot> roots_;
+    std::unordered_map<std::wstring, uint32_t> dirs_; //relative path to item,current root only
+  };
+
+}
+
+#endif // !COMPRESSOR_ITEM_TABLE_H_
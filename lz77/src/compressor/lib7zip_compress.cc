@@ -1,4 +1,5 @@
 #include "compressor/lib7zip_compress.h"
+#include "compressor/format_registry.h"
 #include <filesystem>
 #include "base/path.h"
 #include "base/string_conv.h"
@@ -10,9 +11,11 @@
 #include <vector>
 #include <utility>
 #include <algorithm>
+#include <cwctype>
 #include <functional>
 #include <mutex>
 #include <future>
+#include <cassert>
 
 #if defined(OS_WIN)
 #include "base/win/cpu.h"
@@ -38,7 +41,8 @@ namespace compressor {
 
   static const wchar_t * const kEmptyFileAlias = L"[Content]";
 
-  Wrapper7zCompress::Wrapper7zCompress():archive_(nullptr){
+  Wrapper7zCompress::Wrapper7zCompress() {
+    is_lib_ready_ = false;
     exts_.resize(0);
     error_file_msg_.clear();
     is_signed_file_ = false;
@@ -49,235 +53,378 @@ namespace compressor {
     is_signed_file_ = false;
   }
   bool Wrapper7zCompress::Init(AskOpenArchivePassword* ask_open_password) {
+    //extension queries come from the compiled-in table,the handlers are
+    //only created once an archive is actually opened
+    FormatRegistry::GetExts(exts_);
+    lib_.SetAskOpenArchivePassword(ask_open_password);
+    //success
+    return false;
+  }
+  bool Wrapper7zCompress::EnsureLibrary() {
+    std::lock_guard<std::mutex> lock(lib_lock_);
+    if (is_lib_ready_) {
+      //success
+      return false;
+    }
     if (!lib_.Initialize()) {
       //fail
       return true;
     }
-    if (!lib_.GetSupportedExts(exts_)) {
-      //fail
-      return true;
+#if !defined(NDEBUG)
+    //kStaticFormats must list every extension the linked handlers register,
+    //and nothing the handlers do not
+    WStringArray lib_exts;
+    lib_.GetSupportedExts(lib_exts);
+    for (size_t i = 0; i < lib_exts.size(); i++) {
+      assert(FormatRegistry::HasExt(lib_exts[i]));
     }
-    lib_.SetAskOpenArchivePassword(ask_open_password);
+    std::vector<std::wstring> registry_exts;
+    FormatRegistry::GetExts(registry_exts);
+    for (size_t i = 0; i < registry_exts.size(); i++) {
+      assert(std::find(lib_exts.begin(), lib_exts.end(), registry_exts[i]) != lib_exts.end());
+    }
+#endif
+    is_lib_ready_ = true;
     //success
     return false;
   }
-  bool Wrapper7zCompress::UncompressDirs(const std::wstring& archive_name,
-    const std::wstring& dirs,
+  C7ZipArchive* Wrapper7zCompress::OpenForExtract(ArchiveSession& session,
+    const std::wstring& archive_name,
     const std::wstring& password) {
     is_password_defined_ = false;
     is_signed_file_ = false;
     error_file_msg_.clear();
-    uint32_t numItems = -1;
     base::Path path(archive_name);
-    if (!path.IsFile()) {
-      return true;
+    if (!path.IsFile() || EnsureLibrary()) {
+      return nullptr;
     }
-    Wrapper7zMultiVolumes* volumes = nullptr;
-    Wrapper7zInStream* stream = nullptr;
-    if (Is7zMultiVolumesExt(path.ext())){
-      volumes = new Wrapper7zMultiVolumes(archive_name);
-      if (lib_.OpenMultiVolumeArchive(volumes, &archive_, true)) {
-        archive_->GetItemCount(&numItems);
-        archive_->SetRootDir(dirs.c_str());
-        if (password.length() > 0) {
-          archive_->SetArchivePassword(password);
-        }
-        is_signed_file_ = true; //success
-      }
-      else {
-        if (lib_.GetLastError() == lib7zip::LIB7ZIP_NEED_PASSWORD) {
-          if (lib_.OpenMultiVolumeArchive(volumes, &archive_, password, true)) {
-            is_signed_file_ = true; //success
-            archive_->GetItemCount(&numItems);
-            archive_->SetRootDir(dirs.c_str());
-          }
-        }
-      }
+    //reuse the archive TestAttributeFlag/ListItems already opened
+    if (!session.IsSame(archive_name)) {
+      session.Open(archive_name, password);
     }
-    else {
-      stream = new Wrapper7zInStream(archive_name, path.ext());
-      if (lib_.OpenArchive(stream, &archive_,true)) {
-        archive_->GetItemCount(&numItems);
-        archive_->SetRootDir(dirs.c_str());
-        if (password.length() > 0) {
-          archive_->SetArchivePassword(password);
-        }
-        is_signed_file_ = true; //success
-      }
-      else {
-        if (lib_.GetLastError() == lib7zip::LIB7ZIP_NEED_PASSWORD) {
-          if (lib_.OpenArchive(stream, &archive_, password, true)) {
-            is_signed_file_ = true; //success
-            archive_->GetItemCount(&numItems);
-            archive_->SetRootDir(dirs.c_str());
-          }
-        }
-      }
+    session.Unlock(password);
+    C7ZipArchive* archive = session.archive();
+    if (!archive) {
+      session.Close();
+      //fail
+      return nullptr;
+    }
+    is_signed_file_ = true; //success
+    return archive;
+  }
+  void Wrapper7zCompress::CollectErrorMsgs(C7ZipArchive* archive) {
+    const std::map <std::wstring,std::wstring> error_msgs = archive->ErrorFileMsg();
+    std::map<std::wstring, std::wstring>::const_iterator it;
+    for (it = error_msgs.begin();it != error_msgs.end();it++) {
+      error_file_msg_[it->first] = lang::LZ77Language::GetInstannce()->GetErrorMsg(it->second);
+    }
+  }
+  bool Wrapper7zCompress::UncompressDirs(ArchiveSession& session,
+    const std::wstring& archive_name,
+    const std::wstring& dirs,
+    const std::wstring& password) {
+    C7ZipArchive* archive = OpenForExtract(session, archive_name, password);
+    if (!archive) {
+      //fail
+      return true;
     }
+    uint32_t numItems = session.item_count();
+    archive->SetRootDir(dirs.c_str());
     bool fail_res = (numItems==-1);
-    std::thread::hardware_concurrency();
-    std::mutex lock;
     C7ZipArchiveItem * archive_item = NULL;
-    archive_->GetItemInfo(0, &archive_item);
+    archive->GetItemInfo(0, &archive_item);
     std::wstring root_dir = dirs + L"\\";
     base::Path::mkpath(root_dir.c_str());
-    if (!archive_->Extract(archive_item, nullptr)) {
+    if (!archive->Extract(archive_item, nullptr)) {
       fail_res = true;
     }
-    const std::map <std::wstring,std::wstring> error_msgs = archive_->ErrorFileMsg();
-    std::map<std::wstring, std::wstring>::const_iterator it;
-    for (it = error_msgs.begin();it != error_msgs.end();it++) {
-      error_file_msg_[it->first] = lang::LZ77Language::GetInstannce()->GetErrorMsg(it->second);
+    CollectErrorMsgs(archive);
+    session.Close();
+    if (!error_file_msg_.empty()) {
+      fail_res = true;
     }
-#ifdef RELEASE_VERSION
-    for (uint32_t i = 0;i < numItems && !fail_res;i++) {
-      C7ZipArchiveItem * archive_item = NULL;
-      if (archive_->GetItemInfo(i, &archive_item)) {
-        const unsigned int index = archive_item->GetArchiveIndex();
-        const std::wstring rpath = archive_item->GetFullPath();
-        const bool is_dir = archive_item->IsDir();
-        std::experimental::filesystem::path out_path(dirs);
-        std::experimental::filesystem::path full_path = out_path / rpath;
-        if (out_path == rpath) {
-          full_path = out_path;
-        }
-        std::wstring xxx = full_path.c_str();
-        if (!is_dir) {
-          if (rpath == kEmptyFileAlias) {
-            xxx = out_path;
-          }
-          Wrapper7zOutStream out(xxx, path.ext());
-          if (!out.IsOpen()) {
-            for (uint32_t try_j = 0;try_j < 2; try_j++) {
-              base::Path::mkpath(xxx.c_str());//FIXME
-              out.Open(xxx, path.ext());
-              if (out.IsOpen()) {
-                break;
-              }
-            }
-            if (!out.IsOpen()) {
-              //fail
-              fail_res = true;
-              break;
-            }
-          }
-          while (!lock.try_lock()) {
-#if defined(OS_WIN)
-            Sleep(0);
-#endif
-          }
-          if (!archive_->Extract(archive_item, &out)) {
-            //fail
-            lock.unlock();
-            error_file_msg_[full_path] = lang::LZ77Language::GetInstannce()->GetErrorMsg(archive_->OpResMsg());
-            continue;
-          }
-          lock.unlock();
-        }
-        else {
-          if (base::Path::mkpath(xxx.c_str())) {//FIXME
-            continue;
-          }
-        }
+    return fail_res;
+  }
+  bool Wrapper7zCompress::IsNestedTar(const std::wstring& archive_name, C7ZipArchive* archive) {
+    unsigned int item_count = 0;
+    C7ZipArchiveItem * archive_item = NULL;
+    if (!archive->GetItemCount(&item_count) || item_count != 1 ||
+      !archive->GetItemInfo(0, &archive_item) || archive_item->IsDir()) {
+      return false;
+    }
+    std::wstring name = archive_name;
+    std::transform(name.begin(), name.end(), name.begin(), towlower);
+    const size_t dot_pos = name.find_last_of(L'.');
+    if (dot_pos == std::wstring::npos) {
+      return false;
+    }
+    const std::wstring ext = name.substr(dot_pos + 1);
+    for (size_t i = 0; kNestedTarExts[i] != nullptr; i++) {
+      if (ext != kNestedTarExts[i]) {
+        continue;
       }
+      if (ext[0] == L't') {
+        return true;
+      }
+      //x.tar.gz,or a gz header that names the tar inside
+      std::wstring item_name = archive_item->GetFullPath();
+      std::transform(item_name.begin(), item_name.end(), item_name.begin(), towlower);
+      const std::wstring stem = name.substr(0, dot_pos);
+      return (stem.size() > 4 && !stem.compare(stem.size() - 4, 4, L".tar")) ||
+        (item_name.size() > 4 && !item_name.compare(item_name.size() - 4, 4, L".tar"));
     }
-#endif
-    if (volumes!=nullptr){
-      delete volumes;
-      volumes = nullptr;
+    return false;
+  }
+  bool Wrapper7zCompress::UncompressNestedTar(ArchiveSession& session,
+    const std::wstring& archive_name,
+    const std::wstring& dirs,
+    const std::wstring& password) {
+    C7ZipArchive* archive = OpenForExtract(session, archive_name, password);
+    if (!archive) {
+      //fail
+      return true;
     }
-    if (stream != nullptr) {
-      delete stream;
-      stream = nullptr;
+    if (!IsNestedTar(archive_name, archive)) {
+      //not a compressed tarball,the session stays open for the plain path
+      return UncompressDirs(session, archive_name, dirs, password);
     }
-    if (archive_!=nullptr){
-      delete archive_;
-      archive_ = nullptr;
+    archive->SetRootDir(dirs.c_str());
+    std::wstring root_dir = dirs + L"\\";
+    base::Path::mkpath(root_dir.c_str());
+    bool fail_res = !archive->ExtractNested(0);
+    CollectErrorMsgs(archive);
+    session.Close();
+    if (!error_file_msg_.empty()) {
+      fail_res = true;
     }
+    return fail_res;
+  }
+  bool Wrapper7zCompress::UncompressItems(ArchiveSession& session,
+    const std::wstring& archive_name,
+    const std::wstring& dirs,
+    const std::wstring& password,
+    const ExtractFilter& filter) {
+    if (filter.IsSelectAll()) {
+      return UncompressDirs(session, archive_name, dirs, password);
+    }
+    C7ZipArchive* archive = OpenForExtract(session, archive_name, password);
+    if (!archive) {
+      //fail
+      return true;
+    }
+    std::vector<unsigned int> indices;
+    if (filter.Resolve(archive, indices)) {
+      session.Close();
+      //fail
+      return true;
+    }
+    archive->SetRootDir(dirs.c_str());
+    std::wstring root_dir = dirs + L"\\";
+    base::Path::mkpath(root_dir.c_str());
+    //one Extract call for the whole selection,not one per item
+    bool fail_res = false;
+    if (!indices.empty() && !archive->ExtractItems(indices)) {
+      fail_res = true;
+    }
+    CollectErrorMsgs(archive);
+    session.Close();
     if (!error_file_msg_.empty()) {
       fail_res = true;
     }
     return fail_res;
   }
-  bool Wrapper7zCompress::TestAttributeFlag(const std::wstring& archive_name) {
+  bool Wrapper7zCompress::UncompressItemToSink(ArchiveSession& session,
+    const std::wstring& archive_name,
+    const std::wstring& password,
+    unsigned int index,
+    C7ZipSink* sink,
+    unsigned int chunk_size) {
+    C7ZipArchive* archive = OpenForExtract(session, archive_name, password);
+    C7ZipArchiveItem * archive_item = NULL;
+    if (!archive || !sink || !archive->GetItemInfo(index, &archive_item)) {
+      //fail
+      return true;
+    }
+    //the session stays open,callers usually stream several items in a row
+    bool fail_res = !archive->Extract(archive_item, sink, chunk_size);
+    CollectErrorMsgs(archive);
+    return fail_res || !error_file_msg_.empty();
+  }
+  bool Wrapper7zCompress::UncompressItemToMemory(ArchiveSession& session,
+    const std::wstring& archive_name,
+    const std::wstring& password,
+    unsigned int index,
+    std::vector<std::uint8_t>& buffer) {
+    buffer.resize(0);
+    C7ZipArchive* archive = OpenForExtract(session, archive_name, password);
+    C7ZipArchiveItem * archive_item = NULL;
+    if (!archive || !archive->GetItemInfo(index, &archive_item)) {
+      //fail
+      return true;
+    }
+    bool fail_res = !archive->Extract(archive_item, buffer);
+    CollectErrorMsgs(archive);
+    return fail_res || !error_file_msg_.empty();
+  }
+  bool Wrapper7zCompress::UncompressBufferToMemory(ArchiveSession& session,
+    const uint8_t* data,
+    size_t size,
+    const std::wstring& ext,
+    const std::wstring& password,
+    std::vector<MemoryEntry>& entries) {
+    entries.resize(0);
+    error_file_msg_.clear();
+    is_password_defined_ = false;
+    if (!data || !size || EnsureLibrary()) {
+      //fail
+      return true;
+    }
+    //an archive of its own,the session keeps the one opened from disk
+    Wrapper7zMemInStream stream(data, size, ext);
+    C7ZipArchive* archive = nullptr;
+    bool opened = false;
+    {
+      OperationStats::ScopedPhase phase(session.stats(), OperationPhase::kHeaderParse);
+      opened = lib_.OpenArchive(&stream, &archive, password, true);
+    }
+    if (!opened) {
+      is_password_defined_ = (lib_.GetLastError() == lib7zip::LIB7ZIP_NEED_PASSWORD);
+      //fail
+      return true;
+    }
+    archive->SetStats(session.stats());
+    if (password.length() > 0) {
+      archive->SetArchivePassword(password);
+    }
+    unsigned int num_items = 0;
+    archive->GetItemCount(&num_items);
+    std::vector<unsigned int> indices(num_items);
+    for (unsigned int i = 0; i < num_items; i++) {
+      indices[i] = i;
+    }
+    //one pass,a solid block is decoded once for all of its items
+    std::vector<std::vector<std::uint8_t> > buffers;
+    std::vector<int> results;
+    const bool fail_res = !archive->ExtractItemsToMemory(indices, buffers, results);
+    entries.resize(num_items);
+    for (unsigned int i = 0; i < num_items; i++) {
+      MemoryEntry& entry = entries[i];
+      C7ZipArchiveItem* archive_item = NULL;
+      entry.mtime = 0;
+      entry.is_dir = false;
+      if (archive->GetItemInfo(i, &archive_item)) {
+        entry.name = archive_item->GetFullPath();
+        entry.is_dir = archive_item->IsDir();
+        unsigned __int64 mtime = 0;
+        if (archive_item->GetFileTimeProperty(lib7zip::kpidMTime, mtime)) {
+          entry.mtime = mtime;
+        }
+      }
+      if (i < buffers.size()) {
+        entry.data.swap(buffers[i]);
+      }
+      entry.is_ok = (i < results.size()) && static_cast<ItemTestStatus>(results[i]) == ItemTestStatus::kOK;
+    }
+    is_password_defined_ = archive->IsPasswordDefined();
+    CollectErrorMsgs(archive);
+    delete archive;
+    return fail_res || !error_file_msg_.empty();
+  }
+  bool Wrapper7zCompress::TestAttributeFlag(ArchiveSession& session, const std::wstring& archive_name) {
     is_password_defined_ = false;
     is_signed_file_ = false;
-    uint32_t numItems = -1;
     base::Path path(archive_name);
     if (!path.IsFile()) {
       return true;
     }
-    Wrapper7zMultiVolumes* volumes = nullptr;
-    Wrapper7zInStream* stream = nullptr;
-    if (Is7zMultiVolumesExt(path.ext())) {
-      volumes = new Wrapper7zMultiVolumes(archive_name);
-      if (lib_.OpenMultiVolumeArchive(volumes, &archive_, true)) {
-        is_signed_file_ = true; //success
-        archive_->GetItemCount(&numItems);
-      }
-    }
-    else {
-      stream = new Wrapper7zInStream(archive_name, path.ext());
-      if (lib_.OpenArchive(stream, &archive_, true)) {
-        is_signed_file_ = true; //success
-        archive_->GetItemCount(&numItems);
+    ArchiveIndexCache index_cache;
+    index_batch_.FlushIfStaged(archive_name);
+    if (!index_cache.Load(archive_name)) {
+      //cache hit,answer without parsing the archive header;an archive an
+      //earlier probe left open is not the one that gets extracted next
+      if (!session.IsSame(archive_name)) {
+        session.Close();
       }
-    }
-    bool success = false;
-    if (archive_&&numItems != -1) {
-      const std::string archive_ext = base::StringConv::narrow(path.ext());
-      for (unsigned int i = 0;i < numItems;i++) {
-        C7ZipArchiveItem * archive_item = NULL;
-        if (!archive_->GetItemInfo(i, &archive_item)) {
-          continue;
-        }
-        archive_item->GetBoolProperty(lib7zip::kpidEncrypted, is_password_defined_);
-        if (is_password_defined_) {
-          if (lib_.GetAskOpenArchivePassword()) {
-            lib_.GetAskOpenArchivePassword()->AskPasswordUI();
-          }
-          break;//fail
-        }
-        bool is_dir = false;
-        archive_item->GetBoolProperty(lib7zip::kpidIsDir, is_dir);
-        if (!is_dir){
-          break;
-        }
-        
+      is_signed_file_ = true;
+      is_password_defined_ = index_cache.IsFirstFileEncrypted();
+      if (is_password_defined_ && lib_.GetAskOpenArchivePassword()) {
+        lib_.GetAskOpenArchivePassword()->AskPasswordUI();
       }
-      success = is_password_defined_;
+      return is_password_defined_ || !error_file_msg_.empty();
     }
-    else {
+    //keep the session open,the extraction that follows reuses it
+    if (EnsureLibrary() || session.Open(archive_name, L"")) {
       //open archive need password
-      if (lib_.GetLastError()==lib7zip::LIB7ZIP_NEED_PASSWORD){
+      if (session.NeedPassword()){
         is_signed_file_ = true; //success
         is_password_defined_ = true;
       }
       //fail
-      success = true;
+      return true;
     }
-    if (volumes != nullptr) {
-      delete volumes;
-      volumes = nullptr;
+    is_signed_file_ = true; //success
+    is_password_defined_ = session.IsFirstFileEncrypted();
+    if (is_password_defined_ && lib_.GetAskOpenArchivePassword()) {
+      lib_.GetAskOpenArchivePassword()->AskPasswordUI();
     }
-    if (stream != nullptr) {
-      delete stream;
-      stream = nullptr;
+    index_batch_.Stage(archive_name, session.archive());
+    return is_password_defined_ || !error_file_msg_.empty();
+  }
+  bool Wrapper7zCompress::ListItems(ArchiveSession& session,
+    const std::wstring& archive_name,
+    const std::wstring& password,
+    std::vector<ArchiveIndexEntry>& entries) {
+    entries.resize(0);
+    ArchiveIndexCache index_cache;
+    index_batch_.FlushIfStaged(archive_name);
+    if (!index_cache.Load(archive_name)) {
+      index_cache.GetEntries(entries);
+      //success
+      return false;
     }
-    if (archive_ != nullptr) {
-      delete archive_;
-      archive_ = nullptr;
+    if (EnsureLibrary()) {
+      //fail
+      return true;
     }
-    if (!error_file_msg_.empty()){
-      success = true;
+    if (!session.IsSame(archive_name)) {
+      session.Open(archive_name, password);
+    }
+    if (session.Unlock(password)) {
+      //fail
+      return true;
     }
-    return success;
+    index_batch_.Stage(archive_name, session.archive());
+    return ArchiveIndexCache::ReadEntries(session.archive(), entries);
+  }
+  bool Wrapper7zCompress::TestArchive(ArchiveSession& session,
+    const std::wstring& archive_name,
+    const std::wstring& password,
+    std::vector<ItemTestResult>& results) {
+    error_file_msg_.clear();
+    //the tester opens one instance per worker,release ours first
+    session.Close();
+    if (EnsureLibrary()) {
+      //fail
+      return true;
+    }
+    ArchiveTester tester(&lib_);
+    bool fail = tester.Run(archive_name, password, 0, results);
+    for (size_t i = 0; i < results.size(); i++) {
+      if (results[i].status != ItemTestStatus::kOK) {
+        error_file_msg_[results[i].path] = lang::LZ77Language::GetInstannce()->GetErrorMsg(
+          ArchiveTester::StatusName(results[i].status));
+      }
+    }
+    if (fail && results.empty()) {
+      error_file_msg_[archive_name] = lang::LZ77Language::GetInstannce()->GetErrorMsg(
+        tester.first_error_msg());
+    }
+    return fail || !error_file_msg_.empty();
+  }
+  void Wrapper7zCompress::FlushIndexCache() {
+    index_batch_.Flush();
   }
   const std::wstring& Wrapper7zCompress::OpResMsg() {
     return base::StringConv::GetMapW(error_file_msg_);
   }
-  bool Wrapper7zCompress::Is7zMultiVolumesExt(const std::wstring& ext) {
-    return (wcsncmp(ext.c_str(), k7zFmtMulVolume, 
-      sizeof(k7zFmtMulVolume) - sizeof(wchar_t)) == 0);
-  }
 }
\ No newline at end of file
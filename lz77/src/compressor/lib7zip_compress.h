@@ -5,27 +5,73 @@
 #include "base/basic_incls.h"
 #include "compressor/lib7zip_wrapper.h"
 #include "lib7zip/Lib7ZIP/AskOpenArchivePassword.h"
+#include "compressor/archive_index_cache.h"
+#include "compressor/archive_session.h"
+#include "compressor/extract_filter.h"
+#include "compressor/archive_tester.h"
+#include "compressor/memory_archive.h"
 #include <map>
+#include <mutex>
 #include <string>
 
 
 namespace compressor {
 
-  static const wchar_t k7zFmtMulVolume[] = L".001";
-
   static const char * const kNoOpenAsExtensions =
     " 7z arj bz2 cab chm cpio flv gz lha lzh lzma rar swm tar tbz2 tgz wim xar xz z zip ";
 
+  //single-stream formats that can wrap a tar,the t* ones always do
+  static const wchar_t *kNestedTarExts[] = { L"gz", L"bz2", L"xz", L"tgz", L"tbz", L"tbz2", L"txz", nullptr };
+
   class Wrapper7zCompress
   {
   public:
     Wrapper7zCompress();
     virtual ~Wrapper7zCompress();
     bool Init(AskOpenArchivePassword* ask_open_password);
-    bool UncompressDirs(const std::wstring& archive_name, 
+    //every archive call works on the caller's session,which owns the open
+    //archive between the probe,the listing and the extraction
+    bool UncompressDirs(ArchiveSession& session,
+      const std::wstring& archive_name,
+      const std::wstring& dirs,
+      const std::wstring& password);
+    bool UncompressNestedTar(ArchiveSession& session,
+      const std::wstring& archive_name,
       const std::wstring& dirs,
       const std::wstring& password);
-    bool TestAttributeFlag(const std::wstring& archive_name);
+    bool UncompressItems(ArchiveSession& session,
+      const std::wstring& archive_name,
+      const std::wstring& dirs,
+      const std::wstring& password,
+      const ExtractFilter& filter);
+    bool UncompressItemToSink(ArchiveSession& session,
+      const std::wstring& archive_name,
+      const std::wstring& password,
+      unsigned int index,
+      C7ZipSink* sink,
+      unsigned int chunk_size);
+    bool UncompressItemToMemory(ArchiveSession& session,
+      const std::wstring& archive_name,
+      const std::wstring& password,
+      unsigned int index,
+      std::vector<std::uint8_t>& buffer);
+    bool UncompressBufferToMemory(ArchiveSession& session,
+      const uint8_t* data,
+      size_t size,
+      const std::wstring& ext,
+      const std::wstring& password,
+      std::vector<MemoryEntry>& entries);
+    bool TestAttributeFlag(ArchiveSession& session, const std::wstring& archive_name);
+    bool ListItems(ArchiveSession& session,
+      const std::wstring& archive_name,
+      const std::wstring& password,
+      std::vector<ArchiveIndexEntry>& entries);
+    bool TestArchive(ArchiveSession& session,
+      const std::wstring& archive_name,
+      const std::wstring& password,
+      std::vector<ItemTestResult>& results);
+    //writes the listings that missed the cache so far
+    void FlushIndexCache();
     const std::wstring& OpResMsg();
     const WStringArray& exts() const {
       return exts_;
@@ -36,14 +82,22 @@ namespace compressor {
     bool IsSignedFile() const {
       return is_signed_file_;
     }
-    C7ZipArchive* GetArchive() {
-      return archive_;
+    C7ZipLibrary* lib() {
+      return &lib_;
     }
   private:
-    bool Is7zMultiVolumesExt(const std::wstring& ext);
-    C7ZipArchive* archive_;
+    //loads the handlers on the first archive operation,not in Init
+    bool EnsureLibrary();
+    C7ZipArchive* OpenForExtract(ArchiveSession& session,
+      const std::wstring& archive_name,
+      const std::wstring& password);
+    void CollectErrorMsgs(C7ZipArchive* archive);
+    static bool IsNestedTar(const std::wstring& archive_name, C7ZipArchive* archive);
     WStringArray exts_;
     C7ZipLibrary lib_;
+    std::mutex lib_lock_;
+    bool is_lib_ready_;
+    ArchiveIndexBatch index_batch_;
     bool is_password_defined_;
     bool is_signed_file_;
     std::map<std::wstring, std::wstring> error_file_msg_;
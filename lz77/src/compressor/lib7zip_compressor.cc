@@ -4,11 +4,14 @@
 #include "base/path.h"
 #include "base/string_conv.h"
 #include "compressor/lib7zip_compress.h"
-#include "bit7z/include/bit7zlibrary.hpp"
-#include "bit7z/include/bitextractor.hpp"
+#include "compressor/archive_session.h"
+#include "compressor/format_registry.h"
+#include "compressor/concurrency.h"
+#include "compressor/iso_extractor.h"
 
 #if defined(OS_WIN)
 #include "compressor/win/lib7z_achive.h"
+#include "compressor/win/disc_image_writer.h"
 #endif // !OS_WIN
 
 namespace compressor {
@@ -27,31 +30,28 @@ namespace compressor {
       return ext_name;
     }
   }
+  void ArchiveCompressor::SetConcurrency(unsigned int num_threads) {
+    Concurrency::SetThreads(num_threads);
+  }
   ArchiveCompressor::ArchiveCompressor(AskOpenArchivePassword* ask_open_password):is_password_defined_(false){
-    exts_.resize(0);
     archive_compress_ext_.resize(0);
     is_signed_file_ = false;
     archive_compress_ext_ = L"7z";
-    if (lib_7zip_compress.Init(ask_open_password)) {
-      //fail
-      return;
-    }
-    exts_ = lib_7zip_compress.exts();
+    lib_7zip_compress.Init(ask_open_password);
+    session_ = new ArchiveSession(lib_7zip_compress.lib());
   }
   ArchiveCompressor::~ArchiveCompressor() {
+    lib_7zip_compress.FlushIndexCache();
+    if (session_ != nullptr) {
+      delete session_;
+      session_ = nullptr;
+    }
     is_password_defined_ = false;
-    exts_.resize(0);
     archive_compress_ext_.resize(0);
   }
   bool ArchiveCompressor::IsSupportedExt(const std::wstring& ext) {
-    WStringArray::iterator it;
-    for (it = exts_.begin(); it != exts_.end(); it++) {
-      if (ext == *it) {
-        //success
-        return false;
-      }
-    }
-    return true;
+    //answered without touching the 7z library
+    return !FormatRegistry::HasExt(ext);
   }
   bool ArchiveCompressor::IsSupportedARCExt(const std::wstring& ext) {
     for (size_t i = 0; kCompressArchiveTable[i] != nullptr; i++){
@@ -82,7 +82,7 @@ namespace compressor {
     return false;
   }
   bool ArchiveCompressor::TestAttributeFlag(const std::wstring& archive_name) {
-    bool fail = lib_7zip_compress.TestAttributeFlag(archive_name);
+    bool fail = lib_7zip_compress.TestAttributeFlag(*session_, archive_name);
     is_signed_file_ = lib_7zip_compress.IsSignedFile();
     if (fail) {
       //fail
@@ -91,32 +91,200 @@ namespace compressor {
     }
     return false;
   }
+  bool ArchiveCompressor::ListArchive(const std::wstring& archive_name,
+    const std::wstring& password,
+    std::vector<ArchiveIndexEntry>& entries) {
+    return lib_7zip_compress.ListItems(*session_, archive_name, password, entries);
+  }
+  void ArchiveCompressor::BeginStats() {
+    stats_.Reset();
+    session_->SetStats(&stats_);
+  }
+  void ArchiveCompressor::EndStats() {
+    //final snapshot,so the observer always sees the totals
+    stats_.Notify(true);
+    session_->SetStats(nullptr);
+  }
   void ArchiveCompressor::decompressor(const std::wstring& archive_name, 
     const std::wstring& dirs,
     const std::wstring& password) {
     op_res_msg_.resize(0);
-    if (lib_7zip_compress.UncompressDirs(archive_name,dirs,password)){
+    BeginStats();
+    const bool fail = lib_7zip_compress.UncompressDirs(*session_, archive_name,dirs,password);
+    EndStats();
+    if (fail) {
       //fail
       op_res_msg_ = lib_7zip_compress.OpResMsg();
       return;
     }
     return;
   }
+  void ArchiveCompressor::ExtractNestedTar(const std::wstring& archive_name,
+    const std::wstring& dirs,
+    const std::wstring& password) {
+    op_res_msg_.resize(0);
+    BeginStats();
+    //.tar.gz/.tar.xz/.tar.bz2 straight to the tar contents,other archives as decompressor()
+    const bool fail = lib_7zip_compress.UncompressNestedTar(*session_, archive_name, dirs, password);
+    EndStats();
+    if (fail) {
+      //fail
+      op_res_msg_ = lib_7zip_compress.OpResMsg();
+      return;
+    }
+    return;
+  }
+  void ArchiveCompressor::ExtractSelected(const std::wstring& archive_name,
+    const std::wstring& dirs,
+    const std::wstring& password,
+    const ExtractFilter& filter) {
+    op_res_msg_.resize(0);
+    BeginStats();
+    const bool fail = lib_7zip_compress.UncompressItems(*session_, archive_name, dirs, password, filter);
+    EndStats();
+    if (fail) {
+      //fail
+      op_res_msg_ = lib_7zip_compress.OpResMsg();
+      return;
+    }
+    return;
+  }
+  bool ArchiveCompressor::ExtractToSink(const std::wstring& archive_name,
+    const std::wstring& password,
+    unsigned int index,
+    C7ZipSink* sink,
+    unsigned int chunk_size) {
+    op_res_msg_.resize(0);
+    BeginStats();
+    const bool fail = lib_7zip_compress.UncompressItemToSink(*session_, archive_name, password, index, sink, chunk_size);
+    EndStats();
+    if (fail) {
+      //fail
+      op_res_msg_ = lib_7zip_compress.OpResMsg();
+      return true;
+    }
+    return false;
+  }
+  bool ArchiveCompressor::ExtractToMemory(const std::wstring& archive_name,
+    const std::wstring& password,
+    unsigned int index,
+    std::vector<std::uint8_t>& buffer) {
+    op_res_msg_.resize(0);
+    BeginStats();
+    const bool fail = lib_7zip_compress.UncompressItemToMemory(*session_, archive_name, password, index, buffer);
+    EndStats();
+    if (fail) {
+      //fail
+      op_res_msg_ = lib_7zip_compress.OpResMsg();
+      return true;
+    }
+    return false;
+  }
+  bool ArchiveCompressor::ExtractFromMemory(const std::uint8_t* archive,
+    size_t size,
+    const std::wstring& ext,
+    const std::wstring& password,
+    std::vector<MemoryEntry>& entries) {
+    op_res_msg_.resize(0);
+    BeginStats();
+    const bool fail = lib_7zip_compress.UncompressBufferToMemory(*session_, archive, size, ext, password, entries);
+    EndStats();
+    is_password_defined_ = lib_7zip_compress.IsPasswordDefined();
+    if (fail) {
+      //fail
+      op_res_msg_ = lib_7zip_compress.OpResMsg();
+      return true;
+    }
+    return false;
+  }
+  bool ArchiveCompressor::TestArchive(const std::wstring& archive_name,
+    const std::wstring& password,
+    std::vector<ItemTestResult>& results) {
+    op_res_msg_.resize(0);
+    if (lib_7zip_compress.TestArchive(*session_, archive_name, password, results)) {
+      //fail
+      op_res_msg_ = lib_7zip_compress.OpResMsg();
+      return true;
+    }
+    return false;
+  }
   bool ArchiveCompressor::ExtractingExceptionsISO(const std::wstring archive_name,
     const std::wstring& dir) {
-    bit7z::Bit7zLibrary lib(L"");
-    bit7z::BitExtractor extractor(lib, bit7z::BitFormat::Iso);
-    extractor.extract(archive_name, dir);
-    return false;
+    op_res_msg_.resize(0);
+    BeginStats();
+    bool fail = false;
+    if (IsoExtractor::Probe(archive_name) == IsoVolumeKind::kIso9660) {
+      //plain ISO 9660/Rock Ridge:streamed by libarchive
+      IsoExtractor extractor;
+      extractor.SetStats(&stats_);
+      fail = extractor.Extract(archive_name, dir);
+      if (fail) {
+        op_res_msg_ = base::StringConv::GetMapW(extractor.errors());
+      }
+    }
+    else {
+      //Joliet and UDF names only the 7-Zip Iso/Udf handlers read
+      fail = lib_7zip_compress.UncompressDirs(*session_, archive_name, dir, L"");
+      if (fail) {
+        op_res_msg_ = lib_7zip_compress.OpResMsg();
+      }
+    }
+    EndStats();
+    return fail;
   }
 
   void ArchiveCompressor::compressor(const std::vector<std::wstring>& dirs,
     const std::wstring& archive,
     const std::wstring& password) {
+    //handler defaults for the level,every core for the encoder
+    compressor(dirs, archive, password, CompressionProfile());
+  }
+  void ArchiveCompressor::compressor(const std::vector<std::wstring>& dirs,
+    const std::wstring& archive,
+    const std::wstring& password,
+    const CompressionProfile& profile,
+    ArchiveUpdateMode update_mode) {
     is_compress_ok_ = false;
-    Wrapper7zArchive archivexxx(dirs, archive, archive_compress_ext_, (password.size()>0)? password.c_str():nullptr);
+    op_res_msg_.resize(0);
+    stats_.Reset();
+    Wrapper7zArchive archivexxx(dirs, archive, archive_compress_ext_, (password.size()>0)? password.c_str():nullptr,
+      profile, update_mode, &stats_);
+    stats_.Notify(true);
     assert(archivexxx.archive_error() == Wrapper7zArchive::ArchiveErrorTable::kOK);
     is_compress_ok_ = (archivexxx.archive_error() == Wrapper7zArchive::ArchiveErrorTable::kOK);
+    if (!archivexxx.errors().empty()) {
+      //folders that could not be listed are missing even from a good archive
+      op_res_msg_ = base::StringConv::GetMapW(archivexxx.errors());
+    }
+  }
+  bool ArchiveCompressor::CompressToMemory(const std::vector<MemoryItem>& items,
+    const std::wstring& password,
+    const CompressionProfile& profile,
+    std::vector<std::uint8_t>& archive) {
+    is_compress_ok_ = false;
+    stats_.Reset();
+    Wrapper7zArchive archivexxx(items, archive, archive_compress_ext_, (password.size()>0)? password.c_str():nullptr,
+      profile, &stats_);
+    stats_.Notify(true);
+    //a failed UpdateItems leaves the buffer empty
+    is_compress_ok_ = (archivexxx.archive_error() == Wrapper7zArchive::ArchiveErrorTable::kOK) && !archive.empty();
+    return !is_compress_ok_;
+  }
+  bool ArchiveCompressor::CreateImage(const std::wstring& dir,
+    const std::wstring& image_name,
+    const DiscImageOptions& options) {
+    op_res_msg_.resize(0);
+    BeginStats();
+    DiscImageWriter writer(options);
+    writer.SetStats(&stats_);
+    const bool fail = writer.Write(dir, image_name);
+    EndStats();
+    if (fail) {
+      //fail
+      op_res_msg_ = base::StringConv::GetMapW(writer.errors());
+      return true;
+    }
+    return false;
   }
   bool ArchiveCompressor::IsCompressOK() const {
     return is_compress_ok_;
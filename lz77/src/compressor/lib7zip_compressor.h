@@ -4,10 +4,20 @@
 #include "compressor/vftable.h"
 #include "lib7zip/Lib7Zip/AskOpenArchivePassword.h"
 #include "compressor/compressor_exports.h"
+#include "compressor/archive_index_cache.h"
+#include "compressor/extract_filter.h"
+#include "compressor/operation_stats.h"
+#include "compressor/archive_tester.h"
+#include "compressor/compression_profile.h"
+#include "compressor/archive_update.h"
+#include "compressor/memory_archive.h"
+#include "compressor/disc_image_options.h"
 
 
 namespace compressor {
 
+  class ArchiveSession;
+
   static const char * const kExtractExludeExtensions =
     " 3gp"
     " aac ans ape asc asm asp aspx avi awk"
@@ -33,7 +43,8 @@ namespace compressor {
     " ";
 
   static const wchar_t *kDoNeedExtractArcName[] = { L"zip", L"tar", L"wim", L"7z", nullptr};
-  static const wchar_t *kCompressArchiveTable[] = { L"zip",L"bzip2",L"gzip",L"tar",L"wim",L"xz",L"7z",nullptr };
+  static const wchar_t *kCompressArchiveTable[] = { L"zip",L"bzip2",L"gzip",L"tar",L"wim",L"xz",L"7z",
+    L"tar.gz",L"tar.xz",L"tar.bz2",nullptr };
   static const wchar_t *kCryptARC[] = { L"zip", L"7z", nullptr };
   static const wchar_t* kExtNameISO = L"iso";
 
@@ -42,6 +53,8 @@ namespace compressor {
   {
   public:
     COMPRESSOR_EXPORT static const wchar_t* ToFixOutExt(const wchar_t* ext_name);
+    //threads for every coder in the process,0 means every core
+    COMPRESSOR_EXPORT static void SetConcurrency(unsigned int num_threads);
     COMPRESSOR_EXPORT explicit ArchiveCompressor(AskOpenArchivePassword* ask_open_password);
     COMPRESSOR_EXPORT virtual ~ArchiveCompressor();
     COMPRESSOR_EXPORT bool IsSupportedExt(const std::wstring& ext);
@@ -49,14 +62,58 @@ namespace compressor {
     COMPRESSOR_EXPORT bool IsSupportedCryptARC(const std::wstring& ext);
     COMPRESSOR_EXPORT bool IsDoNeedExtractArcName(const std::wstring& ext);
     COMPRESSOR_EXPORT bool TestAttributeFlag(const std::wstring& archive_name);
+    COMPRESSOR_EXPORT bool ListArchive(const std::wstring& archive_name,
+      const std::wstring& password,
+      std::vector<ArchiveIndexEntry>& entries);
+    COMPRESSOR_EXPORT bool TestArchive(const std::wstring& archive_name,
+      const std::wstring& password,
+      std::vector<ItemTestResult>& results);
     COMPRESSOR_EXPORT bool ExtractingExceptionsISO(const std::wstring archive_name,
       const std::wstring& dir);
     COMPRESSOR_EXPORT virtual void decompressor(const std::wstring& archive_name, 
       const std::wstring& dirs, 
       const std::wstring& password);
+    COMPRESSOR_EXPORT void ExtractNestedTar(const std::wstring& archive_name,
+      const std::wstring& dirs,
+      const std::wstring& password);
+    COMPRESSOR_EXPORT void ExtractSelected(const std::wstring& archive_name,
+      const std::wstring& dirs,
+      const std::wstring& password,
+      const ExtractFilter& filter);
+    COMPRESSOR_EXPORT bool ExtractToSink(const std::wstring& archive_name,
+      const std::wstring& password,
+      unsigned int index,
+      C7ZipSink* sink,
+      unsigned int chunk_size);
+    COMPRESSOR_EXPORT bool ExtractToMemory(const std::wstring& archive_name,
+      const std::wstring& password,
+      unsigned int index,
+      std::vector<std::uint8_t>& buffer);
+    //unpacks every item of an archive held in memory,ext is a hint,
+    //the format is also detected by signature
+    COMPRESSOR_EXPORT bool ExtractFromMemory(const std::uint8_t* archive,
+      size_t size,
+      const std::wstring& ext,
+      const std::wstring& password,
+      std::vector<MemoryEntry>& entries);
     COMPRESSOR_EXPORT virtual void compressor(const std::vector<std::wstring>& dirs,
       const std::wstring& archive,
       const std::wstring& password);
+    //paths left out of the archive (unreadable folders or files) in OpResMsg()
+    COMPRESSOR_EXPORT void compressor(const std::vector<std::wstring>& dirs,
+      const std::wstring& archive,
+      const std::wstring& password,
+      const CompressionProfile& profile,
+      ArchiveUpdateMode update_mode = ArchiveUpdateMode::kCreate);
+    //builds an archive of the IsSupportedARCExt format in archive,no temp files
+    COMPRESSOR_EXPORT bool CompressToMemory(const std::vector<MemoryItem>& items,
+      const std::wstring& password,
+      const CompressionProfile& profile,
+      std::vector<std::uint8_t>& archive);
+    //ISO 9660/Joliet/UDF image of the contents of dir,OpResMsg() on failure
+    COMPRESSOR_EXPORT bool CreateImage(const std::wstring& dir,
+      const std::wstring& image_name,
+      const DiscImageOptions& options = DiscImageOptions());
     COMPRESSOR_EXPORT const std::wstring& OpResMsg() const {
       return op_res_msg_;
     }
@@ -70,8 +127,21 @@ namespace compressor {
       return is_signed_file_;
     }
     COMPRESSOR_EXPORT bool IsCompressOK() const;
+    COMPRESSOR_EXPORT void SetObserver(OperationObserver* observer) {
+      stats_.SetObserver(observer);
+    }
+    COMPRESSOR_EXPORT std::wstring StatsJson() {
+      return stats_.ToJson();
+    }
+    COMPRESSOR_EXPORT OperationSnapshot StatsSnapshot() {
+      return stats_.Snapshot();
+    }
   private:
-    std::vector<std::wstring> exts_;
+    void BeginStats();
+    void EndStats();
+    OperationStats stats_;
+    //the archive the last probe or listing opened,closed with this object
+    ArchiveSession* session_;
     std::wstring archive_compress_ext_;
     std::wstring op_res_msg_;
     bool is_password_defined_;
@@ -3,7 +3,13 @@
 
 #include "lib7zip/Lib7Zip/lib7zip.h"
 #include "base/string_conv.h"
+#include "compressor/sparse_file.h"
 #include <mutex>
+#include <cstring>
+
+#if defined(OS_WIN)
+#include <io.h>
+#endif
 
 namespace compressor {
 
@@ -113,6 +119,71 @@ namespace compressor {
     }
   };
 
+  //reads an archive held by the caller in place,no copy is made
+  class Wrapper7zMemInStream : public C7ZipInStream
+  {
+  private:
+    const uint8_t* m_pData;
+    uint64_t m_nSize;
+    uint64_t m_nPos;
+    wstring m_strFileExt;
+  public:
+    Wrapper7zMemInStream(const uint8_t* data, uint64_t size, const std::wstring& ext) :
+      m_pData(data),
+      m_nSize(size),
+      m_nPos(0),
+      m_strFileExt(ext)
+    {
+    }
+
+    virtual ~Wrapper7zMemInStream()
+    {
+    }
+
+  public:
+    virtual wstring GetExt() const
+    {
+      return m_strFileExt;
+    }
+
+    virtual int Read(void *data, unsigned int size, unsigned int *processedSize)
+    {
+      const uint64_t remain = m_nPos < m_nSize ? m_nSize - m_nPos : 0;
+      const unsigned int count = (unsigned int)(remain < size ? remain : size);
+      if (count > 0) {
+        memcpy(data, m_pData + m_nPos, count);
+        m_nPos += count;
+      }
+      if (processedSize != NULL)
+        *processedSize = count;
+      return 0;
+    }
+
+    virtual int Seek(__int64 offset, unsigned int seekOrigin, unsigned __int64 *newPosition)
+    {
+      __int64 base = 0;
+      switch (seekOrigin) {
+      case SEEK_SET: base = 0; break;
+      case SEEK_CUR: base = (__int64)m_nPos; break;
+      case SEEK_END: base = (__int64)m_nSize; break;
+      default: return 1;
+      }
+      if (base + offset < 0)
+        return 1;
+      m_nPos = (uint64_t)(base + offset);
+      if (newPosition)
+        *newPosition = m_nPos;
+      return 0;
+    }
+
+    virtual int GetSize(unsigned __int64 * size)
+    {
+      if (size)
+        *size = m_nSize;
+      return 0;
+    }
+  };
+
   class Wrapper7zOutStream : public C7ZipOutStream
   {
   private:
@@ -120,9 +191,18 @@ namespace compressor {
     std::wstring m_strFileName;
     wstring m_strFileExt;
     uint64_t m_nFileSize;
+    SparseFileWriter writer_;
 #if defined(COMPRESSOR_MULTI_THREAD)
     std::mutex* wlock_;
 #endif
+    void* NativeFile() const {
+#if defined(OS_WIN)
+      //the FILE* is only used to open and close,writes go to the handle
+      return reinterpret_cast<void*>(_get_osfhandle(_fileno(m_pFile)));
+#else
+      return m_pFile;
+#endif
+    }
   public:
     Wrapper7zOutStream(std::wstring fileName, const std::wstring& ext) :
       m_strFileName(fileName),
@@ -136,6 +216,7 @@ namespace compressor {
 
     void Open(std::wstring fileName, const std::wstring& ext) {
       if (IsOpen()) {
+        writer_.Finish();
         fflush(m_pFile);
         fclose(m_pFile);
         m_pFile = nullptr;
@@ -156,16 +237,44 @@ namespace compressor {
         if (pos != fileName.npos) {
           m_strFileExt = m_strFileName.substr(pos + 1);
         }
+        writer_.Attach(NativeFile());
+      }
+      else {
+        writer_.Attach(nullptr);
       }
     }
 
     virtual ~Wrapper7zOutStream()
     {
-      if (IsOpen()) {
-        fclose(m_pFile);
-        m_pFile = nullptr;
+      Close();
+    }
+
+    //flushes the data,the file stays open for its times;fail return true
+    bool Finish() {
+      if (!IsOpen()) {
+        return false;
       }
-        
+      const bool fail = writer_.Finish();
+      return (fflush(m_pFile) != 0) || fail;
+    }
+
+    //fail return true
+    bool Close() {
+      if (!IsOpen()) {
+        return false;
+      }
+      bool fail = writer_.Finish();
+      fail = (fclose(m_pFile) != 0) || fail;
+      m_pFile = nullptr;
+      return fail;
+    }
+
+    void* native_file() const {
+      return IsOpen() ? NativeFile() : nullptr;
+    }
+
+    const std::wstring& file_name() const {
+      return m_strFileName;
     }
 
   public:
@@ -176,19 +285,15 @@ namespace compressor {
 
     virtual int Write(const void *data, unsigned int size, unsigned int *processedSize)
     {
-      int count = fwrite(data, 1, size, m_pFile);
-      //wprintf(L"Write:%d %d\n", size, count);
-
-      if (count >= 0)
-      {
-        //fflush(m_pFile);
-        if (processedSize != NULL)
-          *processedSize = count;
-
-        m_nFileSize += count;
-        return 0;
-      }
-      return 1;
+      if (processedSize != NULL)
+        *processedSize = 0;
+      //zero runs of large files become holes
+      if (writer_.Write(data, size))
+        return 1;
+      if (processedSize != NULL)
+        *processedSize = size;
+      m_nFileSize += size;
+      return 0;
     }
 
     virtual int Seek(__int64 offset, unsigned int seekOrigin, unsigned __int64 *newPosition)
@@ -197,8 +302,10 @@ namespace compressor {
 
       if (!result)
       {
+        const unsigned __int64 pos = _ftelli64(m_pFile);
+        writer_.SetPosition(pos);
         if (newPosition)
-          *newPosition = _ftelli64(m_pFile);
+          *newPosition = pos;
         return 0;
       }
       return result;
@@ -206,7 +313,8 @@ namespace compressor {
 
     virtual int SetSize(unsigned __int64 size)
     {
-      //wprintf(L"SetFileSize:%ld\n", size);
+      //known item size:reserve it instead of growing by appends
+      writer_.Preallocate(size);
       return 0;
     }
   };
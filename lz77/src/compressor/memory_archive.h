@@ -0,0 +1,33 @@
+#ifndef COMPRESSOR_MEMORY_ARCHIVE_H_
+#define COMPRESSOR_MEMORY_ARCHIVE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace compressor {
+
+  //An item to archive straight from memory. The bytes are read in place,
+  //they stay owned by the caller and must outlive the call.
+  struct MemoryItem
+  {
+    std::wstring name; //path inside the archive
+    const uint8_t* data;
+    size_t size;
+    uint64_t mtime; //FILETIME ticks,0 takes the current time
+    bool is_dir;
+  };
+
+  //An item unpacked from an archive held in memory.
+  struct MemoryEntry
+  {
+    std::wstring name;
+    std::vector<uint8_t> data;
+    uint64_t mtime; //FILETIME ticks,0 when the archive has none
+    bool is_dir;
+    bool is_ok; //false on a CRC/data error,data then holds what was decoded
+  };
+
+}
+
+#endif // !COMPRESSOR_MEMORY_ARCHIVE_H_
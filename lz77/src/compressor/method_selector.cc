@@ -0,0 +1,97 @@
+#include "compressor/method_selector.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include "compressor/item_order.h"
+
+namespace compressor {
+
+  MethodSelector::MethodSelector() {
+  }
+  MethodSelector::~MethodSelector() {
+  }
+  bool MethodSelector::IsSelective(const std::wstring& ext) {
+    for (size_t i = 0; kSelectiveMethodArchiveTable[i] != nullptr; i++) {
+      if (ext == kSelectiveMethodArchiveTable[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool MethodSelector::IsStoredExt(const std::wstring& ext) {
+    for (size_t i = 0; kStoredExtensionTable[i] != nullptr; i++) {
+      if (ext == kStoredExtensionTable[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+  bool MethodSelector::ProbeEntropy(const std::wstring& path, double& entropy) {
+#if defined(OS_WIN)
+    FILE* file = _wfopen(path.c_str(), L"rb");
+#else
+    FILE* file = fopen(std::string(path.begin(), path.end()).c_str(), "rb");
+#endif
+    if (!file) {
+      //fail
+      return true;
+    }
+    std::vector<uint8_t> buffer(kEntropyProbeSize);
+    const size_t count = fread(&buffer[0], 1, buffer.size(), file);
+    fclose(file);
+    if (count == 0) {
+      //fail
+      return true;
+    }
+    uint32_t histogram[256] = { 0 };
+    for (size_t i = 0; i < count; i++) {
+      histogram[buffer[i]]++;
+    }
+    entropy = 0;
+    for (size_t i = 0; i < 256; i++) {
+      if (histogram[i]) {
+        const double p = (double)histogram[i] / count;
+        entropy -= p * std::log2(p);
+      }
+    }
+    return false;
+  }
+  size_t MethodSelector::Select(const ItemTable& items, std::vector<uint8_t>& stored) {
+    stored.assign(items.size(), 0);
+    std::vector<uint32_t> probes;
+    for (uint32_t i = 0; i < items.size(); i++) {
+      if (items.IsDir(i) || items.Size(i) == 0) {
+        continue;
+      }
+      if (IsStoredExt(ItemOrderer::ExtOf(items.NameData(i), items.NameLength(i)))) {
+        stored[i] = 1;
+      }
+      else if (items.Size(i) >= kEntropyProbeMinSize) {
+        probes.push_back(i);
+      }
+    }
+    std::atomic<size_t> next(0);
+    auto probe_worker = [&]() {
+      for (size_t i = next++; i < probes.size(); i = next++) {
+        double entropy = 0;
+        if (!ProbeEntropy(items.DiskPath(probes[i]), entropy) && entropy >= kIncompressibleEntropy) {
+          stored[probes[i]] = 1;
+        }
+      }
+    };
+    const unsigned int num_threads = (std::max)(1u,
+      (std::min)(std::thread::hardware_concurrency(), static_cast<unsigned int>(probes.size())));
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < num_threads; i++) {
+      threads.push_back(std::thread(probe_worker));
+    }
+    probe_worker();
+    for (size_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+    return std::count(stored.begin(), stored.end(), 1);
+  }
+
+}
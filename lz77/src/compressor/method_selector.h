@@ -0,0 +1,47 @@
+#ifndef COMPRESSOR_METHOD_SELECTOR_H_
+#define COMPRESSOR_METHOD_SELECTOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "compressor/item_table.h"
+
+namespace compressor {
+
+  //formats that can hold stored and compressed items side by side
+  static const wchar_t *kSelectiveMethodArchiveTable[] = { L"7z", L"zip", nullptr };
+  //already compressed content,stored without probing. kExtractExludeExtensions
+  //mixes text formats in,so it can not be used here
+  static const wchar_t *kStoredExtensionTable[] = {
+    L"7z", L"zip", L"rar", L"gz", L"tgz", L"bz2", L"tbz2", L"xz", L"txz", L"lz4", L"zst", L"cab", L"lzma",
+    L"jar", L"apk", L"docx", L"xlsx", L"pptx", L"odt", L"ods", L"odp", L"epub",
+    L"jpg", L"jpeg", L"png", L"gif", L"webp", L"heic", L"jp2",
+    L"mp3", L"m4a", L"aac", L"ogg", L"opus", L"flac", L"ape", L"wma",
+    L"mp4", L"m4v", L"mkv", L"webm", L"avi", L"mov", L"wmv", L"3gp", L"flv",
+    L"pdf",
+    nullptr };
+  //smaller files go to the configured method,their histogram says little
+  static const uint64_t kEntropyProbeMinSize = 16 * 1024;
+  static const size_t kEntropyProbeSize = 64 * 1024;
+  //bits per byte,compressed or encrypted data sits just under 8
+  static const double kIncompressibleEntropy = 7.9;
+
+  //Picks the files not worth compressing:a known media/archive extension,
+  //or an order-0 entropy of the first block close to 8 bits per byte.
+  //Probes run in parallel;an unreadable file is left to the configured method.
+  class MethodSelector
+  {
+  public:
+    MethodSelector();
+    virtual ~MethodSelector();
+    //stored[i] is 1 for the rows to store,returns how many
+    size_t Select(const ItemTable& items, std::vector<uint8_t>& stored);
+    static bool IsSelective(const std::wstring& ext);
+    static bool IsStoredExt(const std::wstring& ext);
+  private:
+    static bool ProbeEntropy(const std::wstring& path, double& entropy);
+  };
+
+}
+
+#endif // !COMPRESSOR_METHOD_SELECTOR_H_
@@ -0,0 +1,123 @@
+#include "compressor/operation_stats.h"
+#include <cwchar>
+
+namespace compressor {
+
+  static const double kBytesPerMB = 1024.0 * 1024.0;
+
+  OperationStats::OperationStats() {
+    observer_ = nullptr;
+    Reset();
+  }
+  OperationStats::~OperationStats() {
+    observer_ = nullptr;
+  }
+  void OperationStats::Reset() {
+    total_bytes_ = 0;
+    bytes_in_ = 0;
+    bytes_out_ = 0;
+    items_total_ = 0;
+    items_done_ = 0;
+    for (int i = 0; i < static_cast<int>(OperationPhase::kCount); i++) {
+      phase_ns_[i] = 0;
+    }
+    std::lock_guard<std::mutex> lock(sample_lock_);
+    start_time_ = std::chrono::steady_clock::now();
+    sample_time_ = start_time_;
+    notify_time_ = start_time_;
+    sample_bytes_ = 0;
+    instant_mbps_ = 0.0;
+  }
+  void OperationStats::SetTotal(uint64_t total_bytes) {
+    total_bytes_ = total_bytes;
+  }
+  void OperationStats::SetItemsTotal(uint64_t items_total) {
+    items_total_ = items_total;
+  }
+  void OperationStats::SetCompleted(uint64_t bytes_in) {
+    bytes_in_ = bytes_in;
+    Notify(false);
+  }
+  void OperationStats::AddBytesOut(uint64_t bytes) {
+    bytes_out_ += bytes;
+  }
+  void OperationStats::SetBytesOut(uint64_t bytes) {
+    bytes_out_ = bytes;
+  }
+  void OperationStats::AddItem() {
+    items_done_++;
+  }
+  void OperationStats::AddPhaseTime(OperationPhase phase, uint64_t ns) {
+    phase_ns_[static_cast<int>(phase)] += ns;
+  }
+  OperationSnapshot OperationStats::Snapshot() {
+    OperationSnapshot snapshot;
+    snapshot.total_bytes = total_bytes_;
+    snapshot.bytes_in = bytes_in_;
+    snapshot.bytes_out = bytes_out_;
+    snapshot.items_total = items_total_;
+    snapshot.items_done = items_done_;
+    for (int i = 0; i < static_cast<int>(OperationPhase::kCount); i++) {
+      snapshot.phase_sec[i] = phase_ns_[i] / 1e9;
+    }
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(sample_lock_);
+    snapshot.elapsed_sec = std::chrono::duration<double>(now - start_time_).count();
+    //instantaneous rate over the last sample window,not shorter than 100ms
+    const double window = std::chrono::duration<double>(now - sample_time_).count();
+    if (window >= 0.1) {
+      const uint64_t delta = snapshot.bytes_in >= sample_bytes_ ? snapshot.bytes_in - sample_bytes_ : 0;
+      instant_mbps_ = delta / kBytesPerMB / window;
+      sample_time_ = now;
+      sample_bytes_ = snapshot.bytes_in;
+    }
+    snapshot.instant_mbps = instant_mbps_;
+    snapshot.average_mbps = snapshot.elapsed_sec > 0.0 ?
+      snapshot.bytes_in / kBytesPerMB / snapshot.elapsed_sec : 0.0;
+    snapshot.eta_sec = -1.0;
+    if (snapshot.total_bytes > 0 && snapshot.average_mbps > 0.0) {
+      const uint64_t left = snapshot.total_bytes > snapshot.bytes_in ? snapshot.total_bytes - snapshot.bytes_in : 0;
+      snapshot.eta_sec = left / kBytesPerMB / snapshot.average_mbps;
+    }
+    return snapshot;
+  }
+  void OperationStats::Notify(bool is_force) {
+    if (!observer_) {
+      return;
+    }
+    {
+      const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      std::lock_guard<std::mutex> lock(sample_lock_);
+      if (!is_force && now - notify_time_ < std::chrono::milliseconds(kObserverIntervalMs)) {
+        return;
+      }
+      notify_time_ = now;
+    }
+    observer_->OnProgress(Snapshot());
+  }
+  std::wstring OperationStats::ToJson() {
+    const OperationSnapshot snapshot = Snapshot();
+    wchar_t buffer[256] = { 0 };
+    std::wstring json = L"{";
+    swprintf(buffer, sizeof(buffer) / sizeof(wchar_t),
+      L"\"total_bytes\":%llu,\"bytes_in\":%llu,\"bytes_out\":%llu,"
+      L"\"items_total\":%llu,\"items_done\":%llu,",
+      (unsigned long long)snapshot.total_bytes, (unsigned long long)snapshot.bytes_in,
+      (unsigned long long)snapshot.bytes_out, (unsigned long long)snapshot.items_total,
+      (unsigned long long)snapshot.items_done);
+    json += buffer;
+    swprintf(buffer, sizeof(buffer) / sizeof(wchar_t),
+      L"\"elapsed_sec\":%.3f,\"instant_mbps\":%.2f,\"average_mbps\":%.2f,\"eta_sec\":%.1f,",
+      snapshot.elapsed_sec, snapshot.instant_mbps, snapshot.average_mbps, snapshot.eta_sec);
+    json += buffer;
+    json += L"\"phases\":{";
+    for (int i = 0; i < static_cast<int>(OperationPhase::kCount); i++) {
+      swprintf(buffer, sizeof(buffer) / sizeof(wchar_t), L"%ls\"%ls\":%.3f",
+        i ? L"," : L"", kOperationPhaseNames[i], snapshot.phase_sec[i]);
+      json += buffer;
+    }
+    json += L"}}";
+    return json;
+  }
+
+}
@@ -0,0 +1,113 @@
+#ifndef COMPRESSOR_OPERATION_STATS_H_
+#define COMPRESSOR_OPERATION_STATS_H_
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+namespace compressor {
+
+  enum class OperationPhase
+  {
+    kOpen,
+    kHeaderParse,
+    kScan,
+    kDecode,
+    kEncode,
+    kWrite,
+    kMkdir,
+    kClose,
+    kCount
+  };
+
+  static const wchar_t* const kOperationPhaseNames[] = {
+    L"open", L"header_parse", L"scan", L"decode", L"encode", L"write", L"mkdir", L"close"
+  };
+
+  struct OperationSnapshot
+  {
+    uint64_t total_bytes;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t items_total;
+    uint64_t items_done;
+    double elapsed_sec;
+    double instant_mbps;
+    double average_mbps;
+    double eta_sec; //<0:unknown
+    double phase_sec[static_cast<int>(OperationPhase::kCount)];
+  };
+
+  class OperationObserver
+  {
+  public:
+    virtual ~OperationObserver() {}
+    //called from the coder thread,at most every kObserverIntervalMs
+    virtual void OnProgress(const OperationSnapshot& snapshot) = 0;
+  };
+
+  //Counters shared by the extract and update callbacks. Writer threads add
+  //to them concurrently,so phase times are summed thread time and can add up
+  //to more than the wall clock.
+  class OperationStats
+  {
+  public:
+    static const int kObserverIntervalMs = 200;
+    OperationStats();
+    virtual ~OperationStats();
+    void Reset();
+    void SetObserver(OperationObserver* observer) {
+      observer_ = observer;
+    }
+    void SetTotal(uint64_t total_bytes);
+    void SetItemsTotal(uint64_t items_total);
+    void SetCompleted(uint64_t bytes_in);
+    void AddBytesOut(uint64_t bytes);
+    void SetBytesOut(uint64_t bytes);
+    void AddItem();
+    void AddPhaseTime(OperationPhase phase, uint64_t ns);
+    OperationSnapshot Snapshot();
+    std::wstring ToJson();
+    void Notify(bool is_force);
+
+    //times one phase,a null stats makes it a no-op
+    class ScopedPhase
+    {
+    public:
+      ScopedPhase(OperationStats* stats, OperationPhase phase) :stats_(stats), phase_(phase) {
+        if (stats_) {
+          start_ = std::chrono::steady_clock::now();
+        }
+      }
+      ~ScopedPhase() {
+        if (stats_) {
+          stats_->AddPhaseTime(phase_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count()));
+        }
+      }
+    private:
+      OperationStats* stats_;
+      OperationPhase phase_;
+      std::chrono::steady_clock::time_point start_;
+    };
+  private:
+    OperationObserver* observer_;
+    std::atomic<uint64_t> total_bytes_;
+    std::atomic<uint64_t> bytes_in_;
+    std::atomic<uint64_t> bytes_out_;
+    std::atomic<uint64_t> items_total_;
+    std::atomic<uint64_t> items_done_;
+    std::atomic<uint64_t> phase_ns_[static_cast<int>(OperationPhase::kCount)];
+    std::mutex sample_lock_;
+    std::chrono::steady_clock::time_point start_time_;
+    std::chrono::steady_clock::time_point sample_time_;
+    std::chrono::steady_clock::time_point notify_time_;
+    uint64_t sample_bytes_;
+    double instant_mbps_;
+  };
+
+}
+
+#endif // !COMPRESSOR_OPERATION_STATS_H_
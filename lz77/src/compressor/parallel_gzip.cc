@@ -0,0 +1,196 @@
+#include "compressor/parallel_gzip.h"
+#include <algorithm>
+#include <zlib.h>
+
+namespace compressor {
+
+  //BFINAL set,fixed Huffman,end of block:closes the sync-flushed blocks
+  static const uint8_t kGzipFinalBlock[] = { 0x03, 0x00 };
+#if defined(OS_WIN)
+  static const uint8_t kGzipHostOS = 11; //NTFS,as 7-Zip writes it
+#else
+  static const uint8_t kGzipHostOS = 3; //Unix
+#endif
+
+  static void PutLE32(uint8_t* p, uint32_t value) {
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+  }
+
+  ParallelGzipWriter::ParallelGzipWriter(int level, unsigned int num_threads) {
+    level_ = (std::min)((std::max)(level, 0), 9);
+    num_threads_ = num_threads ? num_threads : 1;
+    bytes_in_ = 0;
+    is_stopping_ = false;
+  }
+  ParallelGzipWriter::~ParallelGzipWriter() {
+    Stop();
+  }
+  void ParallelGzipWriter::Start() {
+    is_stopping_ = false;
+    for (unsigned int i = 0; i < num_threads_; i++) {
+      workers_.push_back(std::thread(&ParallelGzipWriter::WorkerMain, this));
+    }
+  }
+  void ParallelGzipWriter::Stop() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      is_stopping_ = true;
+    }
+    queued_.notify_all();
+    for (size_t i = 0; i < workers_.size(); i++) {
+      workers_[i].join();
+    }
+    workers_.resize(0);
+    queue_.clear();
+    window_.clear();
+  }
+  bool ParallelGzipWriter::Deflate(int level, GzipBlock& block) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+      //fail
+      return true;
+    }
+    if (!block.dictionary.empty() &&
+      deflateSetDictionary(&stream, &block.dictionary[0], (uInt)block.dictionary.size()) != Z_OK) {
+      deflateEnd(&stream);
+      return true;
+    }
+    //room for the sync flush marker as well
+    block.packed.resize(deflateBound(&stream, (uLong)block.data.size()) + 16);
+    stream.next_in = block.data.empty() ? Z_NULL : &block.data[0];
+    stream.avail_in = (uInt)block.data.size();
+    size_t packed_size = 0;
+    int res = Z_OK;
+    for (;;) {
+      stream.next_out = &block.packed[packed_size];
+      stream.avail_out = (uInt)(block.packed.size() - packed_size);
+      res = deflate(&stream, Z_SYNC_FLUSH);
+      packed_size = block.packed.size() - stream.avail_out;
+      if (res != Z_OK && res != Z_BUF_ERROR) {
+        break;
+      }
+      if (stream.avail_out != 0) {
+        break;
+      }
+      //a full buffer may hold back the flush,give it more room
+      block.packed.resize(block.packed.size() * 2);
+    }
+    deflateEnd(&stream);
+    if (res != Z_OK || stream.avail_in != 0) {
+      return true;
+    }
+    block.packed.resize(packed_size);
+    block.crc = (uint32_t)crc32(0L, block.data.empty() ? Z_NULL : &block.data[0], (uInt)block.data.size());
+    return false;
+  }
+  void ParallelGzipWriter::WorkerMain() {
+    std::unique_lock<std::mutex> lock(lock_);
+    for (;;) {
+      queued_.wait(lock, [this]() { return is_stopping_ || !queue_.empty(); });
+      if (is_stopping_) {
+        return;
+      }
+      GzipBlock* block = queue_.front();
+      queue_.pop_front();
+      block->state = GzipBlockState::kRunning;
+      lock.unlock();
+      const bool fail = Deflate(level_, *block);
+      lock.lock();
+      block->state = fail ? GzipBlockState::kFailed : GzipBlockState::kDone;
+      done_.notify_all();
+    }
+  }
+  size_t ParallelGzipWriter::ReadBlock(ByteRing* in, std::vector<uint8_t>& data) {
+    data.resize(kGzipBlockSize);
+    size_t size = 0;
+    while (size < data.size()) {
+      const size_t n = in->Read(&data[size], data.size() - size);
+      if (n == 0) {
+        break;
+      }
+      size += n;
+    }
+    data.resize(size);
+    return size;
+  }
+  bool ParallelGzipWriter::Encode(ByteRing* in, GzipSink* out, uint32_t mtime) {
+    bytes_in_ = 0;
+    uint8_t header[10] = { 0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, kGzipHostOS };
+    PutLE32(&header[4], mtime);
+    header[8] = (uint8_t)(level_ >= 9 ? 2 : (level_ <= 1 ? 4 : 0));
+    if (out->Write(header, sizeof(header))) {
+      //fail
+      return true;
+    }
+    Start();
+    const size_t max_blocks = kGzipBlocksPerThread * num_threads_;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    std::vector<uint8_t> dictionary;
+    bool is_end = false;
+    bool fail = false;
+    while (!fail) {
+      //write what is done at the front before reading further
+      std::unique_ptr<GzipBlock> front;
+      {
+        std::unique_lock<std::mutex> lock(lock_);
+        const bool must_wait = is_end || window_.size() >= max_blocks;
+        if (must_wait && window_.empty()) {
+          break;
+        }
+        if (must_wait) {
+          done_.wait(lock, [this]() {
+            return window_.front()->state == GzipBlockState::kDone ||
+              window_.front()->state == GzipBlockState::kFailed;
+          });
+        }
+        if (!window_.empty() && (window_.front()->state == GzipBlockState::kDone ||
+          window_.front()->state == GzipBlockState::kFailed)) {
+          front.swap(window_.front());
+          window_.pop_front();
+        }
+      }
+      if (front) {
+        if (front->state == GzipBlockState::kFailed) {
+          fail = true;
+          break;
+        }
+        crc = crc32_combine(crc, front->crc, (z_off_t)front->data.size());
+        fail = out->Write(front->packed.data(), front->packed.size());
+        continue;
+      }
+      std::unique_ptr<GzipBlock> block(new GzipBlock);
+      if (ReadBlock(in, block->data) == 0) {
+        is_end = true;
+        continue;
+      }
+      bytes_in_ += block->data.size();
+      block->dictionary.swap(dictionary);
+      const size_t tail = (std::min)(block->data.size(), kGzipDictionarySize);
+      dictionary.assign(block->data.end() - tail, block->data.end());
+      block->crc = 0;
+      block->state = GzipBlockState::kQueued;
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        queue_.push_back(block.get());
+        window_.push_back(std::move(block));
+      }
+      queued_.notify_one();
+    }
+    Stop();
+    if (fail || in->is_write_failed() || in->is_aborted()) {
+      return true;
+    }
+    uint8_t trailer[sizeof(kGzipFinalBlock) + 8];
+    std::copy(kGzipFinalBlock, kGzipFinalBlock + sizeof(kGzipFinalBlock), trailer);
+    PutLE32(&trailer[sizeof(kGzipFinalBlock)], (uint32_t)crc);
+    PutLE32(&trailer[sizeof(kGzipFinalBlock) + 4], (uint32_t)bytes_in_);
+    return out->Write(trailer, sizeof(trailer));
+  }
+
+}
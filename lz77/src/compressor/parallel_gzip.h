@@ -0,0 +1,75 @@
+#ifndef COMPRESSOR_PARALLEL_GZIP_H_
+#define COMPRESSOR_PARALLEL_GZIP_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+#include "compressor/byte_ring.h"
+
+namespace compressor {
+
+  //input per deflate job,pigz uses the same
+  static const size_t kGzipBlockSize = 128 * 1024;
+  //each job is primed with the tail of the previous one
+  static const size_t kGzipDictionarySize = 32 * 1024;
+  //jobs queued or waiting to be written,per thread
+  static const size_t kGzipBlocksPerThread = 4;
+
+  //where the gzip stream goes,true on failure
+  class GzipSink
+  {
+  public:
+    virtual ~GzipSink() {}
+    virtual bool Write(const void* data, size_t size) = 0;
+  };
+
+  enum class GzipBlockState { kQueued, kRunning, kDone, kFailed };
+
+  struct GzipBlock
+  {
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> dictionary;
+    std::vector<uint8_t> packed;
+    uint32_t crc;
+    GzipBlockState state;
+  };
+
+  //One gzip member from a ByteRing,deflated on several threads the pigz way:
+  //every block is raw deflate primed with the 32 KiB before it and ended with
+  //a sync flush,so the blocks concatenate into a single deflate stream. The
+  //CRCs are combined in order and an empty final block closes the stream.
+  class ParallelGzipWriter
+  {
+  public:
+    ParallelGzipWriter(int level, unsigned int num_threads);
+    virtual ~ParallelGzipWriter();
+    //reads in until it ends,true when in broke,a block failed or out refused
+    bool Encode(ByteRing* in, GzipSink* out, uint32_t mtime);
+    uint64_t bytes_in() const {
+      return bytes_in_;
+    }
+  private:
+    void Start();
+    void Stop();
+    void WorkerMain();
+    static bool Deflate(int level, GzipBlock& block);
+    static size_t ReadBlock(ByteRing* in, std::vector<uint8_t>& data);
+    int level_;
+    unsigned int num_threads_;
+    uint64_t bytes_in_;
+    std::deque<std::unique_ptr<GzipBlock>> window_; //in stream order,written from the front
+    std::deque<GzipBlock*> queue_;
+    std::mutex lock_;
+    std::condition_variable queued_;
+    std::condition_variable done_;
+    std::vector<std::thread> workers_;
+    bool is_stopping_;
+  };
+
+}
+
+#endif // !COMPRESSOR_PARALLEL_GZIP_H_
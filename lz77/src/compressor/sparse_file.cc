@@ -0,0 +1,232 @@
+#include "compressor/sparse_file.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(OS_WIN)
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace compressor {
+
+  SparseFileWriter::SparseFileWriter() {
+    Attach(nullptr);
+  }
+  SparseFileWriter::~SparseFileWriter() {
+    holes_.clear();
+  }
+  void SparseFileWriter::Attach(void* file) {
+    file_ = file;
+    pos_ = 0;
+    end_ = 0;
+    is_preallocated_ = false;
+    is_sparse_scan_ = false;
+    is_sparse_set_ = false;
+    holes_.clear();
+  }
+  bool SparseFileWriter::IsZero(const uint8_t* data, size_t size) {
+    //first byte zero and every byte equal to the next one
+    return size == 0 || (data[0] == 0 && !memcmp(data, data + 1, size - 1));
+  }
+  void SparseFileWriter::AddHole(uint64_t begin, uint64_t end) {
+    if (!holes_.empty() && holes_.back().second == begin) {
+      holes_.back().second = end;
+      return;
+    }
+    holes_.push_back(std::make_pair(begin, end));
+  }
+  void SparseFileWriter::SetPosition(uint64_t pos) {
+    //the owner seeked the handle itself
+    pos_ = pos;
+  }
+  bool SparseFileWriter::Write(const void* data, size_t size) {
+    const uint8_t* byte_data = static_cast<const uint8_t*>(data);
+    if (!is_sparse_scan_) {
+      return WriteRaw(byte_data, size);
+    }
+    while (size > 0) {
+      //up to the next run boundary the data is written as is
+      const size_t head = static_cast<size_t>(pos_ % kSparseRunSize);
+      if (head != 0 || size < kSparseRunSize) {
+        const size_t n = (std::min)(size, kSparseRunSize - head);
+        if (WriteRaw(byte_data, n)) {
+          //fail
+          return true;
+        }
+        byte_data += n;
+        size -= n;
+        continue;
+      }
+      //whole runs:one write for the data runs,one seek for the zero runs
+      const bool is_zero = IsZero(byte_data, kSparseRunSize);
+      size_t n = kSparseRunSize;
+      while (size - n >= kSparseRunSize && IsZero(byte_data + n, kSparseRunSize) == is_zero) {
+        n += kSparseRunSize;
+      }
+      if (is_zero ? Skip(n) : WriteRaw(byte_data, n)) {
+        //fail
+        return true;
+      }
+      byte_data += n;
+      size -= n;
+    }
+    //success
+    return false;
+  }
+#if defined(OS_WIN)
+  void SparseFileWriter::Preallocate(uint64_t size) {
+    HANDLE file = static_cast<HANDLE>(file_);
+    if (!file || file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    is_sparse_scan_ = size >= kSparseMinSize;
+    if (size < kPreallocMinSize) {
+      return;
+    }
+    //reserves clusters without moving the end of file or zero-filling them
+    //(SetFileValidData would also skip the zeroing but exposes stale disk
+    //contents under the holes and needs SE_MANAGE_VOLUME_NAME)
+    FILE_ALLOCATION_INFO info;
+    info.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+    is_preallocated_ = SetFileInformationByHandle(file, FileAllocationInfo, &info, sizeof(info)) != FALSE;
+  }
+  bool SparseFileWriter::WriteRaw(const uint8_t* data, size_t size) {
+    HANDLE file = static_cast<HANDLE>(file_);
+    while (size > 0) {
+      DWORD written = 0;
+      const DWORD n = static_cast<DWORD>((std::min)(size, static_cast<size_t>(1u << 30)));
+      if (!::WriteFile(file, data, n, &written, nullptr) || written == 0) {
+        //fail
+        return true;
+      }
+      data += written;
+      size -= written;
+      pos_ += written;
+    }
+    end_ = (std::max)(end_, pos_);
+    //success
+    return false;
+  }
+  bool SparseFileWriter::Skip(uint64_t size) {
+    HANDLE file = static_cast<HANDLE>(file_);
+    if (!is_sparse_set_) {
+      DWORD returned = 0;
+      if (!DeviceIoControl(file, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr)) {
+        //FAT/exFAT:no holes,write the zeros like any other data
+        is_sparse_scan_ = false;
+        std::vector<uint8_t> zeros(kSparseRunSize, 0);
+        while (size > 0) {
+          const size_t n = static_cast<size_t>((std::min)(size, static_cast<uint64_t>(kSparseRunSize)));
+          if (WriteRaw(&zeros[0], n)) {
+            //fail
+            return true;
+          }
+          size -= n;
+        }
+        //success
+        return false;
+      }
+      is_sparse_set_ = true;
+    }
+    LARGE_INTEGER distance;
+    distance.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFilePointerEx(file, distance, nullptr, FILE_CURRENT)) {
+      //fail
+      return true;
+    }
+    AddHole(pos_, pos_ + size);
+    pos_ += size;
+    //success
+    return false;
+  }
+  bool SparseFileWriter::Finish() {
+    HANDLE file = static_cast<HANDLE>(file_);
+    if (!file || file == INVALID_HANDLE_VALUE || holes_.empty()) {
+      //success
+      return false;
+    }
+    bool fail = false;
+    const uint64_t size = (std::max)(pos_, end_);
+    if (size > end_) {
+      //ends in a hole:nothing was written there to move the end of file
+      LARGE_INTEGER distance;
+      distance.QuadPart = static_cast<LONGLONG>(size);
+      fail = !SetFilePointerEx(file, distance, nullptr, FILE_BEGIN) || !SetEndOfFile(file);
+    }
+    if (is_preallocated_) {
+      //reserved clusters stay allocated under a seek,give them back
+      for (size_t i = 0; i < holes_.size(); i++) {
+        FILE_ZERO_DATA_INFORMATION zero_data;
+        zero_data.FileOffset.QuadPart = static_cast<LONGLONG>(holes_[i].first);
+        zero_data.BeyondFinalZero.QuadPart = static_cast<LONGLONG>(holes_[i].second);
+        DWORD returned = 0;
+        DeviceIoControl(file, FSCTL_SET_ZERO_DATA, &zero_data, sizeof(zero_data),
+          nullptr, 0, &returned, nullptr);
+      }
+    }
+    holes_.clear();
+    return fail;
+  }
+#else
+  void SparseFileWriter::Preallocate(uint64_t size) {
+    FILE* file = static_cast<FILE*>(file_);
+    if (!file) {
+      return;
+    }
+    is_sparse_scan_ = size >= kSparseMinSize;
+    if (size < kPreallocMinSize) {
+      return;
+    }
+    is_preallocated_ = posix_fallocate(fileno(file), 0, static_cast<off_t>(size)) == 0;
+  }
+  bool SparseFileWriter::WriteRaw(const uint8_t* data, size_t size) {
+    if (fwrite(data, 1, size, static_cast<FILE*>(file_)) != size) {
+      //fail
+      return true;
+    }
+    pos_ += size;
+    end_ = (std::max)(end_, pos_);
+    //success
+    return false;
+  }
+  bool SparseFileWriter::Skip(uint64_t size) {
+    //gaps read back as zeros,most file systems do not allocate them
+    if (fseeko(static_cast<FILE*>(file_), static_cast<off_t>(size), SEEK_CUR)) {
+      //fail
+      return true;
+    }
+    AddHole(pos_, pos_ + size);
+    pos_ += size;
+    //success
+    return false;
+  }
+  bool SparseFileWriter::Finish() {
+    FILE* file = static_cast<FILE*>(file_);
+    if (!file || holes_.empty()) {
+      //success
+      return false;
+    }
+    fflush(file);
+    bool fail = false;
+    const uint64_t size = (std::max)(pos_, end_);
+    if (size > end_) {
+      fail = ftruncate(fileno(file), static_cast<off_t>(size)) != 0;
+    }
+#if defined(FALLOC_FL_PUNCH_HOLE)
+    if (is_preallocated_) {
+      for (size_t i = 0; i < holes_.size(); i++) {
+        fallocate(fileno(file), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+          static_cast<off_t>(holes_[i].first), static_cast<off_t>(holes_[i].second - holes_[i].first));
+      }
+    }
+#endif
+    holes_.clear();
+    return fail;
+  }
+#endif
+
+}
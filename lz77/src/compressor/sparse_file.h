@@ -0,0 +1,47 @@
+#ifndef COMPRESSOR_SPARSE_FILE_H_
+#define COMPRESSOR_SPARSE_FILE_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace compressor {
+
+  //smaller files are left to grow,reserving costs more than it saves
+  static const uint64_t kPreallocMinSize = 1024 * 1024;
+  //only files this large are scanned for zero runs (disk images and the like)
+  static const uint64_t kSparseMinSize = 8 * 1024 * 1024;
+  //NTFS sparse allocation unit,holes are whole aligned runs of it
+  static const size_t kSparseRunSize = 64 * 1024;
+
+  //Writes one extracted file through a native handle (HANDLE on Windows,
+  //FILE* elsewhere). The expected size is reserved up front and,for large
+  //files,aligned all-zero runs are skipped with a seek and left as holes.
+  class SparseFileWriter
+  {
+  public:
+    SparseFileWriter();
+    virtual ~SparseFileWriter();
+    void Attach(void* file);
+    void Preallocate(uint64_t size);
+    bool Write(const void* data, size_t size);
+    void SetPosition(uint64_t pos);
+    //fixes up the end of file and releases reserved space under the holes
+    bool Finish();
+  private:
+    static bool IsZero(const uint8_t* data, size_t size);
+    bool WriteRaw(const uint8_t* data, size_t size);
+    bool Skip(uint64_t size);
+    void AddHole(uint64_t begin, uint64_t end);
+    void* file_;
+    uint64_t pos_;
+    uint64_t end_; //bytes actually on disk,a trailing hole is past it
+    bool is_preallocated_;
+    bool is_sparse_scan_;
+    bool is_sparse_set_;
+    std::vector<std::pair<uint64_t, uint64_t>> holes_;
+  };
+
+}
+
+#endif // !COMPRESSOR_SPARSE_FILE_H_
@@ -0,0 +1,448 @@
+#include "compressor/win/disc_image_writer.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
+#include <cwchar>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <windows.h>
+
+#include "compressor/byte_ring.h"
+#include "compressor/dir_scanner.h"
+
+#include <ckcore/log.hh>
+#include <ckcore/progress.hh>
+#include <ckcore/progresser.hh>
+#include <ckcore/stream.hh>
+#include <ckfilesystem/const.hh>
+#include <ckfilesystem/fileset.hh>
+#include <ckfilesystem/filesystem.hh>
+#include <ckfilesystem/filesystemwriter.hh>
+
+namespace compressor {
+
+  static const wchar_t * const kImageScanFailed = L"scan failed!";
+  static const wchar_t * const kImageOpenFailed = L"open failed!";
+  static const wchar_t * const kImageWriteFailed = L"write failed!";
+
+  enum class ImageChunkState { kIdle, kLoading, kReady, kFailed };
+
+  struct ImageChunk
+  {
+    uint32_t file; //index into the nodes given to prepare
+    uint64_t offset;
+    uint32_t size;
+    ImageChunkState state;
+    std::vector<uint8_t> data;
+  };
+
+  //FileSystemWriter logs every node,nothing here needs it
+  class ImageLog : public ckcore::Log
+  {
+  public:
+    virtual void print(const ckcore::tchar * /* format */,...) {}
+    virtual void print_line(const ckcore::tchar * /* format */,...) {}
+  };
+
+  class ImageProgress : public ckcore::Progress
+  {
+  public:
+    ImageProgress(const std::wstring& image_name, std::map<std::wstring, std::wstring>* errors) :
+      image_name_(image_name), errors_(errors) {}
+    virtual void set_status(const ckcore::tchar * /* format */,...) {}
+    virtual void notify(MessageType type, const ckcore::tchar *format,...) {
+      if (type != ckERROR) {
+        return;
+      }
+      wchar_t message[512];
+      va_list args;
+      va_start(args, format);
+      _vsnwprintf_s(message, _TRUNCATE, format, args);
+      va_end(args);
+      (*errors_)[image_name_] = message;
+    }
+    virtual bool cancelled() {
+      return false;
+    }
+  private:
+    std::wstring image_name_;
+    std::map<std::wstring, std::wstring>* errors_;
+  };
+
+  //The one ordered sector writer:FileSystemWriter fills a ring,a thread
+  //drains it into the image in kImageWriteBufferSize blocks from a page
+  //aligned buffer,so every write but the last is a whole number of sectors.
+  class ImageSectorStream : public ckcore::OutStream
+  {
+  public:
+    ImageSectorStream(HANDLE file, OperationStats* stats) : ring_(kImageRingSize) {
+      file_ = file;
+      stats_ = stats;
+      is_write_failed_ = false;
+      writer_ = std::thread(&ImageSectorStream::WriterMain, this);
+    }
+    virtual ~ImageSectorStream() {
+      if (writer_.joinable()) {
+        //Finish() was never called
+        ring_.Abort();
+        writer_.join();
+      }
+    }
+    virtual ckcore::tint64 write(const void *buffer, ckcore::tuint32 count) {
+      if (ring_.Write(buffer, count)) {
+        //the writer gave up
+        return -1;
+      }
+      return count;
+    }
+    //ends the ring and waits for the last block,true on failure
+    bool Finish(bool is_failed) {
+      ring_.CloseWrite(is_failed);
+      writer_.join();
+      return is_failed || is_write_failed_;
+    }
+  private:
+    void WriterMain() {
+      uint8_t* buffer = static_cast<uint8_t*>(VirtualAlloc(nullptr, kImageWriteBufferSize,
+        MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+      if (!buffer) {
+        is_write_failed_ = true;
+        ring_.Abort();
+        return;
+      }
+      for (;;) {
+        size_t filled = 0;
+        while (filled < kImageWriteBufferSize) {
+          const size_t n = ring_.Read(buffer + filled, kImageWriteBufferSize - filled);
+          if (n == 0) {
+            break;
+          }
+          filled += n;
+        }
+        if (filled == 0) {
+          break;
+        }
+        DWORD written = 0;
+        {
+          OperationStats::ScopedPhase phase(stats_, OperationPhase::kWrite);
+          if (!WriteFile(file_, buffer, (DWORD)filled, &written, nullptr) || written != filled) {
+            is_write_failed_ = true;
+            ring_.Abort();
+            break;
+          }
+        }
+        if (stats_) {
+          stats_->AddBytesOut(filled);
+        }
+        if (filled < kImageWriteBufferSize) {
+          //end of stream
+          break;
+        }
+      }
+      VirtualFree(buffer, 0, MEM_RELEASE);
+    }
+    ByteRing ring_;
+    HANDLE file_;
+    OperationStats* stats_;
+    std::thread writer_;
+    bool is_write_failed_;
+  };
+
+  //Reads the file data ahead of FileSystemWriter. The files are cut into
+  //kImageReadChunkSize chunks in layout order;workers take the next chunk
+  //as long as the chunks waiting for the writer stay within the window,
+  //so a large file is read by all of them at once and small files by one
+  //each. Every worker keeps its last file open for the next chunk.
+  class ImageFileReader : public ckfilesystem::FileDataSource
+  {
+  public:
+    explicit ImageFileReader(OperationStats* stats) {
+      stats_ = stats;
+      next_ = 0;
+      cursor_ = 0;
+      file_cursor_ = 0;
+      window_bytes_ = 0;
+      bytes_done_ = 0;
+      is_stopping_ = false;
+      is_copy_failed_ = false;
+    }
+    virtual ~ImageFileReader() {
+      Stop();
+    }
+    virtual void prepare(const std::vector<ckfilesystem::FileTreeNode *> &nodes) {
+      Stop();
+      nodes_ = nodes;
+      chunks_.resize(0);
+      first_chunk_.resize(0);
+      for (uint32_t i = 0; i < nodes_.size(); i++) {
+        first_chunk_.push_back(chunks_.size());
+        const uint64_t size = nodes_[i]->file_size_;
+        for (uint64_t offset = 0; offset < size; offset += kImageReadChunkSize) {
+          ImageChunk chunk;
+          chunk.file = i;
+          chunk.offset = offset;
+          chunk.size = (uint32_t)(std::min)((uint64_t)kImageReadChunkSize, size - offset);
+          chunk.state = ImageChunkState::kIdle;
+          chunks_.push_back(std::move(chunk));
+        }
+      }
+      first_chunk_.push_back(chunks_.size());
+      next_ = 0;
+      cursor_ = 0;
+      file_cursor_ = 0;
+      window_bytes_ = 0;
+      bytes_done_ = 0;
+      is_stopping_ = false;
+      const size_t num_threads = (std::min)((size_t)kImageReadThreads, chunks_.size());
+      for (size_t i = 0; i < num_threads; i++) {
+        workers_.push_back(std::thread(&ImageFileReader::WorkerMain, this));
+      }
+    }
+    virtual bool copy(ckfilesystem::FileTreeNode *node, ckfilesystem::SectorOutStream &out_stream,
+      ckcore::Progresser &progresser) {
+      std::unique_lock<std::mutex> lock(lock_);
+      if (file_cursor_ >= nodes_.size() || nodes_[file_cursor_] != node) {
+        //fail,not the layout order prepare was given
+        return false;
+      }
+      const size_t end = first_chunk_[++file_cursor_];
+      bool fail = false;
+      while (!fail && cursor_ < end) {
+        ImageChunk& chunk = chunks_[cursor_++];
+        ready_.wait(lock, [&chunk]() {
+          return chunk.state == ImageChunkState::kReady || chunk.state == ImageChunkState::kFailed;
+        });
+        fail = (chunk.state == ImageChunkState::kFailed);
+        lock.unlock();
+        if (!fail) {
+          try {
+            out_stream.write(&chunk.data[0], chunk.size);
+          }
+          catch (const std::exception&) {
+            //the sector writer gave up
+            fail = true;
+          }
+          progresser.update(chunk.size);
+          bytes_done_ += chunk.size;
+          if (stats_) {
+            stats_->SetCompleted(bytes_done_);
+          }
+        }
+        lock.lock();
+        window_bytes_ -= chunk.size;
+        chunk.state = ImageChunkState::kIdle;
+        pool_.push_back(std::vector<uint8_t>());
+        pool_.back().swap(chunk.data);
+        queued_.notify_all();
+      }
+      is_copy_failed_ = is_copy_failed_ || fail;
+      return !fail;
+    }
+    bool copy_failed() const {
+      return is_copy_failed_;
+    }
+  private:
+    void Stop() {
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        is_stopping_ = true;
+      }
+      queued_.notify_all();
+      for (size_t i = 0; i < workers_.size(); i++) {
+        workers_[i].join();
+      }
+      workers_.resize(0);
+    }
+    void WorkerMain() {
+      HANDLE file = INVALID_HANDLE_VALUE;
+      uint32_t open_file = 0;
+      std::unique_lock<std::mutex> lock(lock_);
+      for (;;) {
+        queued_.wait(lock, [this]() {
+          //one chunk is always allowed,whatever its size
+          return is_stopping_ || (next_ < chunks_.size() &&
+            (window_bytes_ == 0 || window_bytes_ + chunks_[next_].size <= kImageReadWindow));
+        });
+        if (is_stopping_) {
+          break;
+        }
+        ImageChunk& chunk = chunks_[next_++];
+        window_bytes_ += chunk.size;
+        chunk.state = ImageChunkState::kLoading;
+        if (!pool_.empty()) {
+          chunk.data.swap(pool_.back());
+          pool_.pop_back();
+        }
+        if (next_ < chunks_.size()) {
+          //a free worker may take the next one as well
+          queued_.notify_one();
+        }
+        lock.unlock();
+        if (file != INVALID_HANDLE_VALUE && open_file != chunk.file) {
+          CloseHandle(file);
+          file = INVALID_HANDLE_VALUE;
+        }
+        if (file == INVALID_HANDLE_VALUE) {
+          OperationStats::ScopedPhase phase(stats_, OperationPhase::kOpen);
+          file = CreateFileW(nodes_[chunk.file]->file_path_.c_str(), GENERIC_READ, FILE_SHARE_READ,
+            nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+          open_file = chunk.file;
+        }
+        const bool fail = (file == INVALID_HANDLE_VALUE) || ReadChunk(file, chunk);
+        lock.lock();
+        chunk.state = fail ? ImageChunkState::kFailed : ImageChunkState::kReady;
+        ready_.notify_all();
+      }
+      lock.unlock();
+      if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+      }
+    }
+    static bool ReadChunk(HANDLE file, ImageChunk& chunk) {
+      chunk.data.resize(chunk.size);
+      uint32_t done = 0;
+      while (done < chunk.size) {
+        //positional reads,the workers share no file pointer
+        const uint64_t offset = chunk.offset + done;
+        OVERLAPPED overlapped;
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD count = 0;
+        if (!ReadFile(file, &chunk.data[done], chunk.size - done, &count, &overlapped) || count == 0) {
+          //fail,unreadable or shorter than when the tree was built
+          return true;
+        }
+        done += count;
+      }
+      return false;
+    }
+    std::vector<ckfilesystem::FileTreeNode *> nodes_;
+    std::vector<size_t> first_chunk_; //per node,one past the last at the end
+    std::vector<ImageChunk> chunks_;
+    std::vector<std::vector<uint8_t>> pool_;
+    size_t next_; //first chunk no worker took yet
+    size_t cursor_; //first chunk the writer has not consumed
+    size_t file_cursor_; //next node copy() expects
+    uint64_t window_bytes_;
+    uint64_t bytes_done_;
+    bool is_copy_failed_;
+    OperationStats* stats_;
+    std::mutex lock_;
+    std::condition_variable queued_;
+    std::condition_variable ready_;
+    std::vector<std::thread> workers_;
+    bool is_stopping_;
+  };
+
+  static ckfilesystem::FileSystem::Type ToFileSystemType(DiscImageFormat format) {
+    switch (format) {
+    case DiscImageFormat::kIso: return ckfilesystem::FileSystem::TYPE_ISO;
+    case DiscImageFormat::kIsoJoliet: return ckfilesystem::FileSystem::TYPE_ISO_JOLIET;
+    case DiscImageFormat::kIsoUdf: return ckfilesystem::FileSystem::TYPE_ISO_UDF;
+    case DiscImageFormat::kUdf: return ckfilesystem::FileSystem::TYPE_UDF;
+    default: return ckfilesystem::FileSystem::TYPE_ISO_UDF_JOLIET;
+    }
+  }
+
+  DiscImageWriter::DiscImageWriter(const DiscImageOptions& options) : options_(options) {
+    stats_ = nullptr;
+    errors_.clear();
+  }
+  DiscImageWriter::~DiscImageWriter() {
+    errors_.clear();
+  }
+  bool DiscImageWriter::Write(const std::wstring& dir, const std::wstring& image_name) {
+    errors_.clear();
+    std::wstring root(dir);
+    while (root.size() > 1 && root[root.size() - 1] == kScanPathSeparator) {
+      root.resize(root.size() - 1);
+    }
+    ItemTable items;
+    {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kScan);
+      DirScanner scanner;
+      scanner.AddRoot(root, L"");
+      if (scanner.Scan(items)) {
+        //image what could be listed,report the rest
+        for (size_t i = 0; i < scanner.failed_paths().size(); i++) {
+          errors_[scanner.failed_paths()[i]] = kImageScanFailed;
+        }
+      }
+    }
+    ckfilesystem::FileComparator comparator(false);
+    ckfilesystem::FileSet file_set(comparator);
+    uint64_t total_size = 0;
+    std::wstring internal_path;
+    for (size_t i = 0; i < items.size(); i++) {
+      //a\b in the scan is /a/b in the image
+      internal_path = L"/" + items.Path(i);
+      std::replace(internal_path.begin(), internal_path.end(), kScanPathSeparator, L'/');
+      //sized from the scan,ImageFileReader is the only one to open the files
+      file_set.insert(new ckfilesystem::FileDescriptor(internal_path.c_str(), items.DiskPath(i).c_str(),
+        items.IsDir(i) ? ckfilesystem::FileDescriptor::FLAG_DIRECTORY : ckfilesystem::FileDescriptor::FLAG_SIZED,
+        nullptr, items.Size(i)));
+      if (!items.IsDir(i)) {
+        total_size += items.Size(i);
+      }
+    }
+    if (stats_) {
+      stats_->SetItemsTotal(items.size());
+      stats_->SetTotal(total_size);
+    }
+    std::wstring label(options_.volume_label);
+    if (label.empty()) {
+      const size_t pos = root.find_last_of(kScanPathSeparator);
+      label = (pos == std::wstring::npos) ? root : root.substr(pos + 1);
+    }
+    ckfilesystem::FileSystem file_sys(ToFileSystemType(options_.format), file_set);
+    file_sys.set_volume_label(label.c_str());
+    //Windows names and trees,readers without Joliet/UDF still get 8.3
+    file_sys.set_long_joliet_names(true);
+    file_sys.set_relax_max_dir_level(true);
+    HANDLE file = INVALID_HANDLE_VALUE;
+    {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kOpen);
+      file = CreateFileW(image_name.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    }
+    if (file == INVALID_HANDLE_VALUE) {
+      //fail
+      errors_[image_name] = kImageOpenFailed;
+      ckfilesystem::destroy_file_set(file_set);
+      return true;
+    }
+    bool fail = false;
+    {
+      ImageLog log;
+      ImageProgress progress(image_name, &errors_);
+      ImageSectorStream out_stream(file, stats_);
+      ImageFileReader reader(stats_);
+      ckfilesystem::FileSystemWriter writer(log, file_sys, true);
+      writer.set_data_source(&reader);
+      fail = (writer.write(out_stream, progress) != RESULT_OK);
+      if (out_stream.Finish(fail) && !fail) {
+        errors_[image_name] = kImageWriteFailed;
+        fail = true;
+      }
+      if (reader.copy_failed()) {
+        //file data that never made it into the image
+        errors_[image_name] = kImageWriteFailed;
+      }
+    }
+    CloseHandle(file);
+    ckfilesystem::destroy_file_set(file_set);
+    if (fail) {
+      //a partial image is of no use to anyone
+      DeleteFileW(image_name.c_str());
+      if (errors_.find(image_name) == errors_.end()) {
+        errors_[image_name] = kImageWriteFailed;
+      }
+    }
+    return fail || !errors_.empty();
+  }
+
+}
@@ -0,0 +1,48 @@
+#ifndef COMPRESSOR_WIN_DISC_IMAGE_WRITER_H_
+#define COMPRESSOR_WIN_DISC_IMAGE_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <map>
+
+#include "compressor/disc_image_options.h"
+#include "compressor/operation_stats.h"
+
+namespace compressor {
+
+  //input files are read in pieces of this size,several at once
+  static const uint32_t kImageReadChunkSize = 4 * 1024 * 1024;
+  static const unsigned int kImageReadThreads = 4;
+  //read data waiting for the sector writer
+  static const uint64_t kImageReadWindow = 64 * 1024 * 1024;
+  //between the file system writer and the disk
+  static const size_t kImageRingSize = 16 * 1024 * 1024;
+  //one WriteFile,a whole number of 2048-byte sectors
+  static const size_t kImageWriteBufferSize = 4 * 1024 * 1024;
+
+  //Builds an ISO 9660/Joliet/UDF image of a folder with ckfilesystem. The
+  //tree is listed by DirScanner,the file data is read ahead in chunks by a
+  //few threads and handed to FileSystemWriter in layout order,and the image
+  //goes out through one writer thread in large sector-aligned blocks,so the
+  //reads,the layout and the disk writes overlap.
+  class DiscImageWriter
+  {
+  public:
+    explicit DiscImageWriter(const DiscImageOptions& options);
+    virtual ~DiscImageWriter();
+    bool Write(const std::wstring& dir, const std::wstring& image_name);
+    void SetStats(OperationStats* stats) {
+      stats_ = stats;
+    }
+    const std::map<std::wstring, std::wstring>& errors() const {
+      return errors_;
+    }
+  private:
+    DiscImageOptions options_;
+    OperationStats* stats_;
+    std::map<std::wstring, std::wstring> errors_;
+  };
+
+}
+
+#endif // !COMPRESSOR_WIN_DISC_IMAGE_WRITER_H_
@@ -5,6 +5,13 @@
 #endif // !USE_STATIC_7Z_COMPONENT
 
 #include "base/string_conv.h"
+#include "compressor/dir_scanner.h"
+#include "compressor/file_prefetcher.h"
+#include "compressor/filter_sniffer.h"
+#include "compressor/item_order.h"
+#include "compressor/method_selector.h"
+#include "compressor/win/multi_volume_stream.h"
+#include "compressor/win/tar_pipeline.h"
 #if defined(OS_WIN)
 #include "CPP/Common/MyWindows.h"
 
@@ -23,6 +30,7 @@
 #include "CPP/Windows/PropVariantConv.h"
 
 #include "CPP/7zip/Common/FileStreams.h"
+#include "CPP/7zip/Common/StreamObjects.h"
 
 #include "CPP/7zip/Archive/IArchive.h"
 
@@ -47,6 +55,19 @@ namespace compressor {
   using namespace NDir;
 
   static const wchar_t * const kEmptyFileAlias = L"[Content]";
+  static const wchar_t * const kArchiveScanFailed = L"scan failed!";
+  static const wchar_t * const kArchiveReadFailed = L"read failed!";
+
+  static FILETIME ToFileTime(uint64_t ticks) {
+    FILETIME time;
+    time.dwLowDateTime = (DWORD)ticks;
+    time.dwHighDateTime = (DWORD)(ticks >> 32);
+    return time;
+  }
+
+  static uint64_t ToTicks(const FILETIME& time) {
+    return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime;
+  }
 
 
   static HRESULT GetProp(
@@ -126,13 +147,83 @@ namespace compressor {
     return S_OK;
   }
 
+  // keeps a read-ahead buffer alive for its CBufInStream,then hands it back to the pool
+  struct CPrefetchedBuffer :
+    public IUnknown,
+    public CMyUnknownImp
+  {
+    std::vector<uint8_t> Data;
+    compressor::FilePrefetcher* Prefetcher;
+
+    CPrefetchedBuffer(compressor::FilePrefetcher* prefetcher) : Prefetcher(prefetcher) {}
+    ~CPrefetchedBuffer() { Prefetcher->Recycle(Data); }
+    MY_UNKNOWN_IMP
+  };
+
+  // seekable output into a caller's buffer,7z rewrites its start header at the end
+  class CMemoryOutStream :
+    public IOutStream,
+    public CMyUnknownImp
+  {
+    std::vector<uint8_t> &_buffer;
+    UInt64 _pos;
+  public:
+    UInt64 ProcessedSize;
+
+    CMemoryOutStream(std::vector<uint8_t> &buffer) : _buffer(buffer), _pos(0), ProcessedSize(0) { _buffer.clear(); }
+    MY_UNKNOWN_IMP1(IOutStream)
+
+    STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize)
+    {
+      if (processedSize)
+        *processedSize = 0;
+      if (size == 0)
+        return S_OK;
+      if (_pos + size > (UInt64)_buffer.max_size())
+        return E_OUTOFMEMORY;
+      const size_t end = (size_t)(_pos + size);
+      if (end > _buffer.size())
+        _buffer.resize(end);
+      memcpy(&_buffer[(size_t)_pos], data, size);
+      _pos += size;
+      ProcessedSize += size;
+      if (processedSize)
+        *processedSize = size;
+      return S_OK;
+    }
+    STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition)
+    {
+      switch (seekOrigin)
+      {
+        case STREAM_SEEK_SET: break;
+        case STREAM_SEEK_CUR: offset += _pos; break;
+        case STREAM_SEEK_END: offset += _buffer.size(); break;
+        default: return STG_E_INVALIDFUNCTION;
+      }
+      if (offset < 0)
+        return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+      _pos = (UInt64)offset;
+      if (newPosition)
+        *newPosition = _pos;
+      return S_OK;
+    }
+    STDMETHOD(SetSize)(UInt64 newSize)
+    {
+      if (newSize > (UInt64)_buffer.max_size())
+        return E_OUTOFMEMORY;
+      _buffer.resize((size_t)newSize);
+      return S_OK;
+    }
+  };
+
   class CArchiveUpdateCallback :
     public IArchiveUpdateCallback2,
+    public IArchiveUpdateCallbackFile,
     public ICryptoGetTextPassword2,
     public CMyUnknownImp
   {
   public:
-    MY_UNKNOWN_IMP2(IArchiveUpdateCallback2, ICryptoGetTextPassword2)
+    MY_UNKNOWN_IMP3(IArchiveUpdateCallback2, IArchiveUpdateCallbackFile, ICryptoGetTextPassword2)
 
       // IProgress
       STDMETHOD(SetTotal)(UInt64 size);
@@ -147,6 +238,10 @@ namespace compressor {
     STDMETHOD(GetVolumeSize)(UInt32 index, UInt64 *size);
     STDMETHOD(GetVolumeStream)(UInt32 index, ISequentialOutStream **volumeStream);
 
+    // IArchiveUpdateCallbackFile
+    STDMETHOD(GetStream2)(UInt32 index, ISequentialInStream **inStream, UInt32 notifyOp);
+    STDMETHOD(ReportOperation)(UInt32 indexType, UInt32 index, UInt32 notifyOp);
+
     STDMETHOD(CryptoGetTextPassword2)(Int32 *passwordIsDefined, BSTR *password);
 
   public:
@@ -155,7 +250,9 @@ namespace compressor {
     UString VolExt;
 
     FString DirPrefix;
-    const CObjectVector<CDirItem> *DirItems;
+    const compressor::ItemTable *DirItems;
+    CRecordVector<UInt32> ItemIndices; // per item,its row in DirItems,empty:the same
+    CRecordVector<UInt32> ArchiveIndices; // per item,kNoArchiveIndex:new data
 
     bool PasswordIsDefined;
     UString Password;
@@ -163,42 +260,68 @@ namespace compressor {
 
     bool m_NeedBeClosed;
 
+    compressor::OperationStats* Stats;
+    const UInt64* OutProcessedSize;
+    compressor::FilePrefetcher* Prefetcher;
+    const std::vector<compressor::MemoryItem>* MemoryItems; // per item,data served in place
+    const std::vector<uint8_t>* FilterKinds; // per row,FilterKind,null:every file is analyzed
+
     FStringVector FailedFiles;
     CRecordVector<HRESULT> FailedCodes;
 
-    CArchiveUpdateCallback() : PasswordIsDefined(false), AskPassword(false), DirItems(0) {};
+    CArchiveUpdateCallback() : PasswordIsDefined(false), AskPassword(false), DirItems(0), Stats(0), OutProcessedSize(0), Prefetcher(0), MemoryItems(0), FilterKinds(0) {};
 
     ~CArchiveUpdateCallback() { Finilize(); }
     HRESULT Finilize();
 
-    void Init(const CObjectVector<CDirItem> *dirItems)
+    UInt32 ItemIndex(UInt32 index) const
+    {
+      return ItemIndices.Size() ? ItemIndices[index] : index;
+    }
+
+    void Init(const compressor::ItemTable *dirItems)
     {
       DirItems = dirItems;
+      ItemIndices.Clear();
+      ArchiveIndices.Clear();
       m_NeedBeClosed = false;
       FailedFiles.Clear();
       FailedCodes.Clear();
     }
   };
 
-  STDMETHODIMP CArchiveUpdateCallback::SetTotal(UInt64 /* size */)
+  STDMETHODIMP CArchiveUpdateCallback::SetTotal(UInt64 size)
   {
+    if (Stats)
+      Stats->SetTotal(size);
     return S_OK;
   }
 
-  STDMETHODIMP CArchiveUpdateCallback::SetCompleted(const UInt64 * /* completeValue */)
+  STDMETHODIMP CArchiveUpdateCallback::SetCompleted(const UInt64 *completeValue)
   {
+    if (Stats && completeValue)
+    {
+      if (OutProcessedSize)
+        Stats->SetBytesOut(*OutProcessedSize);
+      Stats->SetCompleted(*completeValue);
+    }
     return S_OK;
   }
 
-  STDMETHODIMP CArchiveUpdateCallback::GetUpdateItemInfo(UInt32 /* index */,
+  STDMETHODIMP CArchiveUpdateCallback::GetUpdateItemInfo(UInt32 index,
     Int32 *newData, Int32 *newProperties, UInt32 *indexInArchive)
   {
+    // unchanged items keep their packed data and properties,the handler copies them
+    UInt32 archiveIndex = kNoArchiveIndex;
+    if (index < ArchiveIndices.Size())
+      archiveIndex = ArchiveIndices[index];
+    const bool isNew = (archiveIndex == kNoArchiveIndex);
     if (newData)
-      *newData = BoolToInt(true);
+      *newData = BoolToInt(isNew);
     if (newProperties)
-      *newProperties = BoolToInt(true);
+      *newProperties = BoolToInt(isNew);
     if (indexInArchive)
-      *indexInArchive = (UInt32)(Int32)-1;
+      *indexInArchive = isNew ? (UInt32)(Int32)-1 : archiveIndex;
     return S_OK;
   }
 
@@ -214,16 +337,16 @@ namespace compressor {
     }
 
     {
-      const CDirItem &dirItem = (*DirItems)[index];
+      const UInt32 itemIndex = ItemIndex(index);
       switch (propID)
       {
-      case kpidPath:  prop = dirItem.Name; break;
-      case kpidIsDir:  prop = dirItem.isDir(); break;
-      case kpidSize:  prop = dirItem.Size; break;
-      case kpidAttrib:  prop = dirItem.Attrib; break;
-      case kpidCTime:  prop = dirItem.CTime; break;
-      case kpidATime:  prop = dirItem.ATime; break;
-      case kpidMTime:  prop = dirItem.MTime; break;
+      case kpidPath:  prop = DirItems->Path(itemIndex).c_str(); break;
+      case kpidIsDir:  prop = DirItems->IsDir(itemIndex); break;
+      case kpidSize:  prop = DirItems->Size(itemIndex); break;
+      case kpidAttrib:  prop = DirItems->Attrib(itemIndex); break;
+      case kpidCTime:  prop = ToFileTime(DirItems->CTime(itemIndex)); break;
+      case kpidATime:  prop = ToFileTime(DirItems->ATime(itemIndex)); break;
+      case kpidMTime:  prop = ToFileTime(DirItems->MTime(itemIndex)); break;
       }
     }
     prop.Detach(value);
@@ -252,17 +375,47 @@ namespace compressor {
   {
     RINOK(Finilize());
 
-    const CDirItem &dirItem = (*DirItems)[index];
-    GetStream2(dirItem.Name);
+    const UInt32 itemIndex = ItemIndex(index);
+    GetStream2(DirItems->Path(itemIndex).c_str());
 
-    if (dirItem.isDir())
+    if (DirItems->IsDir(itemIndex))
       return S_OK;
 
+    if (MemoryItems)
+    {
+      const compressor::MemoryItem &memoryItem = (*MemoryItems)[itemIndex];
+      CBufInStream *inStreamSpec = new CBufInStream;
+      CMyComPtr<ISequentialInStream> inStreamLoc(inStreamSpec);
+      inStreamSpec->Init(memoryItem.data, memoryItem.size);
+      *inStream = inStreamLoc.Detach();
+      return S_OK;
+    }
+    if (Prefetcher)
+    {
+      // only a taken buffer goes back to the pool,a miss recycles nothing
+      std::vector<uint8_t> data;
+      if (!Prefetcher->Take(index, data))
+      {
+        CPrefetchedBuffer *bufferSpec = new CPrefetchedBuffer(Prefetcher);
+        CMyComPtr<IUnknown> bufferRef(bufferSpec);
+        bufferSpec->Data.swap(data);
+        CBufInStream *inStreamSpec = new CBufInStream;
+        CMyComPtr<ISequentialInStream> inStreamLoc(inStreamSpec);
+        inStreamSpec->Init(bufferSpec->Data.data(), bufferSpec->Data.size(), bufferRef);
+        *inStream = inStreamLoc.Detach();
+        return S_OK;
+      }
+    }
     {
       CInFileStream *inStreamSpec = new CInFileStream;
       CMyComPtr<ISequentialInStream> inStreamLoc(inStreamSpec);
-      FString path = DirPrefix + dirItem.FullPath;
-      if (!inStreamSpec->Open(path))
+      FString path = DirPrefix + us2fs(DirItems->DiskPath(itemIndex).c_str());
+      bool opened = false;
+      {
+        OperationStats::ScopedPhase phase(Stats, OperationPhase::kOpen);
+        opened = inStreamSpec->Open(path);
+      }
+      if (!opened)
       {
         DWORD sysError = ::GetLastError();
         FailedCodes.Add(sysError);
@@ -281,9 +434,47 @@ namespace compressor {
     return S_OK;
   }
 
+  STDMETHODIMP CArchiveUpdateCallback::GetStream2(UInt32 index, ISequentialInStream **inStream, UInt32 notifyOp)
+  {
+    if (notifyOp != NUpdateNotifyOp::kAnalyze)
+      return GetStream(index, inStream);
+
+    // the 7z handler reads the head of a file to pick its filter group;
+    // a prefetched buffer is left for the real read
+    *inStream = NULL;
+    const UInt32 itemIndex = ItemIndex(index);
+    if (DirItems->IsDir(itemIndex))
+      return S_FALSE;
+    if (MemoryItems)
+    {
+      const compressor::MemoryItem &memoryItem = (*MemoryItems)[itemIndex];
+      CBufInStream *inStreamSpec = new CBufInStream;
+      CMyComPtr<ISequentialInStream> inStreamLoc(inStreamSpec);
+      inStreamSpec->Init(memoryItem.data, memoryItem.size);
+      *inStream = inStreamLoc.Detach();
+      return S_OK;
+    }
+    // nothing the sniffer recognized,the handler would not filter it either
+    if (FilterKinds && (*FilterKinds)[itemIndex] == (uint8_t)compressor::FilterKind::kNone)
+      return S_FALSE;
+    CInFileStream *inStreamSpec = new CInFileStream;
+    CMyComPtr<ISequentialInStream> inStreamLoc(inStreamSpec);
+    if (!inStreamSpec->Open(DirPrefix + us2fs(DirItems->DiskPath(itemIndex).c_str())))
+      return S_FALSE;
+    *inStream = inStreamLoc.Detach();
+    return S_OK;
+  }
+
+  STDMETHODIMP CArchiveUpdateCallback::ReportOperation(UInt32 /* indexType */, UInt32 /* index */, UInt32 /* notifyOp */)
+  {
+    return S_OK;
+  }
+
   STDMETHODIMP CArchiveUpdateCallback::SetOperationResult(Int32 /* operationResult */)
   {
     m_NeedBeClosed = true;
+    if (Stats)
+      Stats->AddItem();
     return S_OK;
   }
 
@@ -336,9 +527,21 @@ namespace compressor {
   Wrapper7zArchive::Wrapper7zArchive(const std::vector<std::wstring>& dirs,
     const std::wstring& out, 
     const std::wstring& ext, 
-    const wchar_t* password){
+    const wchar_t* password,
+    const CompressionProfile& profile,
+    ArchiveUpdateMode update_mode,
+    OperationStats* stats){
     archive_error_ = ArchiveErrorTable::kOK;
-    error_files_.resize(0);
+    profile_ = profile;
+    update_mode_ = update_mode;
+    stats_ = stats;
+    stored_items_ = nullptr;
+    filter_kinds_ = nullptr;
+    deferred_count_ = 0;
+    is_store_pass_ = false;
+    memory_items_ = nullptr;
+    out_buffer_ = nullptr;
+    errors_.clear();
     password_.resize(0);
     if (password){
       password_ = password;
@@ -348,15 +551,182 @@ namespace compressor {
     for (;it!=dirs.end();it++){
       fileList.Add(it->c_str());
     }
-    CObjectVector<CDirItem> ItemList;
-    GetArchiveItemFromFileList(fileList, ItemList);
+    ItemTable ItemList;
+    {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kScan);
+      GetArchiveItemFromFileList(fileList, ItemList);
+      if (profile_.is_content_order && ItemOrderer::IsOrdered(ext)) {
+        OrderItems(ItemList);
+      }
+    }
+    if (stats_) {
+      stats_->SetItemsTotal(ItemList.size());
+    }
+    //a volume set can not be updated,so it gets no store pass
+    std::vector<uint8_t> stored;
+    if (profile_.is_store_incompressible && !profile_.volume_size && MethodSelector::IsSelective(ext)) {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kScan);
+      if (SelectStored(ItemList, stored)) {
+        stored_items_ = &stored;
+      }
+    }
+    std::vector<uint8_t> filterKinds;
+    if (profile_.is_exe_filter && FilterSniffer::IsFiltered(ext)) {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kScan);
+      SniffFilters(ItemList, filterKinds);
+      filter_kinds_ = &filterKinds;
+    }
     ArchiveFile(ItemList, ext, out.c_str());
+    stored_items_ = nullptr;
+    if (deferred_count_ && archive_error_ == ArchiveErrorTable::kOK) {
+      //the handler copies what the first pass compressed and adds the rest
+      //with Copy,as a solid group of its own
+      profile_ = profile_.StoreProfile();
+      update_mode_ = ArchiveUpdateMode::kUpdate;
+      is_store_pass_ = true;
+      ArchiveFile(ItemList, ext, out.c_str());
+      is_store_pass_ = false;
+    }
+    filter_kinds_ = nullptr;
+  }
+  Wrapper7zArchive::Wrapper7zArchive(const std::vector<MemoryItem>& items,
+    std::vector<uint8_t>& out,
+    const std::wstring& ext,
+    const wchar_t* password,
+    const CompressionProfile& profile,
+    OperationStats* stats){
+    archive_error_ = ArchiveErrorTable::kOK;
+    profile_ = profile;
+    update_mode_ = ArchiveUpdateMode::kCreate;
+    stats_ = stats;
+    stored_items_ = nullptr;
+    filter_kinds_ = nullptr;
+    deferred_count_ = 0;
+    is_store_pass_ = false;
+    memory_items_ = &items;
+    out_buffer_ = &out;
+    errors_.clear();
+    password_.resize(0);
+    if (password){
+      password_ = password;
+    }
+    FILETIME now;
+    ::GetSystemTimeAsFileTime(&now);
+    //rows line up with items,GetStream serves item data by row
+    ItemTable ItemList;
+    ItemList.Reserve(items.size());
+    const uint32_t root = ItemList.AddRoot(L"", L"");
+    for (size_t i = 0; i < items.size(); i++) {
+      const uint64_t mtime = items[i].mtime ? items[i].mtime : ToTicks(now);
+      ItemList.Add(root, items[i].name, items[i].is_dir ? 0 : items[i].size, mtime, mtime, mtime,
+        items[i].is_dir ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_ARCHIVE, items[i].is_dir);
+    }
+    ItemList.EndRoot();
+    if (stats_) {
+      stats_->SetItemsTotal(ItemList.size());
+    }
+    //no store pass or content order,both work on files
+    ArchiveFile(ItemList, ext, L"");
   }
   Wrapper7zArchive::~Wrapper7zArchive(){
-    error_files_.resize(0);
+    errors_.clear();
     password_.resize(0);
   }
 
+  HRESULT Wrapper7zArchive::SetArchiveProperties(IOutArchive* out_archive, const std::wstring& ext) {
+    std::vector<CompressionProperty> props;
+    profile_.GetProperties(ext, props);
+    if (props.empty()) {
+      return S_OK;
+    }
+    CMyComPtr<ISetProperties> set_properties;
+    out_archive->QueryInterface(IID_ISetProperties, (void **)&set_properties);
+    if (!set_properties) {
+      return S_OK;
+    }
+    std::vector<const wchar_t*> names;
+    std::vector<NCOM::CPropVariant> values(props.size());
+    for (size_t i = 0; i < props.size(); i++) {
+      names.push_back(props[i].name.c_str());
+      switch (props[i].type) {
+      case CompressionProperty::Type::kNumber:
+        values[i] = (UInt32)props[i].number;
+        break;
+      case CompressionProperty::Type::kString:
+        values[i] = props[i].text.c_str();
+        break;
+      case CompressionProperty::Type::kBool:
+        values[i] = props[i].flag;
+        break;
+      }
+    }
+    return set_properties->SetProperties(&names[0], &values[0], (UInt32)props.size());
+  }
+
+  bool Wrapper7zArchive::OpenForUpdate(const GUID& class_id, const std::wstring& ext, const wchar_t* archive_name,
+    IInArchive** in_archive, ArchiveItemMatcher& matcher) {
+    CMyComPtr<IInArchive> archive;
+    if (CreateObject(&class_id, &IID_IInArchive, (void **)&archive) != S_OK) {
+      //fail
+      return true;
+    }
+    CInFileStream *inFileStreamSpec = new CInFileStream;
+    CMyComPtr<IInStream> inFileStream = inFileStreamSpec;
+    if (!inFileStreamSpec->Open(us2fs(archive_name))) {
+      //fail
+      return true;
+    }
+    const UInt64 scanSize = 1 << 23;
+    if (archive->Open(inFileStream, &scanSize, nullptr) != S_OK) {
+      //not this format or an encrypted header,rebuild from scratch
+      return true;
+    }
+    UInt32 numItems = 0;
+    archive->GetNumberOfItems(&numItems);
+    //the store pass matches what the first pass just wrote:7z and zip (NTFS
+    //extra field) keep the exact time,a tolerance could keep a file that
+    //changed in between
+    matcher.Reset((is_store_pass_ || ext == L"7z" || ext == L"wim") ? 0 : kUpdateTimeTolerance);
+    for (UInt32 i = 0; i < numItems; i++) {
+      NCOM::CPropVariant prop;
+      archive->GetProperty(i, kpidIsDir, &prop);
+      if (prop.vt == VT_BOOL && prop.boolVal != VARIANT_FALSE) {
+        //directories carry no data,they are always written anew
+        continue;
+      }
+      prop.Clear();
+      archive->GetProperty(i, kpidPath, &prop);
+      if (prop.vt != VT_BSTR) {
+        continue;
+      }
+      const std::wstring path = prop.bstrVal;
+      ArchivedItem item;
+      item.index = i;
+      item.size = 0;
+      item.mtime = 0;
+      item.crc = 0;
+      item.has_crc = false;
+      prop.Clear();
+      archive->GetProperty(i, kpidSize, &prop);
+      ConvertPropVariantToUInt64(prop, item.size);
+      prop.Clear();
+      archive->GetProperty(i, kpidMTime, &prop);
+      if (prop.vt == VT_FILETIME) {
+        item.mtime = ((UInt64)prop.filetime.dwHighDateTime << 32) | prop.filetime.dwLowDateTime;
+      }
+      prop.Clear();
+      archive->GetProperty(i, kpidCRC, &prop);
+      if (prop.vt == VT_UI4) {
+        item.crc = prop.ulVal;
+        item.has_crc = true;
+      }
+      matcher.Add(path, item);
+    }
+    *in_archive = archive.Detach();
+    //success
+    return false;
+  }
+
   //example
   /*
   CObjectVector<CDirItem> ItemList;
@@ -371,14 +741,7 @@ namespace compressor {
   GetArchiveItemFromFileList(fileList,ItemList);
   ArchiveFile(ItemList,L"File.7Z");
   */
-  void Wrapper7zArchive::ArchiveFile(CObjectVector<CDirItem> &dirItems, const std::wstring& ext, const wchar_t* ArchivePackPath) {
-    UString archiveName = ArchivePackPath;
-    COutFileStream *outFileStreamSpec = new COutFileStream;
-    CMyComPtr<IOutStream> outFileStream = outFileStreamSpec;
-    if (!outFileStreamSpec->Create(archiveName, true)){
-      archive_error_ = ArchiveErrorTable::kCreateArchiveFail;
-      return;
-    }
+  static GUID FindUpdateClassID(const std::wstring& ext) {
     UInt32 numFormats = 1;
     GetNumberOfFormats(&numFormats);
     GUID classID = {0};
@@ -402,91 +765,291 @@ namespace compressor {
       }
 
     }
+    return classID;
+  }
+
+  //what the tar handler writes for the table,long names counted as
+  //UTF-8 in a GNU LongLink entry
+  static UInt64 TarSizeBound(const ItemTable &dirItems) {
+    const UInt64 kBlock = 512;
+    UInt64 size = 2 * kBlock;
+    for (size_t i = 0; i < dirItems.size(); i++) {
+      size += kBlock + (dirItems.Size(i) + kBlock - 1) / kBlock * kBlock;
+      const UInt64 nameSize = dirItems.Path(i).size() * 3 + 1;
+      if (nameSize > 100)
+        size += kBlock + (nameSize + kBlock - 1) / kBlock * kBlock;
+    }
+    return size;
+  }
+
+  //name.tar.gz holds name.tar
+  static UString TarNameOf(const UString &archiveName) {
+    UString name = archiveName;
+    const int slashPos = name.ReverseFind_PathSepar();
+    if (slashPos >= 0)
+      name.DeleteFrontal(slashPos + 1);
+    const int dotPos = name.ReverseFind_Dot();
+    if (dotPos >= 0)
+      name.DeleteFrom(dotPos);
+    return name;
+  }
+
+  void Wrapper7zArchive::ArchiveFile(const ItemTable &dirItems, const std::wstring& ext, const wchar_t* ArchivePackPath) {
+    UString archiveName = ArchivePackPath;
+    //tar.gz/tar.xz/tar.bz2:the tar handler writes,a second stage compresses
+    const wchar_t *codec = CTarPipeline::CodecOf(ext);
+    const std::wstring handlerExt = codec ? std::wstring(L"tar") : ext;
+    GUID classID = FindUpdateClassID(handlerExt);
+    //an existing archive is updated in place:its handler copies the unchanged
+    //items and the result is written beside it,then renamed over it
+    CMyComPtr<IInArchive> inArchive;
+    ArchiveItemMatcher matcher;
+    bool isUpdate = false;
+    //a volume set or a memory archive is always written from scratch
+    const bool isVolumes = !out_buffer_ && (profile_.volume_size > 0);
+    if (!out_buffer_ && !isVolumes && update_mode_ != ArchiveUpdateMode::kCreate && ArchiveItemMatcher::IsUpdatable(ext) &&
+      NFind::DoesFileExist(us2fs(archiveName))) {
+      isUpdate = !OpenForUpdate(classID, ext, archiveName, &inArchive, matcher);
+    }
+    //declared first so it is destroyed last:the handler and the output
+    //streams may still hold prefetched buffers
+    FilePrefetcher prefetcher((size_t)profile_.read_ahead_size);
     CMyComPtr<IOutArchive> outArchive;
-    if (CreateObject(&classID, &IID_IOutArchive, (void **)&outArchive) != S_OK) {
+    if (isUpdate) {
+      inArchive.QueryInterface(IID_IOutArchive, &outArchive);
+      isUpdate = (outArchive != nullptr);
+    }
+    if (is_store_pass_ && !isUpdate) {
+      //rebuilding would drop what the first pass compressed
+      archive_error_ = ArchiveErrorTable::kCreateArchiveFail;
+      return;
+    }
+    if (!isUpdate && CreateObject(&classID, &IID_IOutArchive, (void **)&outArchive) != S_OK) {
       archive_error_ = ArchiveErrorTable::kGetClassObjectFail;
       return;
     }
+    if (SetArchiveProperties(outArchive, handlerExt) != S_OK) {
+      //a custom method/dictionary the handler does not accept
+      archive_error_ = ArchiveErrorTable::kSetPropertiesFail;
+      return;
+    }
+    //gzip goes through ParallelGzipWriter,7-Zip's Deflate has one thread
+    CMyComPtr<IOutArchive> codecArchive;
+    if (codec && wcscmp(codec, L"gzip")) {
+      const GUID codecClassID = FindUpdateClassID(codec);
+      if (CreateObject(&codecClassID, &IID_IOutArchive, (void **)&codecArchive) != S_OK) {
+        archive_error_ = ArchiveErrorTable::kGetClassObjectFail;
+        return;
+      }
+      if (SetArchiveProperties(codecArchive, codec) != S_OK) {
+        archive_error_ = ArchiveErrorTable::kSetPropertiesFail;
+        return;
+      }
+    }
+    const UString outName = isUpdate ? archiveName + L".tmp" : archiveName;
+    CMyComPtr<IOutStream> outFileStream;
+    COutFileStream *outFileStreamSpec = nullptr;
+    CMultiVolumeOutStream *volumeStreamSpec = nullptr;
+    const UInt64 *outProcessedSize = nullptr;
+    CMemoryOutStream *memoryStreamSpec = nullptr;
+    if (out_buffer_) {
+      memoryStreamSpec = new CMemoryOutStream(*out_buffer_);
+      outFileStream = memoryStreamSpec;
+      outProcessedSize = &memoryStreamSpec->ProcessedSize;
+    }
+    else if (isVolumes) {
+      //handlers never ask the callback for volumes,the stream splits the output
+      volumeStreamSpec = new CMultiVolumeOutStream(outName.Ptr(), profile_.volume_size, profile_.is_volume_manifest);
+      outFileStream = volumeStreamSpec;
+      outProcessedSize = &volumeStreamSpec->ProcessedSize;
+    }
+    else {
+      outFileStreamSpec = new COutFileStream;
+      outFileStream = outFileStreamSpec;
+      if (!outFileStreamSpec->Create(us2fs(outName), true)){
+        archive_error_ = ArchiveErrorTable::kCreateArchiveFail;
+        return;
+      }
+      outProcessedSize = &outFileStreamSpec->ProcessedSize;
+    }
+    CRecordVector<UInt32> archiveIndices;
+    if (isUpdate) {
+      const bool verifyCrc = (update_mode_ == ArchiveUpdateMode::kUpdateVerifyCrc);
+      for (size_t i = 0; i < dirItems.size(); i++) {
+        UInt32 archiveIndex = kNoArchiveIndex;
+        if (!dirItems.IsDir(i)) {
+          archiveIndex = matcher.Match(dirItems.Path(i), dirItems.Size(i), dirItems.MTime(i), dirItems.DiskPath(i), verifyCrc);
+        }
+        archiveIndices.Add(archiveIndex);
+      }
+    }
+    //a pass over part of the items names its rows,the table is not copied
+    CRecordVector<UInt32> passItems;
+    deferred_count_ = 0;
+    if (stored_items_) {
+      //stored files not in the archive yet wait for the store pass
+      CRecordVector<UInt32> passIndices;
+      for (size_t i = 0; i < dirItems.size(); i++) {
+        const bool isArchived = isUpdate && archiveIndices[(unsigned)i] != kNoArchiveIndex;
+        if ((*stored_items_)[i] && !isArchived) {
+          deferred_count_++;
+          continue;
+        }
+        passItems.Add((UInt32)i);
+        if (isUpdate)
+          passIndices.Add(archiveIndices[(unsigned)i]);
+      }
+      archiveIndices = passIndices;
+    }
+    const UInt32 numItems = stored_items_ ? passItems.Size() : (UInt32)dirItems.size();
     CArchiveUpdateCallback *updateCallbackSpec = new CArchiveUpdateCallback;
     CMyComPtr<IArchiveUpdateCallback2> updateCallback(updateCallbackSpec);
     updateCallbackSpec->Init(&dirItems);
+    if (stored_items_)
+      updateCallbackSpec->ItemIndices = passItems;
+    updateCallbackSpec->ArchiveIndices = archiveIndices;
+    updateCallbackSpec->Stats = stats_;
+    updateCallbackSpec->OutProcessedSize = outProcessedSize;
+    updateCallbackSpec->MemoryItems = memory_items_;
+    updateCallbackSpec->FilterKinds = filter_kinds_;
+    if (profile_.read_ahead_size && !memory_items_) {
+      //new data is asked for in item order within each filter group,unchanged
+      //items are copied by the handler
+      const size_t numGroups = filter_kinds_ ? sizeof(kFilterGroupOrder) / sizeof(kFilterGroupOrder[0]) : 1;
+      for (size_t group = 0; group < numGroups; group++) {
+        for (UInt32 i = 0; i < numItems; i++) {
+          const UInt32 itemIndex = updateCallbackSpec->ItemIndex(i);
+          if (filter_kinds_ && (*filter_kinds_)[itemIndex] != (uint8_t)kFilterGroupOrder[group]) {
+            continue;
+          }
+          if (!dirItems.IsDir(itemIndex) && (!isUpdate || archiveIndices[i] == kNoArchiveIndex)) {
+            prefetcher.Add(i, dirItems.DiskPath(itemIndex), dirItems.Size(itemIndex));
+          }
+        }
+      }
+      prefetcher.Start();
+      updateCallbackSpec->Prefetcher = &prefetcher;
+    }
     if (password_.length()){
       updateCallbackSpec->PasswordIsDefined = true;
       updateCallbackSpec->Password = password_.c_str();
     }
-    HRESULT result = outArchive->UpdateItems(outFileStream, dirItems.Size(), updateCallback);
+    HRESULT result = S_OK;
+    {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kEncode);
+      if (codec) {
+        FILETIME now;
+        ::GetSystemTimeAsFileTime(&now);
+        CTarPipeline pipeline(profile_);
+        pipeline.Start(codecArchive, outFileStream, TarNameOf(archiveName), TarSizeBound(dirItems), now);
+        result = outArchive->UpdateItems(pipeline.TarStream(), numItems, updateCallback);
+        result = pipeline.Finish(result);
+      }
+      else {
+        result = outArchive->UpdateItems(outFileStream, numItems, updateCallback);
+      }
+    }
     updateCallbackSpec->Finilize();
+    prefetcher.Stop();
+    if (stats_) {
+      stats_->SetBytesOut(*outProcessedSize);
+    }
+    {
+      OperationStats::ScopedPhase phase(stats_, OperationPhase::kClose);
+      if (volumeStreamSpec) {
+        if (result != S_OK) {
+          volumeStreamSpec->Discard();
+        }
+        else if (volumeStreamSpec->Close() != S_OK) {
+          archive_error_ = ArchiveErrorTable::kCreateArchiveFail;
+          return;
+        }
+      }
+      else if (memoryStreamSpec) {
+        if (result != S_OK) {
+          out_buffer_->clear();
+        }
+      }
+      else {
+        outFileStreamSpec->Close();
+      }
+    }
+    if (isUpdate) {
+      //release the source before replacing it
+      outArchive.Release();
+      inArchive->Close();
+      inArchive.Release();
+      if (result != S_OK ||
+        !::MoveFileExW(outName, archiveName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        ::DeleteFileW(outName);
+        archive_error_ = ArchiveErrorTable::kCreateArchiveFail;
+        return;
+      }
+    }
 
     if (result != S_OK){
+      //no archive for a store pass to add to
+      deferred_count_ = 0;
       return;
     }
     if (updateCallbackSpec->FailedFiles.Size()) {
       archive_error_ = ArchiveErrorTable::kGetClassObjectFail;
       for (uint32_t i = 0; i < updateCallbackSpec->FailedFiles.Size(); i++) {
-        //error_files_.push_back(updateCallbackSpec->FailedFiles[i]);
+        errors_[fs2us(updateCallbackSpec->FailedFiles[i]).Ptr()] = kArchiveReadFailed;
       }
     }
 
     return;
   }
-  void Wrapper7zArchive::GetArchiveItemFromPath(const wchar_t* strDirPath, 
-    const wchar_t* sub_name, 
-    CObjectVector<CDirItem> &dirItems) {
-    NFile::NFind::CFileInfo fi;
-    NFile::NFind::CFindFile TEST;
-    UString dirPath;
-    dirPath = strDirPath;
-    dirPath += "\\*.*";
-    TEST.FindFirst(dirPath, fi);
-    while (TEST.FindNext(fi))
-    {
-      if (fi.IsDots())
-      {
-        continue;
-      }
-      CDirItem di;
-      di.Attrib = fi.Attrib;
-      di.Size = fi.Size;
-      di.CTime = fi.CTime;
-      di.ATime = fi.ATime;
-      di.MTime = fi.MTime;
-      di.Name = sub_name;
-      di.Name += L"\\";
-      di.Name += fi.Name;
-      di.FullPath = strDirPath;
-      di.FullPath += L"\\";
-      di.FullPath += fi.Name;
-      dirItems.Add(di);
-      if (fi.Attrib&FILE_ATTRIBUTE_DIRECTORY) {
-        UString sub_dirPath;
-        sub_dirPath = di.FullPath;
-        UString sub_1 = sub_name;
-        sub_1 += L"\\";
-        sub_1 += fi.Name;
-        GetArchiveItemFromPath(sub_dirPath, sub_1, dirItems);
-      }
+  size_t Wrapper7zArchive::SelectStored(const ItemTable &dirItems, std::vector<uint8_t>& stored) {
+    MethodSelector selector;
+    return selector.Select(dirItems, stored);
+  }
+  size_t Wrapper7zArchive::SniffFilters(const ItemTable &dirItems, std::vector<uint8_t>& kinds) {
+    FilterSniffer sniffer;
+    for (size_t i = 0; i < dirItems.size(); i++) {
+      sniffer.Add(dirItems.DiskPath(i), dirItems.Size(i), dirItems.IsDir(i));
     }
+    return sniffer.Sniff(kinds);
+  }
+  void Wrapper7zArchive::OrderItems(ItemTable &dirItems) {
+    ItemOrderer orderer;
+    std::vector<uint32_t> order;
+    orderer.Build(dirItems, order);
+    dirItems.Permute(order);
   }
-  void Wrapper7zArchive::GetArchiveItemFromFileList(CObjectVector<UString> FileList, CObjectVector<CDirItem> &ItemList) {
+  void Wrapper7zArchive::GetArchiveItemFromFileList(const CObjectVector<UString>& FileList, ItemTable &ItemList) {
+    //every folder is listed on one set of scanner threads,the roots go into
+    //the table in FileList order
+    DirScanner scanner;
     NFile::NFind::CFileInfo fi;
     for (uint32_t i = 0;i < FileList.Size();i++)
     {
       fi.Find(FileList[i]);
       if (fi.Attrib&FILE_ATTRIBUTE_DIRECTORY){
-        //FIXME:exist bug?
-        GetArchiveItemFromPath(FileList[i], fi.Name, ItemList);
+        scanner.AddRoot(FileList[i].Ptr(), fi.Name.Ptr());
         continue;
       }
       else {
-        CDirItem di;
-        di.Attrib = fi.Attrib;
-        di.Size = fi.Size;
-        di.CTime = fi.CTime;
-        di.ATime = fi.ATime;
-        di.MTime = fi.MTime;
-        di.Name = fi.Name;
-        di.FullPath = FileList[i];
-        ItemList.Add(di);
+        //the file's directory is the root,single files from one folder share it
+        const std::wstring path = FileList[i].Ptr();
+        const size_t separator = path.find_last_of(L"\\/");
+        ScanEntry entry;
+        entry.name = fi.Name.Ptr();
+        entry.size = fi.Size;
+        entry.ctime = ToTicks(fi.CTime);
+        entry.atime = ToTicks(fi.ATime);
+        entry.mtime = ToTicks(fi.MTime);
+        entry.attrib = fi.Attrib;
+        entry.root = 0;
+        entry.is_dir = false;
+        scanner.AddFile(separator == std::wstring::npos ? std::wstring() : path.substr(0, separator), entry);
+      }
+    }
+    if (scanner.Scan(ItemList)) {
+      //unreadable subdirectories,archive what could be listed
+      for (size_t j = 0; j < scanner.failed_paths().size(); j++) {
+        errors_[scanner.failed_paths()[j]] = kArchiveScanFailed;
       }
     }
     return;
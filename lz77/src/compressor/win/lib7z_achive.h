@@ -3,7 +3,13 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <wtypes.h>
+#include "compressor/operation_stats.h"
+#include "compressor/compression_profile.h"
+#include "compressor/archive_update.h"
+#include "compressor/memory_archive.h"
+#include "compressor/item_table.h"
 
 #if defined(OS_WIN)
 #include "CPP/Common/MyWindows.h"
@@ -11,23 +17,10 @@
 #include "CPP/Common/MyString.h"
 #endif
 
-namespace compressor {
-
-  //////////////////////////////////////////////////////////////
-  // Archive Creating callback class
+struct IOutArchive;
+struct IInArchive;
 
-  struct CDirItem
-  {
-    UInt64 Size;
-    FILETIME CTime;
-    FILETIME ATime;
-    FILETIME MTime;
-    UString Name;
-    FString FullPath;
-    UInt32 Attrib;
-
-    bool isDir() const { return (Attrib & FILE_ATTRIBUTE_DIRECTORY) != 0; }
-  };
+namespace compressor {
 
   class Wrapper7zArchive
   {
@@ -37,21 +30,44 @@ namespace compressor {
       kOK,
       kCreateArchiveFail,
       kGetClassObjectFail,
+      kSetPropertiesFail,
       kExistErrorFile
     };
-    Wrapper7zArchive(const std::vector<std::wstring>& target, const std::wstring& out,const std::wstring& ext,const wchar_t* password);
+    Wrapper7zArchive(const std::vector<std::wstring>& target, const std::wstring& out,const std::wstring& ext,const wchar_t* password,
+      const CompressionProfile& profile, ArchiveUpdateMode update_mode, OperationStats* stats = nullptr);
+    //builds the archive in out,the item data is read in place
+    Wrapper7zArchive(const std::vector<MemoryItem>& items, std::vector<uint8_t>& out, const std::wstring& ext,
+      const wchar_t* password, const CompressionProfile& profile, OperationStats* stats = nullptr);
     virtual ~Wrapper7zArchive();
     const ArchiveErrorTable& archive_error() const {
       return archive_error_;
     }
+    //paths left out of the archive and why,also when archive_error() is kOK
+    const std::map<std::wstring, std::wstring>& errors() const {
+      return errors_;
+    }
   private:
-    void ArchiveFile(CObjectVector<CDirItem> &dirItems, const std::wstring& ext, const wchar_t* ArchivePackPath);
-    void GetArchiveItemFromPath(const wchar_t* strDirPath,const wchar_t* sub_name, CObjectVector<CDirItem> &dirItems);
-    void GetArchiveItemFromFileList(CObjectVector<UString> FileList, CObjectVector<CDirItem> &ItemList);
+    HRESULT SetArchiveProperties(IOutArchive* out_archive, const std::wstring& ext);
+    bool OpenForUpdate(const GUID& class_id, const std::wstring& ext, const wchar_t* archive_name,
+      IInArchive** in_archive, ArchiveItemMatcher& matcher);
+    void ArchiveFile(const ItemTable &dirItems, const std::wstring& ext, const wchar_t* ArchivePackPath);
+    void OrderItems(ItemTable &dirItems);
+    size_t SelectStored(const ItemTable &dirItems, std::vector<uint8_t>& stored);
+    size_t SniffFilters(const ItemTable &dirItems, std::vector<uint8_t>& kinds);
+    void GetArchiveItemFromFileList(const CObjectVector<UString>& FileList, ItemTable &ItemList);
 
     ArchiveErrorTable archive_error_;
-    std::vector<UString> error_files_;
+    std::map<std::wstring, std::wstring> errors_;
     std::wstring password_;
+    CompressionProfile profile_;
+    ArchiveUpdateMode update_mode_;
+    OperationStats* stats_;
+    const std::vector<uint8_t>* stored_items_; //per item,left to the store pass
+    size_t deferred_count_; //stored items the last pass left out
+    bool is_store_pass_; //adding to the first pass's output,never rebuilt
+    const std::vector<uint8_t>* filter_kinds_; //per item,FilterKind from the header sniff
+    const std::vector<MemoryItem>* memory_items_;
+    std::vector<uint8_t>* out_buffer_; //archive to memory instead of ArchivePackPath
   };
 
 }
@@ -0,0 +1,365 @@
+#include "compressor/win/multi_volume_stream.h"
+#include <algorithm>
+#include <cstdio>
+#include <zlib.h>
+
+namespace compressor {
+
+  CMultiVolumeOutStream::CMultiVolumeOutStream(const std::wstring& base_name,
+    uint64_t volume_size,
+    bool has_manifest) {
+    ProcessedSize = 0;
+    base_name_ = base_name;
+    volume_size_ = volume_size ? volume_size : 1;
+    has_manifest_ = has_manifest;
+    pos_ = 0;
+    length_ = 0;
+    write_index_ = 0;
+    is_stopping_ = false;
+    closer_ = std::thread(&CMultiVolumeOutStream::CloserMain, this);
+  }
+  CMultiVolumeOutStream::~CMultiVolumeOutStream() {
+    Close();
+  }
+  std::wstring CMultiVolumeOutStream::VolumePath(size_t index) const {
+    std::wstring number = std::to_wstring(index + 1);
+    if (number.size() < kVolumeIndexDigits) {
+      number.insert(0, kVolumeIndexDigits - number.size(), L'0');
+    }
+    return base_name_ + L"." + number;
+  }
+  uint32_t CMultiVolumeOutStream::PatchCrc(uint32_t crc, const Byte* old_data, const Byte* new_data,
+    size_t size, uint64_t tail) {
+    //crc32 is affine:crc(a^b) = crc(a)^crc(b)^crc(0..0) for equal lengths,
+    //so a rewrite only needs the old bytes,shifted over the bytes after them
+    std::vector<Byte> delta(size);
+    for (size_t i = 0; i < size; i++) {
+      delta[i] = old_data[i] ^ new_data[i];
+    }
+    uLong change = crc32(0L, &delta[0], (uInt)size);
+    std::fill(delta.begin(), delta.end(), 0);
+    change ^= crc32(0L, &delta[0], (uInt)size);
+    //z_off_t is 32 bits on Windows,shift in steps
+    while (tail > 0) {
+      const uint64_t step = (std::min)(tail, (uint64_t)kVolumeCrcShiftStep);
+      change = crc32_combine(change, 0, (z_off_t)step);
+      tail -= step;
+    }
+    return crc ^ (uint32_t)change;
+  }
+  HRESULT CMultiVolumeOutStream::CloseVolumeFile(HANDLE file) {
+    //the flush is the slow part,that is why it runs off the encoder thread;
+    //a delayed write failure only shows up here
+    HRESULT result = S_OK;
+    if (!::FlushFileBuffers(file)) {
+      result = HRESULT_FROM_WIN32(::GetLastError());
+    }
+    if (!::CloseHandle(file) && result == S_OK) {
+      result = HRESULT_FROM_WIN32(::GetLastError());
+    }
+    return result;
+  }
+  void CMultiVolumeOutStream::CloserMain() {
+    for (;;) {
+      size_t index = 0;
+      HANDLE file = INVALID_HANDLE_VALUE;
+      {
+        std::unique_lock<std::mutex> lock(lock_);
+        queued_.wait(lock, [this]() { return is_stopping_ || !close_queue_.empty(); });
+        if (close_queue_.empty()) {
+          return;
+        }
+        index = close_queue_.front();
+        close_queue_.pop_front();
+        file = volumes_[index].file;
+      }
+      const HRESULT result = CloseVolumeFile(file);
+      {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (volumes_[index].close_result == S_OK) {
+          volumes_[index].close_result = result;
+        }
+        volumes_[index].file = INVALID_HANDLE_VALUE;
+        volumes_[index].state = VolumeState::kClosed;
+      }
+      closed_.notify_all();
+    }
+  }
+  void CMultiVolumeOutStream::WaitClosed(std::unique_lock<std::mutex>& lock, size_t index) {
+    closed_.wait(lock, [this, index]() { return volumes_[index].state != VolumeState::kClosing; });
+  }
+  void CMultiVolumeOutStream::RetireVolumes(size_t current) {
+    //volume 0 stays,7z seeks back to it for the start header
+    bool is_queued = false;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      for (size_t i = 1; i < current && i < volumes_.size(); i++) {
+        if (volumes_[i].state == VolumeState::kOpen) {
+          volumes_[i].state = VolumeState::kClosing;
+          close_queue_.push_back(i);
+          is_queued = true;
+        }
+      }
+    }
+    if (is_queued) {
+      queued_.notify_one();
+    }
+  }
+  HRESULT CMultiVolumeOutStream::PrepareVolume(size_t index, uint64_t offset) {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (volumes_.size() <= index) {
+      VolumeFile volume;
+      volume.path = VolumePath(volumes_.size());
+      volume.file = INVALID_HANDLE_VALUE;
+      volume.file_pos = 0;
+      volume.size = 0;
+      volume.crc = 0;
+      volume.is_dirty = false;
+      volume.is_created = false;
+      volume.state = VolumeState::kClosed;
+      volume.close_result = S_OK;
+      volumes_.push_back(volume);
+    }
+    WaitClosed(lock, index);
+    VolumeFile& volume = volumes_[index];
+    if (volume.state == VolumeState::kClosed) {
+      volume.file = ::CreateFileW(volume.path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        volume.is_created ? OPEN_EXISTING : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (volume.file == INVALID_HANDLE_VALUE) {
+        return HRESULT_FROM_WIN32(::GetLastError());
+      }
+      volume.is_created = true;
+      volume.file_pos = 0;
+      volume.state = VolumeState::kOpen;
+    }
+    if (volume.file_pos != offset) {
+      LARGE_INTEGER distance;
+      distance.QuadPart = (LONGLONG)offset;
+      if (!::SetFilePointerEx(volume.file, distance, nullptr, FILE_BEGIN)) {
+        return HRESULT_FROM_WIN32(::GetLastError());
+      }
+      volume.file_pos = offset;
+    }
+    return S_OK;
+  }
+
+  HRESULT CMultiVolumeOutStream::FillGap(VolumeFile& volume, uint64_t offset) {
+    //a seek past the end of the volume:write the hole out as zeros,so the
+    //running CRC covers it and the file holds no undefined bytes
+    LARGE_INTEGER distance;
+    distance.QuadPart = (LONGLONG)volume.size;
+    if (!::SetFilePointerEx(volume.file, distance, nullptr, FILE_BEGIN)) {
+      return HRESULT_FROM_WIN32(::GetLastError());
+    }
+    volume.file_pos = volume.size;
+    rewrite_buffer_.assign((size_t)(std::min)(offset - volume.size, (uint64_t)kVolumeCrcBufferSize), 0);
+    while (volume.size < offset) {
+      const DWORD chunk = (DWORD)(std::min)(offset - volume.size, (uint64_t)rewrite_buffer_.size());
+      DWORD written = 0;
+      if (!::WriteFile(volume.file, &rewrite_buffer_[0], chunk, &written, nullptr)) {
+        return HRESULT_FROM_WIN32(::GetLastError());
+      }
+      if (written == 0) {
+        return E_FAIL;
+      }
+      if (has_manifest_ && !volume.is_dirty) {
+        volume.crc = (uint32_t)crc32(volume.crc, &rewrite_buffer_[0], written);
+      }
+      volume.file_pos += written;
+      volume.size += written;
+    }
+    return S_OK;
+  }
+
+  STDMETHODIMP CMultiVolumeOutStream::Write(const void *data, UInt32 size, UInt32 *processedSize)
+  {
+    if (processedSize)
+      *processedSize = 0;
+    const Byte *bytes = (const Byte *)data;
+    while (size > 0)
+    {
+      const size_t index = (size_t)(pos_ / volume_size_);
+      const uint64_t offset = pos_ % volume_size_;
+      if (index > write_index_)
+        RetireVolumes(index);
+      write_index_ = index;
+      RINOK(PrepareVolume(index, offset));
+      // the encoder thread is the only one touching an open volume
+      VolumeFile &volume = volumes_[index];
+      if (offset > volume.size)
+        RINOK(FillGap(volume, offset));
+      const UInt32 chunk = (UInt32)(std::min)((uint64_t)size, volume_size_ - offset);
+      // bytes already in the volume (7z start header,zip local headers):
+      // keep the old ones to patch the running CRC
+      const UInt32 overlap = (offset < volume.size) ? (UInt32)(std::min)((uint64_t)chunk, volume.size - offset) : 0;
+      if (overlap && has_manifest_ && !volume.is_dirty)
+      {
+        DWORD read = 0;
+        rewrite_buffer_.resize(overlap);
+        if (!::ReadFile(volume.file, &rewrite_buffer_[0], overlap, &read, nullptr) || read != overlap)
+          volume.is_dirty = true;
+        // the read moved the file pointer by however much it got,the
+        // write below must still land at offset
+        LARGE_INTEGER distance;
+        distance.QuadPart = (LONGLONG)offset;
+        if (!::SetFilePointerEx(volume.file, distance, nullptr, FILE_BEGIN))
+          return HRESULT_FROM_WIN32(::GetLastError());
+      }
+      DWORD written = 0;
+      if (!::WriteFile(volume.file, bytes, chunk, &written, nullptr))
+        return HRESULT_FROM_WIN32(::GetLastError());
+      if (written == 0)
+        return E_FAIL;
+      if (written != chunk)
+        volume.is_dirty = true;
+      if (has_manifest_ && !volume.is_dirty)
+      {
+        if (overlap)
+          volume.crc = PatchCrc(volume.crc, &rewrite_buffer_[0], bytes, overlap, volume.size - offset - overlap);
+        if (written > overlap)
+          volume.crc = (uint32_t)crc32(volume.crc, bytes + overlap, written - overlap);
+      }
+      volume.file_pos += written;
+      volume.size = (std::max)(volume.size, offset + written);
+      pos_ += written;
+      length_ = (std::max)(length_, pos_);
+      ProcessedSize += written;
+      bytes += written;
+      size -= written;
+      if (processedSize)
+        *processedSize += written;
+    }
+    return S_OK;
+  }
+
+  STDMETHODIMP CMultiVolumeOutStream::Seek(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition)
+  {
+    switch (seekOrigin)
+    {
+      case STREAM_SEEK_SET: break;
+      case STREAM_SEEK_CUR: offset += pos_; break;
+      case STREAM_SEEK_END: offset += length_; break;
+      default: return STG_E_INVALIDFUNCTION;
+    }
+    if (offset < 0)
+      return HRESULT_WIN32_ERROR_NEGATIVE_SEEK;
+    // no file work here,the next Write opens the volume it lands in
+    pos_ = (uint64_t)offset;
+    if (newPosition)
+      *newPosition = pos_;
+    return S_OK;
+  }
+
+  STDMETHODIMP CMultiVolumeOutStream::SetSize(UInt64 newSize)
+  {
+    const size_t last = (size_t)(newSize ? (newSize - 1) / volume_size_ : 0);
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      while (volumes_.size() > last + 1)
+      {
+        WaitClosed(lock, volumes_.size() - 1);
+        VolumeFile &volume = volumes_.back();
+        if (volume.state == VolumeState::kOpen)
+          ::CloseHandle(volume.file);
+        if (volume.is_created)
+          ::DeleteFileW(volume.path.c_str());
+        volumes_.pop_back();
+      }
+    }
+    length_ = newSize;
+    if (volumes_.size() <= last)
+      return S_OK;
+    const uint64_t volumeSize = newSize - (uint64_t)last * volume_size_;
+    RINOK(PrepareVolume(last, volumeSize));
+    VolumeFile &volume = volumes_[last];
+    if (!::SetEndOfFile(volume.file))
+      return HRESULT_FROM_WIN32(::GetLastError());
+    // truncated or zero-extended,the running CRC no longer covers the file
+    if (volumeSize != volume.size)
+      volume.is_dirty = true;
+    volume.size = volumeSize;
+    return S_OK;
+  }
+
+  HRESULT CMultiVolumeOutStream::Close() {
+    if (!closer_.joinable()) {
+      return S_OK;
+    }
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      for (size_t i = 0; i < volumes_.size(); i++) {
+        if (volumes_[i].state == VolumeState::kOpen) {
+          volumes_[i].state = VolumeState::kClosing;
+          close_queue_.push_back(i);
+        }
+      }
+      is_stopping_ = true;
+    }
+    queued_.notify_one();
+    closer_.join();
+    for (size_t i = 0; i < volumes_.size(); i++) {
+      if (volumes_[i].close_result != S_OK) {
+        return volumes_[i].close_result;
+      }
+    }
+    if (!has_manifest_) {
+      return S_OK;
+    }
+    for (size_t i = 0; i < volumes_.size(); i++) {
+      if (volumes_[i].is_dirty && VolumeCrc(volumes_[i].path, volumes_[i].crc)) {
+        return E_FAIL;
+      }
+    }
+    return WriteManifest() ? E_FAIL : S_OK;
+  }
+  void CMultiVolumeOutStream::Discard() {
+    has_manifest_ = false;
+    Close();
+    for (size_t i = 0; i < volumes_.size(); i++) {
+      if (volumes_[i].is_created) {
+        ::DeleteFileW(volumes_[i].path.c_str());
+      }
+    }
+    volumes_.clear();
+  }
+  bool CMultiVolumeOutStream::VolumeCrc(const std::wstring& path, uint32_t& crc) {
+    FILE* file = _wfopen(path.c_str(), L"rb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    std::vector<uint8_t> buffer(kVolumeCrcBufferSize);
+    uLong value = crc32(0L, Z_NULL, 0);
+    size_t count = 0;
+    while ((count = fread(&buffer[0], 1, buffer.size(), file)) > 0) {
+      value = crc32(value, &buffer[0], (uInt)count);
+    }
+    const bool fail = ferror(file) != 0;
+    fclose(file);
+    crc = (uint32_t)value;
+    return fail;
+  }
+  bool CMultiVolumeOutStream::WriteManifest() {
+    const std::wstring manifest_path = base_name_ + kVolumeManifestExt;
+    FILE* file = _wfopen(manifest_path.c_str(), L"wb");
+    if (!file) {
+      //fail
+      return true;
+    }
+    bool fail = false;
+    for (size_t i = 0; i < volumes_.size() && !fail; i++) {
+      //names relative to the manifest,as sfv checkers expect
+      const std::wstring& path = volumes_[i].path;
+      const std::wstring name = path.substr(path.find_last_of(L"\\/") + 1);
+      char utf8_name[MAX_PATH * 3] = { 0 };
+      ::WideCharToMultiByte(CP_UTF8, 0, name.c_str(), -1, utf8_name, sizeof(utf8_name), nullptr, nullptr);
+      fail = fprintf(file, "%s %08X\r\n", utf8_name, volumes_[i].crc) < 0;
+    }
+    fail = (fclose(file) != 0) || fail;
+    if (fail) {
+      ::DeleteFileW(manifest_path.c_str());
+    }
+    return fail;
+  }
+
+}
@@ -0,0 +1,93 @@
+#ifndef COMPRESSOR_WIN_MULTI_VOLUME_STREAM_H_
+#define COMPRESSOR_WIN_MULTI_VOLUME_STREAM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <windows.h>
+
+#include "CPP/Common/MyCom.h"
+#include "CPP/7zip/IStream.h"
+
+namespace compressor {
+
+  //name.7z.001,name.7z.002... as 7-Zip writes them
+  static const unsigned int kVolumeIndexDigits = 3;
+  //CRC32 per volume,one "name crc" line each
+  static const wchar_t * const kVolumeManifestExt = L".sfv";
+  static const size_t kVolumeCrcBufferSize = 1024 * 1024;
+  static const uint32_t kVolumeCrcShiftStep = 1u << 30;
+
+  enum class VolumeState { kOpen, kClosing, kClosed };
+
+  struct VolumeFile
+  {
+    std::wstring path;
+    HANDLE file;
+    uint64_t file_pos;
+    uint64_t size;
+    uint32_t crc; //running,patched on rewrites
+    bool is_dirty; //crc lost (truncated,short write),Close() recomputes it
+    bool is_created;
+    VolumeState state;
+    HRESULT close_result; //first failed flush/close,Close() returns it
+  };
+
+  //IOutStream over a volume set,the 7-Zip Update.cpp way:handlers see one
+  //seekable stream. Once the encoder moves past a volume it is flushed and
+  //closed on a background thread;volume 0 stays open because 7z rewrites
+  //its start header there at the end. A seek back into a closed volume
+  //reopens it. CRCs for the optional .sfv manifest are kept while writing,
+  //so Close() does not read the volumes back.
+  class CMultiVolumeOutStream :
+    public IOutStream,
+    public CMyUnknownImp
+  {
+  public:
+    MY_UNKNOWN_IMP1(IOutStream)
+
+    STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize);
+    STDMETHOD(Seek)(Int64 offset, UInt32 seekOrigin, UInt64 *newPosition);
+    STDMETHOD(SetSize)(UInt64 newSize);
+
+    CMultiVolumeOutStream(const std::wstring& base_name, uint64_t volume_size, bool has_manifest);
+    virtual ~CMultiVolumeOutStream();
+    HRESULT Close();
+    //closes and deletes every volume written so far,for a failed job
+    void Discard();
+    UInt64 ProcessedSize;
+  private:
+    std::wstring VolumePath(size_t index) const;
+    HRESULT PrepareVolume(size_t index, uint64_t offset);
+    HRESULT FillGap(VolumeFile& volume, uint64_t offset);
+    void WaitClosed(std::unique_lock<std::mutex>& lock, size_t index);
+    void RetireVolumes(size_t current);
+    void CloserMain();
+    static uint32_t PatchCrc(uint32_t crc, const Byte* old_data, const Byte* new_data,
+      size_t size, uint64_t tail);
+    static HRESULT CloseVolumeFile(HANDLE file);
+    static bool VolumeCrc(const std::wstring& path, uint32_t& crc);
+    bool WriteManifest();
+    std::wstring base_name_;
+    uint64_t volume_size_;
+    bool has_manifest_;
+    uint64_t pos_;
+    uint64_t length_;
+    size_t write_index_;
+    std::vector<VolumeFile> volumes_;
+    std::vector<Byte> rewrite_buffer_;
+    std::mutex lock_;
+    std::condition_variable closed_;
+    std::condition_variable queued_;
+    std::deque<size_t> close_queue_;
+    std::thread closer_;
+    bool is_stopping_;
+  };
+
+}
+
+#endif // !COMPRESSOR_WIN_MULTI_VOLUME_STREAM_H_
@@ -0,0 +1,190 @@
+#include "compressor/win/tar_pipeline.h"
+#include "compressor/parallel_gzip.h"
+
+#include "CPP/Common/MyWindows.h"
+#include "CPP/Windows/PropVariant.h"
+#include "CPP/7zip/Archive/IArchive.h"
+#include "CPP/7zip/Common/StreamUtils.h"
+
+namespace compressor {
+
+  using namespace NWindows;
+
+  //100ns ticks from 1601 to 1970
+  static const UInt64 kUnixEpochTicks = 116444736000000000ULL;
+
+  // tar handler output,into the ring
+  class CRingOutStream :
+    public ISequentialOutStream,
+    public CMyUnknownImp
+  {
+    ByteRing *_ring;
+  public:
+    CRingOutStream(ByteRing *ring) : _ring(ring) {}
+    MY_UNKNOWN_IMP
+
+    STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize)
+    {
+      if (processedSize)
+        *processedSize = 0;
+      // the codec gave up,stop the tar handler
+      if (_ring->Write(data, size))
+        return E_ABORT;
+      if (processedSize)
+        *processedSize = size;
+      return S_OK;
+    }
+  };
+
+  // codec handler input,out of the ring
+  class CRingInStream :
+    public ISequentialInStream,
+    public CMyUnknownImp
+  {
+    ByteRing *_ring;
+  public:
+    CRingInStream(ByteRing *ring) : _ring(ring) {}
+    MY_UNKNOWN_IMP
+
+    STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize)
+    {
+      const size_t n = _ring->Read(data, size);
+      if (processedSize)
+        *processedSize = (UInt32)n;
+      // a broken tar is not a short one
+      if (n == 0 && (_ring->is_write_failed() || _ring->is_aborted()))
+        return E_ABORT;
+      return S_OK;
+    }
+  };
+
+  // the one item an xz/bzip2 handler is given:the tar as it is written
+  class CTarStreamUpdateCallback :
+    public IArchiveUpdateCallback,
+    public CMyUnknownImp
+  {
+    ByteRing *_ring;
+    UString _name;
+    UInt64 _size;
+    FILETIME _mtime;
+  public:
+    CTarStreamUpdateCallback(ByteRing *ring, const UString &name, UInt64 size, const FILETIME &mtime) :
+      _ring(ring), _name(name), _size(size), _mtime(mtime) {}
+    MY_UNKNOWN_IMP1(IArchiveUpdateCallback)
+
+    // progress is reported by the tar pass,which sees the input files
+    STDMETHOD(SetTotal)(UInt64 /* size */) { return S_OK; }
+    STDMETHOD(SetCompleted)(const UInt64 * /* completeValue */) { return S_OK; }
+
+    STDMETHOD(GetUpdateItemInfo)(UInt32 /* index */, Int32 *newData, Int32 *newProperties, UInt32 *indexInArchive)
+    {
+      if (newData)
+        *newData = 1;
+      if (newProperties)
+        *newProperties = 1;
+      if (indexInArchive)
+        *indexInArchive = (UInt32)(Int32)-1;
+      return S_OK;
+    }
+    STDMETHOD(GetProperty)(UInt32 /* index */, PROPID propID, PROPVARIANT *value)
+    {
+      NCOM::CPropVariant prop;
+      switch (propID)
+      {
+      case kpidPath: if (!_name.IsEmpty()) prop = _name.Ptr(); break;
+      case kpidIsDir: prop = false; break;
+      case kpidIsAnti: prop = false; break;
+      case kpidSize: prop = _size; break;
+      case kpidMTime: prop = _mtime; break;
+      }
+      prop.Detach(value);
+      return S_OK;
+    }
+    STDMETHOD(GetStream)(UInt32 /* index */, ISequentialInStream **inStream)
+    {
+      CMyComPtr<ISequentialInStream> inStreamLoc(new CRingInStream(_ring));
+      *inStream = inStreamLoc.Detach();
+      return S_OK;
+    }
+    STDMETHOD(SetOperationResult)(Int32 /* operationResult */) { return S_OK; }
+  };
+
+  class StreamGzipSink : public GzipSink
+  {
+  public:
+    explicit StreamGzipSink(ISequentialOutStream* stream) : stream_(stream) {}
+    virtual bool Write(const void* data, size_t size) {
+      return WriteStream(stream_, data, size) != S_OK;
+    }
+  private:
+    ISequentialOutStream* stream_;
+  };
+
+  CTarPipeline::CTarPipeline(const CompressionProfile& profile) : ring_(kTarPipelineRingSize) {
+    tar_stream_ = new CRingOutStream(&ring_);
+    tar_size_ = 0;
+    mtime_.dwLowDateTime = 0;
+    mtime_.dwHighDateTime = 0;
+    level_ = (int)profile.EffectiveLevel();
+    num_threads_ = profile.EffectiveThreads();
+    codec_result_ = S_OK;
+  }
+  CTarPipeline::~CTarPipeline() {
+    if (codec_thread_.joinable()) {
+      //Finish() was never called,do not leave the codec waiting for data
+      ring_.Abort();
+      codec_thread_.join();
+    }
+  }
+  const wchar_t* CTarPipeline::CodecOf(const std::wstring& ext) {
+    for (size_t i = 0; kTarPipelineTable[i] != nullptr; i += 2) {
+      if (ext == kTarPipelineTable[i]) {
+        return kTarPipelineTable[i + 1];
+      }
+    }
+    return nullptr;
+  }
+  HRESULT CTarPipeline::Start(IOutArchive* codec_archive, ISequentialOutStream* out_stream,
+    const UString& tar_name, UInt64 tar_size, const FILETIME& mtime) {
+    codec_archive_ = codec_archive;
+    out_stream_ = out_stream;
+    tar_name_ = tar_name;
+    tar_size_ = tar_size;
+    mtime_ = mtime;
+    codec_result_ = S_OK;
+    codec_thread_ = std::thread(&CTarPipeline::CodecMain, this);
+    return S_OK;
+  }
+  void CTarPipeline::CodecMain() {
+    if (codec_archive_) {
+      CTarStreamUpdateCallback *callbackSpec = new CTarStreamUpdateCallback(&ring_, tar_name_, tar_size_, mtime_);
+      CMyComPtr<IArchiveUpdateCallback> callback(callbackSpec);
+      codec_result_ = codec_archive_->UpdateItems(out_stream_, 1, callback);
+    }
+    else {
+      const UInt64 ticks = ((UInt64)mtime_.dwHighDateTime << 32) | mtime_.dwLowDateTime;
+      const uint32_t unix_time = ticks > kUnixEpochTicks ? (uint32_t)((ticks - kUnixEpochTicks) / 10000000) : 0;
+      StreamGzipSink sink(out_stream_);
+      ParallelGzipWriter writer(level_, num_threads_);
+      codec_result_ = writer.Encode(&ring_, &sink, unix_time) ? E_FAIL : S_OK;
+    }
+    if (codec_result_ != S_OK) {
+      //the tar handler may be blocked on a full ring
+      ring_.Abort();
+    }
+  }
+  HRESULT CTarPipeline::Finish(HRESULT tar_result) {
+    if (!codec_thread_.joinable()) {
+      return tar_result;
+    }
+    ring_.CloseWrite(tar_result != S_OK);
+    codec_thread_.join();
+    codec_archive_.Release();
+    out_stream_.Release();
+    if (tar_result != S_OK) {
+      return tar_result;
+    }
+    return codec_result_;
+  }
+
+}
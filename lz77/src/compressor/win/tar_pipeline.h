@@ -0,0 +1,67 @@
+#ifndef COMPRESSOR_WIN_TAR_PIPELINE_H_
+#define COMPRESSOR_WIN_TAR_PIPELINE_H_
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <windows.h>
+
+#include "compressor/byte_ring.h"
+#include "compressor/compression_profile.h"
+
+#include "CPP/Common/MyCom.h"
+#include "CPP/Common/MyString.h"
+#include "CPP/7zip/IStream.h"
+
+struct IOutArchive;
+
+namespace compressor {
+
+  //pipelined format,then the single-stream handler the tar goes through
+  static const wchar_t *kTarPipelineTable[] = {
+    L"tar.gz", L"gzip",
+    L"tar.xz", L"xz",
+    L"tar.bz2", L"bzip2",
+    nullptr };
+  static const size_t kTarPipelineRingSize = 8 * 1024 * 1024;
+
+  //tar.gz/tar.xz/tar.bz2 in one pass. The tar handler writes into a ring and
+  //a second stage compresses it into the real output on its own thread:the
+  //xz/bzip2 handler with its block threads,or ParallelGzipWriter for gzip,
+  //since 7-Zip's Deflate runs on one core. Either side failing aborts the
+  //ring,so the other one never waits on it forever.
+  class CTarPipeline
+  {
+  public:
+    explicit CTarPipeline(const CompressionProfile& profile);
+    virtual ~CTarPipeline();
+    //the handler name behind a pipelined format,nullptr for any other
+    static const wchar_t* CodecOf(const std::wstring& ext);
+    //codec_archive is the configured xz/bzip2 handler,nullptr for gzip.
+    //tar_size only has to be an upper bound,xz shrinks its dictionary to it
+    HRESULT Start(IOutArchive* codec_archive, ISequentialOutStream* out_stream,
+      const UString& tar_name, UInt64 tar_size, const FILETIME& mtime);
+    //what the tar handler writes to
+    ISequentialOutStream* TarStream() const {
+      return tar_stream_;
+    }
+    //ends the ring once the tar handler returned,then waits for the codec
+    HRESULT Finish(HRESULT tar_result);
+  private:
+    void CodecMain();
+    ByteRing ring_;
+    CMyComPtr<ISequentialOutStream> tar_stream_;
+    CMyComPtr<IOutArchive> codec_archive_;
+    CMyComPtr<ISequentialOutStream> out_stream_;
+    UString tar_name_;
+    UInt64 tar_size_;
+    FILETIME mtime_;
+    int level_;
+    unsigned int num_threads_;
+    std::thread codec_thread_;
+    HRESULT codec_result_;
+  };
+
+}
+
+#endif // !COMPRESSOR_WIN_TAR_PIPELINE_H_
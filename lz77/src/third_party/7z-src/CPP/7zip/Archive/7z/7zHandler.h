@@ -43,6 +43,7 @@ public:
   bool _numSolidBytesDefined;
   bool _solidExtension;
   bool _useTypeSorting;
+  bool _useClientOrder;
 
   bool _compressHeaders;
   bool _encryptHeadersSpecified;
@@ -631,6 +631,7 @@ STDMETHODIMP CHandler::UpdateItems(ISequentialOutStream *outStream, UInt32 numIt
   options.NumSolidBytes = _numSolidBytes;
   options.SolidExtension = _solidExtension;
   options.UseTypeSorting = _useTypeSorting;
+  options.UseClientOrder = _useClientOrder;
 
   options.RemoveSfxBlock = _removeSfxBlock;
   // options.VolumeMode = _volumeMode;
@@ -722,6 +723,7 @@ void COutHandler::InitProps7z()
 
   InitSolid();
   _useTypeSorting = false;
+  _useClientOrder = false;
 }
 
 void COutHandler::InitProps()
@@ -857,6 +859,8 @@ HRESULT COutHandler::SetProperty(const wchar_t *nameSpec, const PROPVARIANT &val
     if (name.IsEqualTo("mtf")) return PROPVARIANT_to_bool(value, _useMultiThreadMixer);
 
     if (name.IsEqualTo("qs")) return PROPVARIANT_to_bool(value, _useTypeSorting);
+    // keep the order the update callback lists the items in
+    if (name.IsEqualTo("qc")) return PROPVARIANT_to_bool(value, _useClientOrder);
 
     // if (name.IsEqualTo("v"))  return PROPVARIANT_to_bool(value, _volumeMode);
   }
@@ -2306,7 +2306,9 @@ HRESULT Update(
     CSortParam sortParam;
     // sortParam.TreeFolders = &treeFolders;
     sortParam.SortByType = sortByType;
-    refItems.Sort(CompareUpdateItems, (void *)&sortParam);
+    // group.Indices are already in client order
+    if (!options.UseClientOrder)
+      refItems.Sort(CompareUpdateItems, (void *)&sortParam);
     
     CObjArray<UInt32> indices(numFiles);
 
@@ -99,6 +99,7 @@ struct CUpdateOptions
   bool SolidExtension;
   
   bool UseTypeSorting;
+  bool UseClientOrder;
   
   bool RemoveSfxBlock;
   bool MultiThreadMixer;
@@ -113,6 +114,7 @@ struct CUpdateOptions
       NumSolidBytes((UInt64)(Int64)(-1)),
       SolidExtension(false),
       UseTypeSorting(true),
+      UseClientOrder(false),
       RemoveSfxBlock(false),
       MultiThreadMixer(true)
     {}
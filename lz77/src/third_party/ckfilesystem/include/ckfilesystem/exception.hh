@@ -46,4 +46,30 @@ namespace ckfilesystem
             return file_path_;
         }
     };
+
+    /**
+     * @brief Class for exceptions when file data can not be written to the
+     *        disc image.
+     */
+    class FileWriteException : public ckcore::Exception2
+    {
+    private:
+        ckcore::tstring file_path_;
+
+    public:
+        FileWriteException(const ckcore::tstring &a_file_path)
+            : Exception2( ckcore::string::formatstr(
+                              ckT("Unable to write file \"%s\" to the disc image."),
+                              a_file_path.c_str() ) )
+            , file_path_(a_file_path)
+        {
+        }
+
+        virtual ~FileWriteException() throw() {};
+
+        const ckcore::tstring &file_path() const
+        {
+            return file_path_;
+        }
+    };
 };
@@ -32,7 +32,8 @@ namespace ckfilesystem
         enum
         {
             FLAG_DIRECTORY = 0x01,
-            FLAG_IMPORTED = 0x02
+            FLAG_IMPORTED = 0x02,
+            FLAG_SIZED = 0x04               // Size is known, the file is not opened.
         };
 
         unsigned char flags_;
@@ -40,12 +41,14 @@ namespace ckfilesystem
         ckcore::tstring external_path_;     // Path on hard drive.
 
         void *data_ptr_;                    // Pointer to a user-defined structure, designed for IsoTreeNode.
+        ckcore::tuint64 size_;              // File size, used with FLAG_SIZED.
 
         FileDescriptor(const ckcore::tchar *internal_path,const ckcore::tchar *external_path,
-                       unsigned char flags = 0,void *data_ptr = NULL) :
+                       unsigned char flags = 0,void *data_ptr = NULL,
+                       ckcore::tuint64 size = 0) :
             flags_(flags),
             internal_path_(internal_path),external_path_(external_path),
-            data_ptr_(data_ptr)
+            data_ptr_(data_ptr),size_(size)
         {
         }
     };
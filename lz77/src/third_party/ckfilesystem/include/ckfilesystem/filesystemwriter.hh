@@ -35,6 +35,37 @@
 
 namespace ckfilesystem
 {
+    /**
+     * @brief Interface for supplying the file data written by FileSystemWriter.
+     *
+     * When set, the writer asks the source for the data of every file instead
+     * of copying it from the stream of the file node, which allows the files
+     * to be read ahead and in parallel.
+     */
+    class FileDataSource
+    {
+    public:
+        virtual ~FileDataSource() {};
+
+        /**
+         * Called once before any file data is written.
+         * @param [in] nodes The file nodes in the order their data will be
+         *                   requested.
+         */
+        virtual void prepare(const std::vector<FileTreeNode *> &nodes) = 0;
+
+        /**
+         * Writes all data of a file to the output stream.
+         * @param [in] node The next file node in the order given to prepare.
+         * @param [out] out_stream Stream to write to.
+         * @param [out] progresser Object to report progress to.
+         * @return true on success, false on failure. A failure aborts the
+         *         write with a FileWriteException.
+         */
+        virtual bool copy(FileTreeNode *node,SectorOutStream &out_stream,
+                          ckcore::Progresser &progresser) = 0;
+    };
+
     class FileSystemWriter
     {
     private:
@@ -42,6 +73,7 @@ namespace ckfilesystem
         FileSystem &file_sys_;      ///< What file system should be created.
         FileTree file_tree_;        ///< File tree for caching between the write and file_path_map functions.
         const bool fail_on_error_;  ///< Set to true in order to abort the operation if an error occurs.
+        FileDataSource *data_source_;   ///< Optional source of the file data.
 
         /**
          * Calculates file system specific data such as extent location and size for a
@@ -66,6 +98,15 @@ namespace ckfilesystem
                                    FileTreeNode *local_node,int level,ckcore::Progresser &progresser);
         void write_file_data(SectorOutStream &out_stream,FileTree &file_tree,ckcore::Progresser &progresser);
 
+        void collect_local_file_data(std::vector<std::pair<FileTreeNode *,int> > &dir_node_stack,
+                                     FileTreeNode *local_node,int level,
+                                     std::vector<FileTreeNode *> &nodes);
+
+        /**
+         * Lists the files in the order write_file_data writes their data.
+         */
+        void collect_file_data(FileTree &file_tree,std::vector<FileTreeNode *> &nodes);
+
         void get_internal_path(FileTreeNode *child_node,ckcore::tstring &node_path,
                                bool ext_path,bool joliet);
         void create_local_file_path_map(FileTreeNode *local_node,
@@ -84,6 +125,13 @@ namespace ckfilesystem
         FileSystemWriter(ckcore::Log &log,FileSystem &file_sys,bool fail_on_error);
         ~FileSystemWriter();    
 
+        /**
+         * Sets the object that supplies the file data.
+         * @param [in] data_source Source to use, NULL to read the file
+         *                         streams of the file tree.
+         */
+        void set_data_source(FileDataSource *data_source);
+
         /**
          * Writes the file system to the specified output stream.
          * @param [out] out_stream Stream to write to.
@@ -39,7 +39,8 @@ namespace ckfilesystem
         enum
         {
             FLAG_DIRECTORY = 0x01,
-            FLAG_IMPORTED = 0x02
+            FLAG_IMPORTED = 0x02,
+            FLAG_SIZED = 0x04   // file_size_ is given, the stream is never opened.
         };
 
         ckcore::FileInStream file_stream_;  // File stream for reading.
@@ -82,16 +83,18 @@ namespace ckfilesystem
          * @param [in] fragment_index FIXME.
          * @param [in] file_flags File flags.
          * @param [in] data_ptr Pointer to IsoTreeNode data structure.
+         * @param [in] file_size Size of the file, used with FLAG_SIZED.
          * @throw FileOpenException Thrown when file stream cannot be opened for
          *                          reading.
          */
         FileTreeNode(FileTreeNode *parent_node,const ckcore::tchar *file_name,
                      const ckcore::tchar *file_path,
                      bool /* last_fragment */, ckcore::tuint32 /* fragment_index */,
-                     unsigned char file_flags = 0,void *data_ptr = NULL) :
+                     unsigned char file_flags = 0,void *data_ptr = NULL,
+                     ckcore::tuint64 file_size = 0) :
             parent_node_(parent_node),
             file_stream_(file_path),
-            file_flags_(file_flags),file_size_(0),
+            file_flags_(file_flags),file_size_(file_size),
             file_name_(file_name),file_path_(file_path),
             data_pos_normal_(0),data_pos_joliet_(0),
             data_size_normal_(0),data_size_joliet_(0),data_pad_len_(0),
@@ -102,7 +105,7 @@ namespace ckfilesystem
 #endif
         {
             // If not a directory, try to open the file stream.
-            if (!(file_flags & FLAG_DIRECTORY) && !(file_flags & FLAG_IMPORTED))
+            if (!(file_flags & (FLAG_DIRECTORY | FLAG_IMPORTED | FLAG_SIZED)))
             {
                 if (!file_stream_.open())
                     throw FileOpenException(file_path_);
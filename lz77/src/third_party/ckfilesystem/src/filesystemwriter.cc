@@ -29,7 +29,8 @@ namespace ckfilesystem
 {
     FileSystemWriter::FileSystemWriter(ckcore::Log &log,FileSystem &file_sys,
                                        bool fail_on_error) :
-        log_(log),file_sys_(file_sys),file_tree_(log),fail_on_error_(fail_on_error)
+        log_(log),file_sys_(file_sys),file_tree_(log),fail_on_error_(fail_on_error),
+        data_source_(NULL)
     {
     }
 
@@ -37,6 +38,11 @@ namespace ckfilesystem
     {
     }
 
+    void FileSystemWriter::set_data_source(FileDataSource *data_source)
+    {
+        data_source_ = data_source;
+    }
+
     void FileSystemWriter::calc_local_filesys_data(std::vector<std::pair<FileTreeNode *,int> > &dir_node_stack,
                                                    FileTreeNode *local_node,int level,
                                                    ckcore::tuint64 &sec_offset,ckcore::Progress &progress)
@@ -140,9 +146,25 @@ namespace ckfilesystem
     void FileSystemWriter::write_file_node(SectorOutStream &out_stream,FileTreeNode *node,
                                            ckcore::Progresser &progresser)
     {
+        if (data_source_ != NULL)
+        {
+#ifdef _DEBUG
+            node->data_pos_actual_ = out_stream.get_sector();
+#endif
+            // The source reads exactly file_size_ bytes and fails otherwise.
+            if (!data_source_->copy(node,out_stream,progresser))
+                throw FileWriteException(node->file_path_);
+
+            // Pad the sector.
+            if (out_stream.get_allocated() != 0)
+                out_stream.pad_sector();
+            return;
+        }
+
         // Make sure that the file stream is ready for reading. Please note that this
-        // is the second place of try. The stream should already be open.
-        if (!node->file_stream_.test() && node->file_stream_.open())
+        // is the second place of try. The stream should already be open unless the
+        // node was sized from the file set.
+        if (!node->file_stream_.test() && !node->file_stream_.open())
             throw FileOpenException(node->file_path_);
 
 #ifdef _DEBUG
@@ -252,6 +274,50 @@ namespace ckfilesystem
         }
     }
 
+    void FileSystemWriter::collect_local_file_data(std::vector<std::pair<FileTreeNode *,int> > &dir_node_stack,
+                                                   FileTreeNode *local_node,int level,
+                                                   std::vector<FileTreeNode *> &nodes)
+    {
+        std::vector<FileTreeNode *>::const_iterator it_file;
+        for (it_file = local_node->children_.begin(); it_file !=
+            local_node->children_.end(); it_file++)
+        {
+            // Same selection as write_local_file_data.
+            if ((*it_file)->file_flags_ & FileTreeNode::FLAG_DIRECTORY)
+            {
+                if (level <= file_sys_.get_max_dir_level())
+                    dir_node_stack.push_back(std::make_pair(*it_file,level + 1));
+            }
+            else if (!((*it_file)->file_flags_ & FileTreeNode::FLAG_IMPORTED))
+            {
+                if (file_sys_.is_iso() && !file_sys_.is_udf())
+                {
+                    if ((*it_file)->file_size_ > ISO_MAX_EXTENT_SIZE && !file_sys_.allows_fragmentation())
+                        continue;
+                }
+
+                nodes.push_back(*it_file);
+            }
+        }
+    }
+
+    void FileSystemWriter::collect_file_data(FileTree &file_tree,std::vector<FileTreeNode *> &nodes)
+    {
+        FileTreeNode *cur_node = file_tree.get_root();
+
+        std::vector<std::pair<FileTreeNode *,int> > dir_node_stack;
+        collect_local_file_data(dir_node_stack,cur_node,2,nodes);
+
+        while (dir_node_stack.size() > 0)
+        { 
+            cur_node = dir_node_stack[dir_node_stack.size() - 1].first;
+            int level = dir_node_stack[dir_node_stack.size() - 1].second;
+            dir_node_stack.pop_back();
+
+            collect_local_file_data(dir_node_stack,cur_node,level,nodes);
+        }
+    }
+
     void FileSystemWriter::get_internal_path(FileTreeNode *child_node,ckcore::tstring &node_path,
                                              bool ext_path,bool joliet)
     {
@@ -546,6 +612,12 @@ namespace ckfilesystem
 
             // To help keep track of the progress.
             ckcore::Progresser progresser(progress,sec_manager.get_data_length() * ISO_SECTOR_SIZE);
+            if (data_source_ != NULL)
+            {
+                std::vector<FileTreeNode *> nodes;
+                collect_file_data(file_tree_,nodes);
+                data_source_->prepare(nodes);
+            }
             write_file_data(out_sec_stream,file_tree_,progresser);
             if (progresser.cancelled())
                 return RESULT_CANCEL;
@@ -112,8 +112,14 @@ namespace ckfilesystem
         }
         else
         {
+            // A sized file is opened by whoever supplies its data.
+            unsigned char size_flag = 0;
+            if (file.flags_ & FileDescriptor::FLAG_SIZED)
+                size_flag = FileTreeNode::FLAG_SIZED;
+
             cur_node->children_.push_back(new FileTreeNode(cur_node,file_name,
-                file.external_path_.c_str(),true,0,import_flag,import_data_ptr));
+                file.external_path_.c_str(),true,0,import_flag | size_flag,import_data_ptr,
+                file.size_));
 
             file_count_++;
         }
@@ -20,23 +20,41 @@
 
 
 #include <filesystem>
+#include <algorithm>
+#include <thread>
 #undef _WINDOWS_
 #undef _WINSOCK2API_
 #undef _WS2IPDEF_
 #include "base/path.h"
 #include "compressor/lib7zip_wrapper.h"
+#include "compressor/extract_dir_cache.h"
+#include "compressor/extract_writer_pool.h"
+#include "compressor/operation_stats.h"
+#include "compressor/byte_ring.h"
+#include "compressor/item_table.h"
 
 extern bool Create7ZipArchiveItem(C7ZipArchive * pArchive, 
 								  IInArchive * pInArchive,
 								  unsigned int nIndex,
 								  C7ZipArchiveItem ** ppItem);
+extern wstring Get7ZipItemFullPath(IInArchive * pInArchive, unsigned int nIndex);
+extern bool Get7ZipItemUInt64Property(IInArchive * pInArchive, unsigned int nIndex,
+									  lib7zip::PropertyIndexEnum propertyIndex, unsigned __int64 & val);
+extern bool Get7ZipItemBoolProperty(IInArchive * pInArchive, unsigned int nIndex,
+									lib7zip::PropertyIndexEnum propertyIndex, bool & val);
+extern bool Get7ZipItemFileTimeProperty(IInArchive * pInArchive, unsigned int nIndex,
+										lib7zip::PropertyIndexEnum propertyIndex, unsigned __int64 & val);
+extern HRESULT Lib7ZipOpenSequentialArchive(C7ZipLibrary * pLibrary,
+																						const wstring & ext,
+																						ISequentialInStream * pInStream,
+																						IInArchive ** ppInArchive);
 
 class C7ZipOutStreamWrap:
 	public IOutStream,
 	public CMyUnknownImp
 {
 public:
-	C7ZipOutStreamWrap(C7ZipOutStream * pOutStream) : m_pOutStream(pOutStream) {}
+	C7ZipOutStreamWrap(C7ZipOutStream * pOutStream) : m_pOutStream(pOutStream), m_pStats(NULL) {}
 	virtual ~C7ZipOutStreamWrap() {}
 
 public:
@@ -58,11 +76,126 @@ public:
 
 	STDMETHOD(Write)(const void *data, UInt32 size, UInt32 *processedSize)
 	{
-		return m_pOutStream->Write(data, size, processedSize);
+		if (!m_pStats) {
+			return m_pOutStream->Write(data, size, processedSize);
+		}
+		compressor::OperationStats::ScopedPhase phase(m_pStats, compressor::OperationPhase::kWrite);
+		UInt32 processed = 0;
+		const int res = m_pOutStream->Write(data, size, &processed);
+		m_pStats->AddBytesOut(processed);
+		if (processedSize != NULL) {
+			*processedSize = processed;
+		}
+		return res;
+	}
+	void SetStats(compressor::OperationStats * pStats) {
+		m_pStats = pStats;
 	}
 
 private:
 	C7ZipOutStream * m_pOutStream;
+	compressor::OperationStats * m_pStats;
+};
+
+class C7ZipChunkedOutStream : public C7ZipOutStream
+{
+public:
+	C7ZipChunkedOutStream(C7ZipSink * pSink, unsigned int chunkSize) :
+		m_pSink(pSink),
+		m_nChunkSize(chunkSize ? chunkSize : kDefaultChunkSize)
+	{
+		m_Chunk.reserve(m_nChunkSize);
+	}
+	static const unsigned int kDefaultChunkSize = 1 << 20;
+
+	virtual int Write(const void *data, unsigned int size, unsigned int *processedSize)
+	{
+		if (processedSize != NULL) {
+			*processedSize = 0;
+		}
+		const std::uint8_t* byte_data = static_cast< const std::uint8_t* >(data);
+		unsigned int pos = 0;
+		while (pos < size) {
+			if (m_Chunk.empty() && size - pos >= m_nChunkSize) {
+				//whole chunks go straight to the sink without a copy
+				if (m_pSink->OnChunk(byte_data + pos, m_nChunkSize) != 0) {
+					return E_ABORT;
+				}
+				pos += m_nChunkSize;
+				continue;
+			}
+			const unsigned int n = (std::min)(size - pos, m_nChunkSize - (unsigned int)m_Chunk.size());
+			m_Chunk.insert(m_Chunk.end(), byte_data + pos, byte_data + pos + n);
+			pos += n;
+			if (m_Chunk.size() == m_nChunkSize && Flush() != S_OK) {
+				return E_ABORT;
+			}
+		}
+		if (processedSize != NULL) {
+			*processedSize = size;
+		}
+		return S_OK;
+	}
+	virtual int Seek(__int64 offset, unsigned int seekOrigin, unsigned __int64 *newPosition)
+	{
+		return E_NOTIMPL;
+	}
+	virtual int SetSize(unsigned __int64 size)
+	{
+		return S_OK;
+	}
+	int Flush()
+	{
+		if (m_Chunk.empty()) {
+			return S_OK;
+		}
+		const int res = m_pSink->OnChunk(&m_Chunk[0], (unsigned int)m_Chunk.size());
+		m_Chunk.clear();
+		return res == 0 ? S_OK : E_ABORT;
+	}
+private:
+	C7ZipSink * m_pSink;
+	unsigned int m_nChunkSize;
+	std::vector<std::uint8_t> m_Chunk;
+};
+
+//producer end of a nested-stream pipe:the outer handler's output
+class C7ZipRingSink : public C7ZipSink
+{
+public:
+	explicit C7ZipRingSink(compressor::ByteRing * pRing) : m_pRing(pRing) {}
+	virtual int OnChunk(const void *data, unsigned int size)
+	{
+		//non-zero stops the outer decoder once the inner handler gave up
+		return m_pRing->Write(data, size) ? 1 : 0;
+	}
+private:
+	compressor::ByteRing * m_pRing;
+};
+
+//consumer end:what the inner handler reads from
+class C7ZipRingInStream : public ISequentialInStream, public CMyUnknownImp
+{
+public:
+	explicit C7ZipRingInStream(compressor::ByteRing * pRing) : m_pRing(pRing) {}
+	virtual ~C7ZipRingInStream() {}
+
+	MY_UNKNOWN_IMP
+
+	STDMETHOD(Read)(void *data, UInt32 size, UInt32 *processedSize)
+	{
+		const size_t n = m_pRing->Read(data, size);
+		if (processedSize != NULL) {
+			*processedSize = (UInt32)n;
+		}
+		if (n == 0 && (m_pRing->is_write_failed() || m_pRing->is_aborted())) {
+			//the outer stream is broken,not just finished
+			return E_ABORT;
+		}
+		return S_OK;
+	}
+private:
+	compressor::ByteRing * m_pRing;
 };
 
 class C7ZipOutMemStream : public ISequentialOutStream, public CMyUnknownImp {
@@ -130,7 +263,7 @@ private:
 	CMyComPtr<ISequentialOutStream> _outFileStream;
 
 	C7ZipOutStream * m_pOutStream;
-  std::vector<std::uint8_t> m_pOutMemStream;
+  std::vector<std::uint8_t>* m_pOutMemStream;
   C7ZipOutMemStream* mOutMemStreamSpec;
 
 	const C7ZipArchive * m_pArchive;
@@ -143,29 +276,69 @@ private:
   UInt64 total_size_;
   UInt64 complete_size_;
   UInt64 current_item_index_;
+  UInt32 last_index_;
+  bool is_write_files_;
+  bool is_continue_on_error_;
+  bool is_any_item_failed_;
+  std::vector<int>* op_results_;
+  std::vector<std::vector<std::uint8_t> >* out_mem_items_;
+  compressor::ExtractDirCache* dir_cache_;
+  //used when no prepared cache was set,lives as long as this extraction
+  compressor::ExtractDirCache own_dir_cache_;
+  compressor::ExtractWriterPool* writer_pool_;
+  compressor::ExtractWriteJob* write_job_;
+  compressor::ExtractPooledOutStream pooled_out_;
+  compressor::ExtractFileMeta write_meta_;
+  compressor::Wrapper7zOutStream file_out_;
+  void ReadWriteMeta(const C7ZipArchiveItem * archive_item);
+  void CloseWriteJob();
+  void CloseFileOut();
 #endif
 public:
   CArchiveExtractCallback(std::vector<std::uint8_t>& pOutStream, const C7ZipArchive * pArchive, const C7ZipArchiveItem * pItem) :
-    m_pOutMemStream(pOutStream),
+    m_pOutMemStream(&pOutStream),
     m_pArchive(pArchive),
-    m_pItem(pItem)
+    m_pItem(pItem),
+    file_out_(L"", L"")
   {
     is_password_defined_ = false;
     m_pOutStream = nullptr;
     total_size_ = -1;
     complete_size_ = 0;
     current_item_index_ = 0;
+    last_index_ = 0;
+    is_write_files_ = false;
+    is_continue_on_error_ = false;
+    is_any_item_failed_ = false;
+    op_results_ = nullptr;
+    out_mem_items_ = nullptr;
+    dir_cache_ = nullptr;
+    writer_pool_ = nullptr;
+    write_job_ = nullptr;
+    ReadWriteMeta(nullptr);
   }
 	CArchiveExtractCallback(C7ZipOutStream * pOutStream,const C7ZipArchive * pArchive,const C7ZipArchiveItem * pItem) : 
 		m_pOutStream(pOutStream),
 		m_pArchive(pArchive),
-		m_pItem(pItem)
+		m_pItem(pItem),
+		file_out_(L"", L"")
 	{
     is_password_defined_ = false;
-    m_pOutMemStream.resize(0);
+    m_pOutMemStream = nullptr;
     total_size_ = -1;
     complete_size_ = 0;
     current_item_index_ = 0;
+    last_index_ = 0;
+    //without a caller stream every item goes to a file under RootDir()
+    is_write_files_ = (pOutStream == nullptr);
+    is_continue_on_error_ = false;
+    is_any_item_failed_ = false;
+    op_results_ = nullptr;
+    out_mem_items_ = nullptr;
+    dir_cache_ = nullptr;
+    writer_pool_ = nullptr;
+    write_job_ = nullptr;
+    ReadWriteMeta(nullptr);
 	}
   const std::wstring& opResMsg() const {
     return opResMsg_;
@@ -176,6 +349,36 @@ public:
   UInt64 CurrentItemIndex() const {
     return current_item_index_;
   }
+  void SetDirCache(compressor::ExtractDirCache* dir_cache) {
+    dir_cache_ = dir_cache;
+  }
+  void SetContinueOnError(bool is_continue) {
+    //a failed item is reported and the handler goes on with the next one
+    is_continue_on_error_ = is_continue;
+  }
+  bool IsAnyItemFailed() const {
+    return is_any_item_failed_;
+  }
+  void SetOpResults(std::vector<int>* op_results) {
+    op_results_ = op_results;
+  }
+  void SetOutMemItems(std::vector<std::vector<std::uint8_t> >* out_mem_items) {
+    //every item into its own buffer,nothing is written to disk
+    out_mem_items_ = out_mem_items;
+    is_write_files_ = false;
+  }
+  void SetWriterPool(compressor::ExtractWriterPool* writer_pool) {
+    writer_pool_ = writer_pool;
+  }
+  bool IsWriterPoolUsed() const {
+    return writer_pool_ != nullptr;
+  }
+  void FlushWriteJob() {
+    if (write_job_) {
+      CloseWriteJob();
+    }
+    CloseFileOut();
+  }
 };
 
 class C7ZipArchiveImpl : public virtual C7ZipArchive
@@ -191,6 +394,7 @@ public:
 	virtual bool Extract(unsigned int index, C7ZipOutStream * pOutStream, const wstring & pwd);
 	virtual bool Extract(const C7ZipArchiveItem * pArchiveItem, C7ZipOutStream * pOutStream);
   virtual bool Extract(const C7ZipArchiveItem * pArchiveItem, std::vector<std::uint8_t>& pOutStream);
+  virtual bool Extract(const C7ZipArchiveItem * pArchiveItem, C7ZipSink * pSink, unsigned int chunkSize);
 
 	virtual void Close();
 
@@ -211,13 +415,25 @@ public:
 private:
 	C7ZipLibrary * m_pLibrary;
 	CMyComPtr<IInArchive> m_pInArchive;
-	C7ZipObjectPtrArray m_ArchiveItems;
+	C7ZipObjectPtrArray m_ArchiveItems; // owns the items created so far
+	std::vector<C7ZipArchiveItem *> m_Items; // per index,NULL until first asked for
 	wstring m_Password;
+	C7ZipArchiveItem * ItemAt(unsigned int index);
 #if defined(LIBZIP_FIX)
   uint32_t opRes;
   std::wstring opResMsg_;
   std::map<std::wstring, std::wstring> error_file_msg_;
   bool is_password_defined_;
+  compressor::ExtractDirCache dir_cache_;
+  //created by the first extraction to disk,its threads serve every later one
+  compressor::ExtractWriterPool* writer_pool_;
+  bool is_sequential_;
+  bool ExtractSequential(compressor::OperationStats* pWriteStats);
+  void PrepareDirCache(const UInt32* indices, size_t count);
+  HRESULT DecodeItems(const UInt32* indices, UInt32 numItems, Int32 testMode,
+    IArchiveExtractCallback* extractCallback);
+  compressor::ExtractWriterPool* WriterPool(compressor::OperationStats* pWriteStats);
+  bool FinishWriterPool(CArchiveExtractCallback* extractCallbackSpec);
 #endif
 public:
   virtual const std::wstring& OpResMsg() const {
@@ -227,6 +443,19 @@ public:
     return is_password_defined_;
   }
   virtual bool ExtractTest(const C7ZipArchiveItem * pArchiveItem, C7ZipOutStream * pOutStream);
+  virtual bool ExtractItems(const std::vector<unsigned int>& indices);
+  virtual bool TestItems(const std::vector<unsigned int>& indices, std::vector<int>& results);
+  virtual bool ExtractItemsToMemory(const std::vector<unsigned int>& indices,
+    std::vector<std::vector<std::uint8_t> >& buffers, std::vector<int>& results);
+  virtual bool ExtractNested(unsigned int index);
+  virtual wstring GetItemFullPath(unsigned int index) const;
+  virtual bool GetItemUInt64Property(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+    unsigned __int64 & val) const;
+  virtual bool GetItemBoolProperty(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+    bool & val) const;
+  virtual bool GetItemFileTimeProperty(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+    unsigned __int64 & val) const;
+  virtual bool ReadItemTable(compressor::ItemTable& table) const;
   virtual void Push(const std::wstring& file,const std::wstring& msg) {
     error_file_msg_[file] = msg;
   }
@@ -241,38 +470,115 @@ m_pInArchive(pInArchive)
 {
   opRes = NArchive::NExtract::NOperationResult::kOK;
   is_password_defined_ = false;
+  is_sequential_ = false;
+  writer_pool_ = NULL;
   error_file_msg_.clear();
 }
 
 C7ZipArchiveImpl::~C7ZipArchiveImpl()
 {
+	if (writer_pool_ != NULL) {
+		delete writer_pool_;
+		writer_pool_ = NULL;
+	}
 }
 
 bool C7ZipArchiveImpl::GetItemCount(unsigned int * pNumItems)
 {
-	*pNumItems = (unsigned int)m_ArchiveItems.size();
+	*pNumItems = (unsigned int)m_Items.size();
 
 	return true;
 }
 
-bool C7ZipArchiveImpl::GetItemInfo(unsigned int index, C7ZipArchiveItem ** ppArchiveItem)
+C7ZipArchiveItem * C7ZipArchiveImpl::ItemAt(unsigned int index)
 {
-	if (index < m_ArchiveItems.size())
+	//a sequential handler only knows the item it is positioned on
+	while (is_sequential_ && index >= m_Items.size())
 	{
-		*ppArchiveItem = dynamic_cast<C7ZipArchiveItem *>(m_ArchiveItems[(int)index]);
+		C7ZipArchiveItem * pItem = NULL;
+		if (!Create7ZipArchiveItem(this, m_pInArchive, (unsigned int)m_Items.size(), &pItem))
+			break;
+		m_ArchiveItems.push_back(pItem);
+		m_Items.push_back(pItem);
+	}
 
-		return true;
+	if (index >= m_Items.size())
+		return NULL;
+
+	if (!m_Items[index])
+	{
+		C7ZipArchiveItem * pItem = NULL;
+		if (!Create7ZipArchiveItem(this, m_pInArchive, index, &pItem))
+			return NULL;
+		m_ArchiveItems.push_back(pItem);
+		m_Items[index] = pItem;
 	}
 
-	*ppArchiveItem = NULL;
-	return false;
+	return m_Items[index];
+}
+
+bool C7ZipArchiveImpl::GetItemInfo(unsigned int index, C7ZipArchiveItem ** ppArchiveItem)
+{
+	*ppArchiveItem = ItemAt(index);
+
+	return *ppArchiveItem != NULL;
+}
+
+wstring C7ZipArchiveImpl::GetItemFullPath(unsigned int index) const
+{
+	return Get7ZipItemFullPath(m_pInArchive, index);
+}
+
+bool C7ZipArchiveImpl::GetItemUInt64Property(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+	unsigned __int64 & val) const
+{
+	return index < m_Items.size() && Get7ZipItemUInt64Property(m_pInArchive, index, propertyIndex, val);
+}
+
+bool C7ZipArchiveImpl::GetItemBoolProperty(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+	bool & val) const
+{
+	return index < m_Items.size() && Get7ZipItemBoolProperty(m_pInArchive, index, propertyIndex, val);
+}
+
+bool C7ZipArchiveImpl::GetItemFileTimeProperty(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+	unsigned __int64 & val) const
+{
+	return index < m_Items.size() && Get7ZipItemFileTimeProperty(m_pInArchive, index, propertyIndex, val);
+}
+
+bool C7ZipArchiveImpl::ReadItemTable(compressor::ItemTable& table) const
+{
+	//paths as the handler reports them,one root without a disk side
+	table.Reserve(table.size() + m_Items.size());
+	const uint32_t root = table.AddRoot(L"", L"");
+	for (unsigned int i = 0; i < m_Items.size(); i++)
+	{
+		unsigned __int64 size = 0;
+		unsigned __int64 ctime = 0;
+		unsigned __int64 atime = 0;
+		unsigned __int64 mtime = 0;
+		unsigned __int64 attrib = 0;
+		bool isDir = false;
+		Get7ZipItemUInt64Property(m_pInArchive, i, lib7zip::kpidSize, size);
+		Get7ZipItemFileTimeProperty(m_pInArchive, i, lib7zip::kpidCTime, ctime);
+		Get7ZipItemFileTimeProperty(m_pInArchive, i, lib7zip::kpidATime, atime);
+		Get7ZipItemFileTimeProperty(m_pInArchive, i, lib7zip::kpidMTime, mtime);
+		Get7ZipItemUInt64Property(m_pInArchive, i, lib7zip::kpidAttrib, attrib);
+		Get7ZipItemBoolProperty(m_pInArchive, i, lib7zip::kpidIsDir, isDir);
+		table.Add(root, Get7ZipItemFullPath(m_pInArchive, i), size, ctime, atime, mtime, (uint32_t)attrib, isDir);
+	}
+	table.EndRoot();
+
+	return true;
 }
 
 bool C7ZipArchiveImpl::Extract(unsigned int index, C7ZipOutStream * pOutStream)
 {
-	if (index < m_ArchiveItems.size())
+	const C7ZipArchiveItem * pItem = ItemAt(index);
+	if (pItem)
 	{
-		return Extract(dynamic_cast<const C7ZipArchiveItem *>(m_ArchiveItems[(int)index]), pOutStream);
+		return Extract(pItem, pOutStream);
 	}
 
 	return false;
@@ -280,9 +586,9 @@ bool C7ZipArchiveImpl::Extract(unsigned int index, C7ZipOutStream * pOutStream)
 
 bool C7ZipArchiveImpl::Extract(unsigned int index, C7ZipOutStream * pOutStream, const wstring & pwd)
 {
-	if (index < m_ArchiveItems.size())
+	C7ZipArchiveItem * pItem = ItemAt(index);
+	if (pItem)
 	{
-		C7ZipArchiveItem * pItem = dynamic_cast<C7ZipArchiveItem *>(m_ArchiveItems[(int)index]);
 		pItem->SetArchiveItemPassword(pwd);
 
 		return Extract(pItem, pOutStream);
@@ -297,9 +603,16 @@ bool C7ZipArchiveImpl::ExtractTest(const C7ZipArchiveItem * pArchiveItem, C7ZipO
     new CArchiveExtractCallback(pOutStream, this, pArchiveItem);
   CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
 
+  if (!pArchiveItem) {
+    //test all items in one pass
+    opRes = DecodeItems(NULL, (UInt32)(Int32)-1, true, extractCallbackSpec);
+    opResMsg_ = extractCallbackSpec->opResMsg();
+    is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
+    return opRes == S_OK;
+  }
   UInt32 nArchiveIndex = pArchiveItem->GetArchiveIndex();
 
-  opRes = m_pInArchive->Extract(&nArchiveIndex, 1, true, extractCallbackSpec);
+  opRes = DecodeItems(&nArchiveIndex, 1, true, extractCallbackSpec);
   opResMsg_ = extractCallbackSpec->opResMsg();
   is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
   return opRes == S_OK;
@@ -310,13 +623,23 @@ bool C7ZipArchiveImpl::Extract(const C7ZipArchiveItem * pArchiveItem, C7ZipOutSt
 	CArchiveExtractCallback *extractCallbackSpec = 
 		new CArchiveExtractCallback(pOutStream, this, pArchiveItem);
 	CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
+  if (Stats()) {
+    Stats()->SetItemsTotal(m_Items.size());
+  }
+  if (!pOutStream) {
+    PrepareDirCache(NULL, m_Items.size());
+    extractCallbackSpec->SetDirCache(&dir_cache_);
+#if defined(COMPRESSOR_MULTI_THREAD)
+    extractCallbackSpec->SetWriterPool(WriterPool(Stats()));
+#endif
+  }
   UInt32 nArchiveCount = 0;
   GetItemCount(&nArchiveCount);
 	UInt32 nArchiveIndex = pArchiveItem->GetArchiveIndex();
   bool is_exist_error = false;
   //FIXME?
   while (extractCallbackSpec->CurrentItemIndex() < nArchiveCount) {
-    opRes = m_pInArchive->Extract(&nArchiveIndex, is_exist_error ? 1 : -1, false, extractCallbackSpec);
+    opRes = DecodeItems(&nArchiveIndex, is_exist_error ? 1 : -1, false, extractCallbackSpec);
     if (opRes != S_OK) {
       is_exist_error = true;
     }
@@ -325,19 +648,299 @@ bool C7ZipArchiveImpl::Extract(const C7ZipArchiveItem * pArchiveItem, C7ZipOutSt
     }
     opResMsg_ = extractCallbackSpec->opResMsg();
   }
+  const bool is_write_failed = FinishWriterPool(extractCallbackSpec);
   is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
-	return opRes == S_OK;
+	return opRes == S_OK && !is_write_failed && !extractCallbackSpec->IsAnyItemFailed();
+}
+
+bool C7ZipArchiveImpl::ExtractItems(const std::vector<unsigned int>& indices) {
+	opRes = NArchive::NExtract::NOperationResult::kOK;
+	std::vector<UInt32> sorted_indices;
+	sorted_indices.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (indices[i] < m_Items.size()) {
+			sorted_indices.push_back(indices[i]);
+		}
+	}
+	if (sorted_indices.empty()) {
+		return true;
+	}
+	//handlers require ascending indices,one call decodes each solid block once
+	std::sort(sorted_indices.begin(), sorted_indices.end());
+	sorted_indices.erase(std::unique(sorted_indices.begin(), sorted_indices.end()), sorted_indices.end());
+	CArchiveExtractCallback *extractCallbackSpec =
+		new CArchiveExtractCallback((C7ZipOutStream *)NULL, this, NULL);
+	CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
+	PrepareDirCache(&sorted_indices[0], sorted_indices.size());
+	extractCallbackSpec->SetDirCache(&dir_cache_);
+	if (Stats()) {
+		Stats()->SetItemsTotal(sorted_indices.size());
+	}
+#if defined(COMPRESSOR_MULTI_THREAD)
+	extractCallbackSpec->SetWriterPool(WriterPool(Stats()));
+#endif
+	//one pass:a failed item is recorded and the decoder goes on,a solid
+	//block is never decoded again from its start
+	extractCallbackSpec->SetContinueOnError(true);
+	opRes = DecodeItems(&sorted_indices[0], (UInt32)sorted_indices.size(), false, extractCallbackSpec);
+	opResMsg_ = extractCallbackSpec->opResMsg();
+	const bool is_write_failed = FinishWriterPool(extractCallbackSpec);
+	is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
+	return opRes == S_OK && !is_write_failed && !extractCallbackSpec->IsAnyItemFailed();
+}
+
+bool C7ZipArchiveImpl::TestItems(const std::vector<unsigned int>& indices, std::vector<int>& results) {
+	opRes = NArchive::NExtract::NOperationResult::kOK;
+	//only the tested slots are touched,a caller testing in groups sizes the
+	//vector once
+	if (results.size() < m_Items.size()) {
+		results.resize(m_Items.size(), -1);
+	}
+	std::vector<UInt32> sorted_indices;
+	sorted_indices.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (indices[i] < m_Items.size()) {
+			sorted_indices.push_back(indices[i]);
+		}
+	}
+	if (sorted_indices.empty()) {
+		return true;
+	}
+	std::sort(sorted_indices.begin(), sorted_indices.end());
+	sorted_indices.erase(std::unique(sorted_indices.begin(), sorted_indices.end()), sorted_indices.end());
+	//-1:not reached,the handler stopped before the item
+	for (size_t i = 0; i < sorted_indices.size(); i++) {
+		results[sorted_indices[i]] = -1;
+	}
+	CArchiveExtractCallback *extractCallbackSpec =
+		new CArchiveExtractCallback((C7ZipOutStream *)NULL, this, NULL);
+	CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
+	extractCallbackSpec->SetOpResults(&results);
+	//test mode:the handler decodes into a null sink and checks the CRCs
+	opRes = DecodeItems(&sorted_indices[0], (UInt32)sorted_indices.size(), true, extractCallbackSpec);
+	opResMsg_ = extractCallbackSpec->opResMsg();
+	is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
+	if (opRes != S_OK) {
+		return false;
+	}
+	for (size_t i = 0; i < sorted_indices.size(); i++) {
+		if (results[sorted_indices[i]] != NArchive::NExtract::NOperationResult::kOK) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool C7ZipArchiveImpl::ExtractItemsToMemory(const std::vector<unsigned int>& indices,
+	std::vector<std::vector<std::uint8_t> >& buffers, std::vector<int>& results) {
+	opRes = NArchive::NExtract::NOperationResult::kOK;
+	results.assign(m_Items.size(), -1);
+	buffers.resize(m_Items.size());
+	std::vector<UInt32> sorted_indices;
+	sorted_indices.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i++) {
+		if (indices[i] < m_Items.size()) {
+			sorted_indices.push_back(indices[i]);
+		}
+	}
+	if (sorted_indices.empty()) {
+		return true;
+	}
+	std::sort(sorted_indices.begin(), sorted_indices.end());
+	sorted_indices.erase(std::unique(sorted_indices.begin(), sorted_indices.end()), sorted_indices.end());
+	CArchiveExtractCallback *extractCallbackSpec =
+		new CArchiveExtractCallback((C7ZipOutStream *)NULL, this, NULL);
+	CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
+	extractCallbackSpec->SetOpResults(&results);
+	extractCallbackSpec->SetOutMemItems(&buffers);
+	if (Stats()) {
+		Stats()->SetItemsTotal(sorted_indices.size());
+	}
+	opRes = DecodeItems(&sorted_indices[0], (UInt32)sorted_indices.size(), false, extractCallbackSpec);
+	opResMsg_ = extractCallbackSpec->opResMsg();
+	is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
+	if (opRes != S_OK) {
+		return false;
+	}
+	for (size_t i = 0; i < sorted_indices.size(); i++) {
+		if (results[sorted_indices[i]] != NArchive::NExtract::NOperationResult::kOK) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool C7ZipArchiveImpl::ExtractNested(unsigned int index) {
+	opRes = NArchive::NExtract::NOperationResult::kOK;
+	const C7ZipArchiveItem * pArchiveItem = ItemAt(index);
+	if (!pArchiveItem) {
+		return false;
+	}
+	compressor::ByteRing ring(compressor::kNestedRingSize);
+	C7ZipRingInStream * ringStreamSpec = new C7ZipRingInStream(&ring);
+	CMyComPtr<ISequentialInStream> ringStream(ringStreamSpec);
+	//outer decoder on its own thread,the tar parser and the writers consume behind it
+	bool is_outer_ok = false;
+	std::thread producer([this, pArchiveItem, &ring, &is_outer_ok]() {
+		C7ZipRingSink sink(&ring);
+		is_outer_ok = Extract(pArchiveItem, &sink, compressor::kNestedChunkSize);
+		ring.CloseWrite(!is_outer_ok);
+	});
+	bool is_inner_ok = false;
+	std::wstring inner_msg;
+	//the producer reports into this archive too,merge after the join
+	std::map<std::wstring, std::wstring> inner_errors;
+	CMyComPtr<IInArchive> nestedArchive;
+	if (Lib7ZipOpenSequentialArchive(m_pLibrary, L"tar", ringStream, &nestedArchive) == S_OK) {
+		C7ZipArchiveImpl nested(m_pLibrary, nestedArchive);
+		nested.is_sequential_ = true;
+		nested.SetRootDir(RootDir().c_str());
+		nested.SetArchivePassword(GetArchivePassword());
+		is_inner_ok = nested.ExtractSequential(Stats());
+		inner_msg = nested.OpResMsg();
+		inner_errors = nested.ErrorFileMsg();
+	}
+	else {
+		inner_msg = L"kIsNotArc";
+		inner_errors[pArchiveItem->GetFullPath()] = inner_msg;
+	}
+	if (is_inner_ok) {
+		//tar stops at its end marker,let the outer coder reach its own end and check
+		ring.Drain();
+	}
+	else {
+		ring.Abort();
+	}
+	producer.join();
+	std::map<std::wstring, std::wstring>::const_iterator it;
+	for (it = inner_errors.begin(); it != inner_errors.end(); it++) {
+		Push(it->first, it->second);
+	}
+	if (!inner_msg.empty()) {
+		opResMsg_ = inner_msg;
+	}
+	return is_inner_ok && is_outer_ok;
+}
+
+bool C7ZipArchiveImpl::ExtractSequential(compressor::OperationStats* pWriteStats) {
+  opRes = NArchive::NExtract::NOperationResult::kOK;
+  CArchiveExtractCallback *extractCallbackSpec =
+    new CArchiveExtractCallback((C7ZipOutStream *)NULL, this, NULL);
+  CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
+  //no item table up front,directories are created as the stream reaches them
+  dir_cache_.Reset(RootDir());
+  extractCallbackSpec->SetDirCache(&dir_cache_);
+#if defined(COMPRESSOR_MULTI_THREAD)
+  extractCallbackSpec->SetWriterPool(WriterPool(pWriteStats));
+#endif
+  opRes = DecodeItems(NULL, (UInt32)(Int32)-1, false, extractCallbackSpec);
+  opResMsg_ = extractCallbackSpec->opResMsg();
+  const bool is_write_failed = FinishWriterPool(extractCallbackSpec);
+  is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
+  return opRes == S_OK && !is_write_failed && !extractCallbackSpec->IsAnyItemFailed();
+}
+
+HRESULT C7ZipArchiveImpl::DecodeItems(const UInt32* indices, UInt32 numItems, Int32 testMode,
+	IArchiveExtractCallback* extractCallback) {
+	//decode includes the inline writes when no writer pool is used
+	compressor::OperationStats::ScopedPhase phase(Stats(), compressor::OperationPhase::kDecode);
+	return m_pInArchive->Extract(indices, numItems, testMode, extractCallback);
+}
+
+compressor::ExtractWriterPool* C7ZipArchiveImpl::WriterPool(compressor::OperationStats* pWriteStats) {
+	if (!writer_pool_) {
+		writer_pool_ = new compressor::ExtractWriterPool(0, compressor::kWriterMaxInflightBytes);
+	}
+	writer_pool_->SetStats(pWriteStats);
+	return writer_pool_;
+}
+
+bool C7ZipArchiveImpl::FinishWriterPool(CArchiveExtractCallback* extractCallbackSpec) {
+	//close a file left open by an aborted pass,then wait for the writers
+	extractCallbackSpec->FlushWriteJob();
+	if (!writer_pool_) {
+		//success
+		return false;
+	}
+	writer_pool_->Finish();
+	if (extractCallbackSpec->IsWriterPoolUsed()) {
+		writer_pool_->PublishBytesOut();
+	}
+	//a file the writers could not create,write or close is a failed item
+	const std::map<std::wstring, std::wstring>& errors = writer_pool_->errors();
+	const bool fail = !errors.empty();
+	std::map<std::wstring, std::wstring>::const_iterator it;
+	for (it = errors.begin(); it != errors.end(); it++) {
+		Push(it->first, it->second);
+	}
+	writer_pool_->ClearErrors();
+	//fail return true
+	return fail;
+}
+
+void C7ZipArchiveImpl::PrepareDirCache(const UInt32* indices, size_t count) {
+  //create the whole tree up front,GetStream then only opens files
+  dir_cache_.Reset(RootDir());
+  std::vector<std::wstring> dirs;
+  dirs.reserve(count);
+  for (size_t j = 0; j < count; j++) {
+    const size_t i = indices ? indices[j] : j;
+    if (i >= m_Items.size()) {
+      continue;
+    }
+    const std::wstring rpath = GetItemFullPath((unsigned int)i);
+    bool is_dir = false;
+    GetItemBoolProperty((unsigned int)i, lib7zip::kpidIsDir, is_dir);
+    if (is_dir) {
+      dirs.push_back(rpath);
+      continue;
+    }
+    const size_t pos = rpath.find_last_of(compressor::kPathSeparator);
+    if (pos != std::wstring::npos && pos > 0) {
+      dirs.push_back(rpath.substr(0, pos));
+    }
+  }
+  compressor::OperationStats::ScopedPhase phase(Stats(), compressor::OperationPhase::kMkdir);
+  dir_cache_.Prepare(dirs);
 }
 
 bool C7ZipArchiveImpl::Extract(const C7ZipArchiveItem * pArchiveItem, std::vector<std::uint8_t>& pOutStream) {
   opRes = NArchive::NExtract::NOperationResult::kOK;
+  //size the buffer once from the header instead of growing it per Write
+  unsigned __int64 item_size = 0;
+  pOutStream.clear();
+  if (pArchiveItem->GetUInt64Property(lib7zip::kpidSize, item_size) &&
+    item_size <= (unsigned __int64)pOutStream.max_size()) {
+    pOutStream.reserve((size_t)item_size);
+  }
   CArchiveExtractCallback *extractCallbackSpec =
     new CArchiveExtractCallback(pOutStream, this, pArchiveItem);
   CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
 
   UInt32 nArchiveIndex = pArchiveItem->GetArchiveIndex();
 
-  opRes = m_pInArchive->Extract(&nArchiveIndex, 1, false, extractCallbackSpec);
+  opRes = DecodeItems(&nArchiveIndex, 1, false, extractCallbackSpec);
+  opResMsg_ = extractCallbackSpec->opResMsg();
+  is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
+  return opRes == S_OK;
+}
+
+bool C7ZipArchiveImpl::Extract(const C7ZipArchiveItem * pArchiveItem, C7ZipSink * pSink, unsigned int chunkSize) {
+  opRes = NArchive::NExtract::NOperationResult::kOK;
+  if (!pArchiveItem || !pSink) {
+    return false;
+  }
+  C7ZipChunkedOutStream chunked_stream(pSink, chunkSize);
+  CArchiveExtractCallback *extractCallbackSpec =
+    new CArchiveExtractCallback(&chunked_stream, this, pArchiveItem);
+  CMyComPtr<IArchiveExtractCallback> extractCallback(extractCallbackSpec);
+
+  UInt32 nArchiveIndex = pArchiveItem->GetArchiveIndex();
+
+  opRes = DecodeItems(&nArchiveIndex, 1, false, extractCallbackSpec);
+  if (opRes == S_OK) {
+    opRes = chunked_stream.Flush();
+  }
   opResMsg_ = extractCallbackSpec->opResMsg();
   is_password_defined_ = extractCallbackSpec->IsPasswordDefined();
   return opRes == S_OK;
@@ -354,15 +957,8 @@ bool C7ZipArchiveImpl::Initialize()
 
 	RBOOLOK(m_pInArchive->GetNumberOfItems(&numItems));
 
-	for(UInt32 i = 0; i < numItems; i++)
-	{
-		C7ZipArchiveItem * pItem = NULL;
-
-		if (Create7ZipArchiveItem(this, m_pInArchive, i, &pItem))
-		{
-			m_ArchiveItems.push_back(pItem);
-		}
-	}
+	//item objects are created when asked for,listing by index needs none
+	m_Items.assign(numItems, NULL);
 
 	return true;
 }
@@ -401,70 +997,145 @@ bool Create7ZipArchive(C7ZipLibrary * pLibrary, IInArchive * pInArchive, C7ZipAr
 STDMETHODIMP CArchiveExtractCallback::SetTotal(UInt64  size )
 {
   total_size_ = size;
+  if (m_pArchive->Stats()) {
+    m_pArchive->Stats()->SetTotal(size);
+  }
 	return S_OK;
 }
 
 STDMETHODIMP CArchiveExtractCallback::SetCompleted(const UInt64 *  completeValue )
 {
-  complete_size_ += *completeValue;
+	if (!completeValue) {
+		return S_OK;
+	}
+	//the handler reports the running total,not a delta
+	complete_size_ = *completeValue;
+	if (writer_pool_) {
+		//the writer threads count their own bytes,publish what is on disk
+		//before SetCompleted notifies the observer
+		writer_pool_->PublishBytesOut();
+	}
+	if (m_pArchive->Stats()) {
+		m_pArchive->Stats()->SetCompleted(complete_size_);
+	}
 	return S_OK;
 }
 
 STDMETHODIMP CArchiveExtractCallback::GetStream(UInt32 index,
 												ISequentialOutStream **outStream, Int32 askExtractMode)
 {
-	if (askExtractMode != NArchive::NExtract::NAskMode::kExtract)
+	last_index_ = index;
+	if (askExtractMode != NArchive::NExtract::NAskMode::kExtract) {
+		//the path for the error report,by index:no item object per tested item
+		full_path_ = m_pArchive->GetItemFullPath(index);
 		return S_OK;
+	}
   C7ZipArchiveItem * archive_item = NULL;
   C7ZipArchive * pArchive = (C7ZipArchive *)m_pArchive;
-  if (pArchive->GetItemInfo(index, &archive_item)) {
+  if (write_job_) {
+    //no result was reported for the previous file
+    CloseWriteJob();
+  }
+  CloseFileOut();
+  if (is_write_files_) {
+    m_pOutStream = nullptr;
+  }
+  if (is_write_files_ && pArchive->GetItemInfo(index, &archive_item)) {
     const unsigned int item_index = archive_item->GetArchiveIndex();
     const std::wstring rpath = archive_item->GetFullPath();
     const bool is_dir = archive_item->IsDir();
-    std::experimental::filesystem::path out_path(pArchive->RootDir());
-    std::experimental::filesystem::path full_path = out_path / rpath;
-    if (out_path == rpath) {
-      full_path = out_path;
+    const std::wstring& out_path = pArchive->RootDir();
+    if (!dir_cache_) {
+      //no prepared tree,fall back to lazily creating it
+      own_dir_cache_.Reset(out_path);
+      dir_cache_ = &own_dir_cache_;
     }
-    if (!is_dir) {
-      base::Path path(full_path);
-      static const wchar_t * const kEmptyFileAlias = L"[Content]";
-      if (rpath == kEmptyFileAlias) {
-        full_path = out_path;
+    compressor::ExtractDirCache* dir_cache = dir_cache_;
+    static const wchar_t * const kEmptyFileAlias = L"[Content]";
+    if (out_path == rpath || (!is_dir && rpath == kEmptyFileAlias)) {
+      full_path_ = out_path;
+    }
+    else {
+      full_path_ = dir_cache->Join(rpath);
+    }
+    if (!is_dir && writer_pool_) {
+      //write-behind:the file is created and written on a writer thread
+      write_job_ = writer_pool_->Open(full_path_, archive_item->GetSize());
+      //read now,a sequential handler has moved past the item by SetOperationResult
+      ReadWriteMeta(archive_item);
+      pooled_out_.Attach(writer_pool_, write_job_);
+      m_pOutStream = &pooled_out_;
+      ++current_item_index_;
+    }
+    else if (!is_dir) {
+      std::wstring ext;
+      const size_t dot_pos = full_path_.find_last_of(L'.');
+      const size_t sep_pos = full_path_.find_last_of(compressor::kPathSeparator);
+      if (dot_pos != std::wstring::npos && (sep_pos == std::wstring::npos || dot_pos > sep_pos)) {
+        ext = full_path_.substr(dot_pos);
       }
-      full_path_ = full_path;
-      static compressor::Wrapper7zOutStream out(full_path, path.ext());
-      out.Open(full_path, path.ext());
-      for (uint32_t try_j = 0;try_j < 2; try_j++) {
-        base::Path::mkpath(full_path.c_str()); // FIXME
-        out.Open(full_path, path.ext());
-        if (out.IsOpen()) {
-          break;
+      {
+        compressor::OperationStats::ScopedPhase phase(pArchive->Stats(), compressor::OperationPhase::kOpen);
+        file_out_.Open(full_path_, ext);
+      }
+      if (!file_out_.IsOpen()) {
+        bool fail = false;
+        {
+          compressor::OperationStats::ScopedPhase phase(pArchive->Stats(), compressor::OperationPhase::kMkdir);
+          fail = dir_cache->EnsureParent(full_path_);
+        }
+        if (!fail) {
+          //parent missing (e.g. not listed in the item table),create and retry once
+          compressor::OperationStats::ScopedPhase phase(pArchive->Stats(), compressor::OperationPhase::kOpen);
+          file_out_.Open(full_path_, ext);
         }
       }
       ++current_item_index_;
-      if (!out.IsOpen()) {
-        pArchive->Push(full_path, L"open failed!");
+      if (!file_out_.IsOpen()) {
+        pArchive->Push(full_path_, L"open failed!");
         return S_OK;
       }
-      m_pOutStream = &out;
+      file_out_.SetSize(archive_item->GetSize());
+      //stamped in SetOperationResult,same as on the writer threads
+      ReadWriteMeta(archive_item);
+      m_pOutStream = &file_out_;
     }
     else {
-      full_path += L"\\";
-      if (base::Path::mkpath(full_path.c_str())) { // FIXME
+      compressor::OperationStats::ScopedPhase phase(pArchive->Stats(), compressor::OperationPhase::kMkdir);
+      if (dir_cache->EnsureDir(full_path_.c_str(), full_path_.size())) {
         return S_OK;
       }
-      full_path_ = full_path;
+      full_path_ += L"\\";
+    }
+  }
+  if (out_mem_items_) {
+    m_pOutMemStream = nullptr;
+    if (index < out_mem_items_->size() && pArchive->GetItemInfo(index, &archive_item)) {
+      full_path_ = archive_item->GetFullPath();
+      if (!archive_item->IsDir()) {
+        m_pOutMemStream = &(*out_mem_items_)[index];
+        m_pOutMemStream->clear();
+        unsigned __int64 item_size = 0;
+        if (archive_item->GetUInt64Property(lib7zip::kpidSize, item_size) &&
+          item_size <= (unsigned __int64)m_pOutMemStream->max_size()) {
+          m_pOutMemStream->reserve((size_t)item_size);
+        }
+      }
     }
   }
   if (m_pOutStream) {
     _outFileStreamSpec = new C7ZipOutStreamWrap(m_pOutStream);
+    if (m_pOutStream != &pooled_out_) {
+      //the writer pool times its own writes
+      _outFileStreamSpec->SetStats(pArchive->Stats());
+    }
     CMyComPtr<ISequentialOutStream> outStreamLoc(_outFileStreamSpec);
     _outFileStream = outStreamLoc;
     *outStream = outStreamLoc.Detach();
   }
-  else {
-    mOutMemStreamSpec = new C7ZipOutMemStream(m_pOutMemStream);
+  else if (m_pOutMemStream) {
+    //write into the caller's buffer,not a copy of it
+    mOutMemStreamSpec = new C7ZipOutMemStream(*m_pOutMemStream);
     CMyComPtr<ISequentialOutStream> outStreamLoc(mOutMemStreamSpec);
     _outFileStream = outStreamLoc;
     *outStream = outStreamLoc.Detach();
@@ -532,8 +1203,78 @@ void CArchiveExtractCallback::GetExtractErrorMessage(uint32_t opRes, uint32_t en
   pArchive->Push(full_path_, opResMsg_);
 }
 
+void CArchiveExtractCallback::ReadWriteMeta(const C7ZipArchiveItem * archive_item) {
+	write_meta_.ctime = 0;
+	write_meta_.atime = 0;
+	write_meta_.mtime = 0;
+	write_meta_.attrib = 0;
+	write_meta_.has_attrib = false;
+	if (!archive_item) {
+		return;
+	}
+	unsigned __int64 val = 0;
+	if (archive_item->GetFileTimeProperty(lib7zip::kpidCTime, val)) {
+		write_meta_.ctime = val;
+	}
+	if (archive_item->GetFileTimeProperty(lib7zip::kpidATime, val)) {
+		write_meta_.atime = val;
+	}
+	if (archive_item->GetFileTimeProperty(lib7zip::kpidMTime, val)) {
+		write_meta_.mtime = val;
+	}
+	if (archive_item->GetUInt64Property(lib7zip::kpidAttrib, val)) {
+		write_meta_.attrib = (uint32_t)val;
+		write_meta_.has_attrib = true;
+	}
+}
+
+void CArchiveExtractCallback::CloseWriteJob() {
+	writer_pool_->Close(write_job_, write_meta_);
+	pooled_out_.Attach(nullptr, nullptr);
+	write_job_ = nullptr;
+	ReadWriteMeta(nullptr);
+}
+
+void CArchiveExtractCallback::CloseFileOut() {
+	if (!file_out_.IsOpen()) {
+		return;
+	}
+	compressor::OperationStats::ScopedPhase phase(m_pArchive->Stats(), compressor::OperationPhase::kClose);
+	bool fail = file_out_.Finish();
+	compressor::ApplyFileTimes(file_out_.native_file(), write_meta_);
+	fail = file_out_.Close() || fail;
+	compressor::ApplyFileAttrib(file_out_.file_name(), write_meta_);
+	ReadWriteMeta(nullptr);
+	if (fail) {
+		//same as the writer threads:a file that ends short is a failed item
+		((C7ZipArchive *)m_pArchive)->Push(file_out_.file_name(), L"write failed!");
+		is_any_item_failed_ = true;
+	}
+}
+
 STDMETHODIMP CArchiveExtractCallback::SetOperationResult(Int32 operationResult)
 {
+	if (write_job_) {
+		CloseWriteJob();
+	}
+	if (m_pOutStream == &file_out_) {
+		_outFileStream.Release();
+		CloseFileOut();
+	}
+	if (m_pArchive->Stats()) {
+		m_pArchive->Stats()->AddItem();
+	}
+	if (op_results_) {
+		//per-item status table:record the result and keep going
+		if (last_index_ < op_results_->size()) {
+			(*op_results_)[last_index_] = operationResult;
+		}
+		if (operationResult != NArchive::NExtract::NOperationResult::kOK) {
+			GetExtractErrorMessage(operationResult, is_password_defined_);
+		}
+		_outFileStream.Release();
+		return S_OK;
+	}
 	switch(operationResult)
 	{
 	case NArchive::NExtract::NOperationResult::kOK:
@@ -544,6 +1285,10 @@ STDMETHODIMP CArchiveExtractCallback::SetOperationResult(Int32 operationResult)
 			{
 			default:
         GetExtractErrorMessage(operationResult, is_password_defined_);
+        if (is_continue_on_error_) {
+          is_any_item_failed_ = true;
+          break;
+        }
         return operationResult;
 				break;
 			}
@@ -560,7 +1305,7 @@ STDMETHODIMP CArchiveExtractCallback::CryptoGetTextPassword(BSTR *password)
 {
 	wstring strPassword(L"");
   is_password_defined_ = true;
-	if (m_pItem->IsPasswordSet())
+	if (m_pItem && m_pItem->IsPasswordSet())
 		strPassword = m_pItem->GetArchiveItemPassword();
 	else if (m_pArchive->IsPasswordSet())
 		strPassword = m_pArchive->GetArchivePassword();
@@ -730,6 +1475,7 @@ bool C7ZipArchiveImpl::GetFileTimeProperty(lib7zip::PropertyIndexEnum propertyIn
 /*------------------- C7ZipArchive -----------*/
 C7ZipArchive::C7ZipArchive()
 {
+	stats_ = NULL;
 }
 
 C7ZipArchive::~C7ZipArchive()
@@ -21,6 +21,22 @@
 
 const wchar_t *kEmptyFileAlias = L"[Content]";
 
+// Property readers by index,shared by the items and by the archive's
+// index based getters that list without creating item objects
+wstring Get7ZipItemFullPath(IInArchive * pInArchive, unsigned int nIndex)
+{
+	// Get Name
+	NWindows::NCOM::CPropVariant prop;
+	wstring fullPath = kEmptyFileAlias;
+
+	if (!pInArchive->GetProperty(nIndex, kpidPath, &prop)) {
+		if (prop.vt == VT_BSTR)
+			fullPath = prop.bstrVal;
+	}
+
+	return fullPath;
+}
+
 class C7ZipArchiveItemImpl : public virtual C7ZipArchiveItem
 {
 public:
@@ -65,16 +81,7 @@ C7ZipArchiveItemImpl::~C7ZipArchiveItemImpl()
 
 wstring C7ZipArchiveItemImpl::GetFullPath() const
 {
-	// Get Name
-	NWindows::NCOM::CPropVariant prop;
-	wstring fullPath = kEmptyFileAlias;
-
-	if (!m_pInArchive->GetProperty(m_nIndex, kpidPath, &prop)) {
-		if (prop.vt == VT_BSTR)
-			fullPath = prop.bstrVal;
-	}
-
-	return fullPath;
+	return Get7ZipItemFullPath(m_pInArchive, m_nIndex);
 }
 
 UInt64 C7ZipArchiveItemImpl::GetSize() const
@@ -133,8 +140,8 @@ bool C7ZipArchiveItemImpl::IsPasswordSet() const
 }
 
 
-bool C7ZipArchiveItemImpl::GetUInt64Property(lib7zip::PropertyIndexEnum propertyIndex,
-											 unsigned __int64 & val) const
+bool Get7ZipItemUInt64Property(IInArchive * pInArchive, unsigned int nIndex,
+								lib7zip::PropertyIndexEnum propertyIndex, unsigned __int64 & val)
 {
 	int p7zip_index = 0;
 
@@ -166,13 +173,22 @@ bool C7ZipArchiveItemImpl::GetUInt64Property(lib7zip::PropertyIndexEnum property
 	case lib7zip::kpidClusterSize: //(Cluster Size)
 		p7zip_index = kpidClusterSize;
 		break;
+	case lib7zip::kpidCRC: //(CRC)
+		p7zip_index = kpidCRC;
+		break;
+	case lib7zip::kpidBlock: //(Solid Block)
+		p7zip_index = kpidBlock;
+		break;
+	case lib7zip::kpidOffset: //(Data Offset)
+		p7zip_index = kpidOffset;
+		break;
 	default:
 		return false;
 	}
 
 	NWindows::NCOM::CPropVariant prop;
 
-	if (m_pInArchive->GetProperty(m_nIndex, p7zip_index, &prop) != 0)
+	if (pInArchive->GetProperty(nIndex, p7zip_index, &prop) != 0)
 		return false;
 
 	if (prop.vt == VT_UI8 || prop.vt == VT_UI4) {
@@ -183,8 +199,8 @@ bool C7ZipArchiveItemImpl::GetUInt64Property(lib7zip::PropertyIndexEnum property
 	return false;
 }
 
-bool C7ZipArchiveItemImpl::GetBoolProperty(lib7zip::PropertyIndexEnum propertyIndex,
-										   bool & val) const
+bool Get7ZipItemBoolProperty(IInArchive * pInArchive, unsigned int nIndex,
+							  lib7zip::PropertyIndexEnum propertyIndex, bool & val)
 {
 	int p7zip_index = 0;
 
@@ -196,14 +212,14 @@ bool C7ZipArchiveItemImpl::GetBoolProperty(lib7zip::PropertyIndexEnum propertyIn
 		p7zip_index = kpidEncrypted;
 		break;
 	case lib7zip::kpidIsDir: //(IsDir)
-		return IsArchiveItemFolder(m_pInArchive, m_nIndex, val) == S_OK;
+		return IsArchiveItemFolder(pInArchive, nIndex, val) == S_OK;
 	default:
 		return false;
 	}
 
 	NWindows::NCOM::CPropVariant prop;
 
-	if (m_pInArchive->GetProperty(m_nIndex, p7zip_index, &prop) == 0 && 
+	if (pInArchive->GetProperty(nIndex, p7zip_index, &prop) == 0 && 
 		prop.vt == VT_BOOL) {
 		val = prop.bVal;
 		return true;
@@ -212,8 +228,8 @@ bool C7ZipArchiveItemImpl::GetBoolProperty(lib7zip::PropertyIndexEnum propertyIn
 	return false;
 }
 
-bool C7ZipArchiveItemImpl::GetStringProperty(lib7zip::PropertyIndexEnum propertyIndex,
-					   wstring & val) const
+bool Get7ZipItemStringProperty(IInArchive * pInArchive, unsigned int nIndex,
+								lib7zip::PropertyIndexEnum propertyIndex, wstring & val)
 {
 	int p7zip_index = 0;
 
@@ -251,7 +267,7 @@ bool C7ZipArchiveItemImpl::GetStringProperty(lib7zip::PropertyIndexEnum property
 
 	NWindows::NCOM::CPropVariant prop;
 
-	if (!m_pInArchive->GetProperty(m_nIndex, p7zip_index, &prop) &&
+	if (!pInArchive->GetProperty(nIndex, p7zip_index, &prop) &&
 		prop.vt == VT_BSTR) {
 		val = prop.bstrVal;
 		return true;
@@ -260,8 +276,8 @@ bool C7ZipArchiveItemImpl::GetStringProperty(lib7zip::PropertyIndexEnum property
 	return false;
 }
 
-bool C7ZipArchiveItemImpl::GetFileTimeProperty(lib7zip::PropertyIndexEnum propertyIndex,
-											 unsigned __int64 & val) const
+bool Get7ZipItemFileTimeProperty(IInArchive * pInArchive, unsigned int nIndex,
+								  lib7zip::PropertyIndexEnum propertyIndex, unsigned __int64 & val)
 {
 	int p7zip_index = 0;
 
@@ -281,7 +297,7 @@ bool C7ZipArchiveItemImpl::GetFileTimeProperty(lib7zip::PropertyIndexEnum proper
 
 	NWindows::NCOM::CPropVariant prop;
 
-	if (m_pInArchive->GetProperty(m_nIndex, p7zip_index, &prop) != 0)
+	if (pInArchive->GetProperty(nIndex, p7zip_index, &prop) != 0)
 		return false;
 
 	if (prop.vt == VT_FILETIME) {
@@ -294,6 +310,30 @@ bool C7ZipArchiveItemImpl::GetFileTimeProperty(lib7zip::PropertyIndexEnum proper
 	return false;
 }
 
+bool C7ZipArchiveItemImpl::GetUInt64Property(lib7zip::PropertyIndexEnum propertyIndex,
+											 unsigned __int64 & val) const
+{
+	return Get7ZipItemUInt64Property(m_pInArchive, m_nIndex, propertyIndex, val);
+}
+
+bool C7ZipArchiveItemImpl::GetBoolProperty(lib7zip::PropertyIndexEnum propertyIndex,
+										   bool & val) const
+{
+	return Get7ZipItemBoolProperty(m_pInArchive, m_nIndex, propertyIndex, val);
+}
+
+bool C7ZipArchiveItemImpl::GetStringProperty(lib7zip::PropertyIndexEnum propertyIndex,
+					   wstring & val) const
+{
+	return Get7ZipItemStringProperty(m_pInArchive, m_nIndex, propertyIndex, val);
+}
+
+bool C7ZipArchiveItemImpl::GetFileTimeProperty(lib7zip::PropertyIndexEnum propertyIndex,
+											 unsigned __int64 & val) const
+{
+	return Get7ZipItemFileTimeProperty(m_pInArchive, m_nIndex, propertyIndex, val);
+}
+
 bool Create7ZipArchiveItem(C7ZipArchive * pArchive, 
 						   IInArchive * pInArchive,
 						   unsigned int nIndex,
@@ -35,6 +35,8 @@ using namespace NWindows;
 #include "7ZipCompressCodecsInfo.h"
 #include "7ZipInStreamWrapper.h"
 
+#include "compressor/concurrency.h"
+
 const UInt64 kMaxCheckStartPosition = 1 << 22;
 
 extern bool Create7ZipArchive(C7ZipLibrary * pLibrary, IInArchive * pInArchive, C7ZipArchive ** pArchive);
@@ -78,6 +80,38 @@ static bool ReadStream(CMyComPtr<IInStream> & inStream, Int64 offset, UINT32 see
   return readCount == 0;
 }
 
+//xz (multi-block),bzip2 and 7z decode on the shared thread budget. Only
+//these get "mt",and before Open:SetProperties re-runs a handler's Init(),
+//tar's resets the name code page and rejects the property
+static void SetDecodeThreads(const C7ZipFormatInfo * pInfo, IInArchive * archive)
+{
+	if (MyStringCompareNoCase(pInfo->m_Name.c_str(), L"xz") != 0 &&
+		MyStringCompareNoCase(pInfo->m_Name.c_str(), L"bzip2") != 0 &&
+		MyStringCompareNoCase(pInfo->m_Name.c_str(), L"7z") != 0)
+		return;
+
+	CMyComPtr<ISetProperties> setProperties;
+	archive->QueryInterface(IID_ISetProperties, (void **)&setProperties);
+	if (!setProperties)
+		return;
+
+	const wchar_t * names[] = { L"mt" };
+	NCOM::CPropVariant values[1];
+	values[0] = (UInt32)compressor::Concurrency::Threads();
+	setProperties->SetProperties(names, values, 1);
+}
+
+static int CreateFormatObject(pU7ZipFunctions pFunctions,
+							  const C7ZipFormatInfo * pInfo,
+							  CMyComPtr<IInArchive> & archive)
+{
+	int result = pFunctions->v.CreateObject(&pInfo->m_ClassID,
+											&IID_IInArchive, (void **)&archive);
+	if (result == S_OK && archive)
+		SetDecodeThreads(pInfo, archive);
+	return result;
+}
+
 static int CreateInArchive(pU7ZipFunctions pFunctions,
 						   const C7ZipObjectPtrArray & formatInfos,
                            CMyComPtr<IInStream> & inStream,
@@ -92,8 +126,7 @@ static int CreateInArchive(pU7ZipFunctions pFunctions,
     if (!fCheckFileTypeBySignature) {
       for(WStringArray::const_iterator extIt = pInfo->Exts.begin(); extIt != pInfo->Exts.end(); extIt++) {
         if (MyStringCompareNoCase((*extIt).c_str(), ext.c_str()) == 0) {
-          return pFunctions->v.CreateObject(&pInfo->m_ClassID, 
-                                            &IID_IInArchive, (void **)&archive);
+          return CreateFormatObject(pFunctions, pInfo, archive);
         }
       }
     } else {
@@ -112,8 +145,7 @@ static int CreateInArchive(pU7ZipFunctions pFunctions,
               continue; //unable to read signature
 
           if (signature == pInfo->Signatures[i]) {
-              return pFunctions->v.CreateObject(&pInfo->m_ClassID, 
-                                                &IID_IInArchive, (void **)&archive);
+              return CreateFormatObject(pFunctions, pInfo, archive);
           }
       }
 #else      
@@ -124,8 +156,7 @@ static int CreateInArchive(pU7ZipFunctions pFunctions,
         continue; //unable to read signature
 
       if (signature == pInfo->m_StartSignature) {
-        return pFunctions->v.CreateObject(&pInfo->m_ClassID, 
-                                          &IID_IInArchive, (void **)&archive);
+        return CreateFormatObject(pFunctions, pInfo, archive);
       }
 #endif
     } //check file type by signature
@@ -190,6 +221,58 @@ HRESULT Lib7ZipOpenMultiVolumeArchive(C7ZipLibrary * pLibrary,
                                pOpenCallBack, ppArchive, pResult, fCheckFileTypeBySignature);
 }
 
+//opens a format by extension over a forward-only stream (IArchiveOpenSeq),
+//used for the inner tar of a pipelined .tar.gz/.tar.xz/.tar.bz2
+HRESULT Lib7ZipOpenSequentialArchive(C7ZipLibrary * pLibrary,
+                                     const wstring & ext,
+                                     ISequentialInStream * pInStream,
+                                     IInArchive ** ppInArchive)
+{
+	*ppInArchive = NULL;
+	//E_NOTIMPL only if every handler of the format lacks IArchiveOpenSeq
+	HRESULT result = CLASS_E_CLASSNOTAVAILABLE;
+	const C7ZipObjectPtrArray & handlers = pLibrary->GetInternalObjectsArray();
+
+	for (C7ZipObjectPtrArray::const_iterator it = handlers.begin(); it != handlers.end(); it++) {
+		C7ZipDllHandler * pHandler = dynamic_cast<C7ZipDllHandler *>(*it);
+		if (pHandler == NULL)
+			continue;
+
+		CMyComPtr<IInStream> noStream;
+		CMyComPtr<IInArchive> archive;
+		if (CreateInArchive(pHandler->GetFunctions(), pHandler->GetFormatInfoArray(),
+							noStream, ext, archive, false) != S_OK || archive == NULL)
+			continue;
+
+		CMyComPtr<IArchiveOpenSeq> openSeq;
+		archive.QueryInterface(IID_IArchiveOpenSeq, (void **)&openSeq);
+		if (!openSeq) {
+			//another handler may register the same extension with a seq reader
+			result = E_NOTIMPL;
+			continue;
+		}
+
+		CMyComPtr<ISetCompressCodecsInfo> setCompressCodecsInfo;
+		archive.QueryInterface(IID_ISetCompressCodecsInfo, (void **)&setCompressCodecsInfo);
+		if (setCompressCodecsInfo) {
+			C7ZipCompressCodecsInfo * pCompressCodecsInfo =
+				new C7ZipCompressCodecsInfo(pLibrary);
+			HRESULT hr = setCompressCodecsInfo->SetCompressCodecsInfo(pCompressCodecsInfo);
+			if (hr != S_OK)
+				return hr;
+		}
+
+		HRESULT hr = openSeq->OpenSeq(pInStream);
+		if (hr != S_OK)
+			return hr;
+
+		*ppInArchive = archive.Detach();
+		return S_OK;
+	}
+
+	return result;
+}
+
 static HRESULT InternalOpenArchive(C7ZipLibrary * pLibrary,
 								   C7ZipDllHandler * pHandler,
 								   C7ZipInStream * pInStream,
@@ -90,8 +90,12 @@ bool C7ZipLibrary::Initialize()
 
         m_bInitialized = true;
 
+        // a static build links in every format and codec, there is no plugin
+        // folder to scan
+#ifndef USE_STATIC_7Z_COMPONENT
         LoadDllFromFolder(p7ZipHandler, L"Codecs", m_InternalObjectsArray);
         LoadDllFromFolder(p7ZipHandler, L"Formats", m_InternalObjectsArray);
+#endif
     }
     else
     {
@@ -34,6 +34,11 @@ typedef std::basic_string<char> string;
 
 typedef std::vector<wstring> WStringArray;
 
+namespace compressor {
+  class OperationStats;
+  class ItemTable;
+}
+
 class C7ZipObject
 {
 public:
@@ -82,6 +87,9 @@ namespace lib7zip {
     kpidExtension,
 		kpidIsDir, //(IsDir)
 		kpidSize, //(Uncompressed Size)
+		kpidCRC, //(CRC)
+		kpidBlock, //(Solid Block)
+		kpidOffset, //(Data Offset)
 
 		PROP_INDEX_END
 	};
@@ -152,6 +160,14 @@ public:
 	virtual int SetSize(unsigned __int64 size) = 0;
 };
 
+//receives extracted data in fixed-size chunks (the last one may be shorter),
+//return non-zero to abort the extraction
+class C7ZipSink
+{
+public:
+	virtual int OnChunk(const void *data, unsigned int size) = 0;
+};
+
 class C7ZipArchive : public virtual C7ZipObject
 {
 public:
@@ -165,6 +181,7 @@ public:
 	virtual bool Extract(unsigned int index, C7ZipOutStream * pOutStream, const wstring & pwd) = 0;
 	virtual bool Extract(const C7ZipArchiveItem * pArchiveItem, C7ZipOutStream * pOutStream) = 0;
   virtual bool Extract(const C7ZipArchiveItem * pArchiveItem, std::vector<std::uint8_t>& pOutStream) = 0;
+  virtual bool Extract(const C7ZipArchiveItem * pArchiveItem, C7ZipSink * pSink, unsigned int chunkSize) = 0;
 	virtual wstring GetArchivePassword() const  = 0;
 	virtual void SetArchivePassword(const wstring & password) = 0;
 	virtual bool IsPasswordSet() const = 0;
@@ -182,16 +199,45 @@ public:
   virtual const std::wstring& OpResMsg() const = 0;
   virtual bool IsPasswordDefined() const = 0;
   virtual bool ExtractTest(const C7ZipArchiveItem * pArchiveItem, C7ZipOutStream * pOutStream) = 0;
+  virtual bool ExtractItems(const std::vector<unsigned int>& indices) = 0;
+  //tests the items in one pass,results[index] gets the operation result
+  //(-1:not reached),the other slots are left as they are
+  virtual bool TestItems(const std::vector<unsigned int>& indices, std::vector<int>& results) = 0;
+  //decodes the items into buffers[index] in one pass,results[index] gets the
+  //operation result (-1:not reached)
+  virtual bool ExtractItemsToMemory(const std::vector<unsigned int>& indices,
+    std::vector<std::vector<std::uint8_t> >& buffers, std::vector<int>& results) = 0;
+  //extracts item index (a tar inside gz/xz/bz2) to RootDir() as an archive:
+  //this handler decodes on its own thread while the tar is parsed and written,
+  //with the decode threads it was opened with
+  virtual bool ExtractNested(unsigned int index) = 0;
+  //item properties read by index,listing this way creates no item objects
+  virtual wstring GetItemFullPath(unsigned int index) const = 0;
+  virtual bool GetItemUInt64Property(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+    unsigned __int64 & val) const = 0;
+  virtual bool GetItemBoolProperty(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+    bool & val) const = 0;
+  virtual bool GetItemFileTimeProperty(unsigned int index, lib7zip::PropertyIndexEnum propertyIndex,
+    unsigned __int64 & val) const = 0;
+  //appends every item in index order,row i is item i
+  virtual bool ReadItemTable(compressor::ItemTable& table) const = 0;
   void SetRootDir(const wchar_t* root_dir) {
     root_dir_ = root_dir;
   }
   const std::wstring& RootDir() const {
     return root_dir_;
   }
+  void SetStats(compressor::OperationStats* stats) {
+    stats_ = stats;
+  }
+  compressor::OperationStats* Stats() const {
+    return stats_;
+  }
   virtual const std::map<std::wstring,std::wstring > & ErrorFileMsg() = 0;
   virtual void Push(const std::wstring& file, const std::wstring& msg) = 0;
 private:
   std::wstring root_dir_;
+  compressor::OperationStats* stats_;
 };
 
 class C7ZipLibrary